@@ -0,0 +1,159 @@
+// Compares the name lookup used when parsing (see `Refl::Utils::GetStringIndex()` and `Refl::Polymorphic::NameToIndex()`)
+// with the sorted arrays and the binary search that were used before it.
+// Looks up the member names of the procedure structs and the widget class names, and prints the average time per lookup.
+// Build with `make -f benchmarks/Makefile`.
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "main/common.h"
+#include "main/procedure_data.h"
+#include "main/widgets.h"
+#include "program/entry_point.h"
+#include "reflection/full_with_poly.h"
+#include "strings/format.h"
+
+// The program objects we link against expect those, see `main/common.h`. They're never used here.
+Interface::Window window;
+Input::Mouse mouse;
+
+namespace
+{
+    constexpr int repetitions = 100000; // Each name list is looked up this many times.
+
+    // The old lookups, copied as they were before the perfect hashing, including the function-local statics that are checked on every call.
+
+    struct NameIndexPair
+    {
+        const char *name = nullptr;
+        std::size_t index = 0;
+
+        constexpr NameIndexPair() {}
+        constexpr NameIndexPair(const char *name) : name(name) {}
+
+        constexpr bool operator==(const NameIndexPair &other) const
+        {
+            return Refl::Utils::cexpr_strcmp(name, other.name) == 0;
+        }
+        constexpr bool operator!=(const NameIndexPair &other) const
+        {
+            return !(*this == other);
+        }
+
+        constexpr bool operator<(const NameIndexPair &other) const
+        {
+            return Refl::Utils::cexpr_strcmp(name, other.name) < 0;
+        }
+    };
+
+    // Was `Refl::Utils::GetStringIndex()`, used for the member names.
+    template <auto F> std::size_t OldGetStringIndex(const char *name)
+    {
+        static const auto array = []
+        {
+            auto name_array = F();
+            std::array<NameIndexPair, name_array.size()> array{};
+            for (std::size_t i = 0; i < array.size(); i++)
+            {
+                array[i].name = name_array[i];
+                array[i].index = i;
+            }
+
+            std::sort(array.begin(), array.end());
+            DebugAssert("Duplicate string in a static list.", std::adjacent_find(array.begin(), array.end()) == array.end());
+            return array;
+        }();
+        auto it = std::lower_bound(array.begin(), array.end(), name);
+        if (it == array.end() || *it != name)
+            return -1;
+        return it->index;
+    }
+
+    // Was the class list of `Refl::Polymorphic`, filled when the classes were registered. See `FillOldClassList()`.
+    template <typename Base> std::vector<NameIndexPair> &OldClassList()
+    {
+        static std::vector<NameIndexPair> ret; // Wrapped in a function to avoid the static init order fiasco.
+        return ret;
+    }
+
+    // Was `Refl::Polymorphic::NameToIndexIfValid()`.
+    template <typename Base> std::size_t OldClassNameToIndexIfValid(const char *name)
+    {
+        auto &list = OldClassList<Base>();
+        auto it = std::lower_bound(list.begin(), list.end(), name);
+        if (it == list.end() || *it != name)
+            return -1;
+        return it - list.begin();
+    }
+
+    // The class names must outlive the list.
+    template <typename Base> void FillOldClassList(const std::vector<std::string> &names)
+    {
+        auto &list = OldClassList<Base>();
+        for (const std::string &name : names)
+            list.emplace_back(name.c_str());
+        std::sort(list.begin(), list.end());
+    }
+
+    // The names are copied into `std::string`s, like the parser does.
+    template <typename T> std::vector<std::string> MemberNames()
+    {
+        std::vector<std::string> ret;
+        for (std::size_t i = 0; i < Refl::Class::member_count<T>; i++)
+            ret.push_back(Refl::Class::MemberName<T>(i));
+        return ret;
+    }
+
+    // Returns the average time per call of `func(name)`, in nanoseconds. Adds the results to `checksum` to prevent the calls from being optimized away.
+    template <typename F> double Measure(const std::vector<std::string> &names, std::size_t &checksum, F &&func)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < repetitions; i++)
+        {
+            for (const std::string &name : names)
+                checksum += func(name);
+        }
+        std::chrono::duration<double, std::nano> duration = std::chrono::steady_clock::now() - start;
+        return names.empty() ? 0 : duration.count() / repetitions / names.size();
+    }
+
+    template <typename T> void MeasureMembers(double &binary_search, double &perfect_hash, std::size_t &checksum)
+    {
+        std::vector<std::string> names = MemberNames<T>();
+
+        binary_search += Measure(names, checksum, [&](const std::string &name){return OldGetStringIndex<Refl::Class::impl::StringList_Members<T>>(name.c_str());});
+        perfect_hash += Measure(names, checksum, [&](const std::string &name){return Refl::Class::MemberIndex<T>(name);});
+    }
+}
+
+int _main_(int, char **)
+{
+    double members_binary_search = 0, members_perfect_hash = 0;
+    std::size_t checksum = 0;
+
+    MeasureMembers<Data::Procedure>(members_binary_search, members_perfect_hash, checksum);
+    MeasureMembers<Data::ProcedureStep>(members_binary_search, members_perfect_hash, checksum);
+    MeasureMembers<Data::Library>(members_binary_search, members_perfect_hash, checksum);
+    MeasureMembers<Data::LibraryFunc>(members_binary_search, members_perfect_hash, checksum);
+    members_binary_search /= 4;
+    members_perfect_hash /= 4;
+
+    std::vector<std::string> class_names;
+    for (std::size_t i = 0; i < Refl::Polymorphic::DerivedClassCount<Widgets::BasicWidget>(); i++)
+        class_names.push_back(Refl::Polymorphic::Name(Refl::Polymorphic::ConstructFromIndex<Widgets::BasicWidget>(i)));
+    FillOldClassList<Widgets::BasicWidget>(class_names);
+
+    double classes_binary_search = Measure(class_names, checksum, [&](const std::string &name){return OldClassNameToIndexIfValid<Widgets::BasicWidget>(name.c_str());});
+    double classes_perfect_hash = Measure(class_names, checksum, [&](const std::string &name){return Refl::Polymorphic::NameToIndexIfValid<Widgets::BasicWidget>(name);});
+
+    std::cout << "Average time per lookup:\n";
+    std::cout << "Members: {:.1f} ns with perfect hashing, {:.1f} ns with binary search\n"_format(members_perfect_hash, members_binary_search);
+    std::cout << "Classes: {:.1f} ns with perfect hashing, {:.1f} ns with binary search\n"_format(classes_perfect_hash, classes_binary_search);
+    std::cout << "(checksum: {})\n"_format(checksum); // Prevents the lookups from being optimized away.
+    return 0;
+}
@@ -0,0 +1,127 @@
+// Compares the regular serialization functions (`Refl::{To|From}{String|Binary}()`), which go through the virtual functions of the interfaces,
+// with their non-virtual counterparts from `reflection/inline.h`.
+// Uses a synthetic procedure of `step_count` steps with `widgets_per_step` widgets each, and prints the best time of several runs for each function.
+// Build with `make -f benchmarks/Makefile`.
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "main/common.h"
+#include "main/procedure_data.h"
+#include "program/entry_point.h"
+#include "reflection/full_with_poly.h"
+#include "reflection/inline.h"
+#include "strings/format.h"
+
+// The program objects we link against expect those, see `main/common.h`. They're never used here.
+Interface::Window window;
+Input::Mouse mouse;
+
+namespace
+{
+    constexpr int
+        step_count = 300,
+        widgets_per_step = 10,
+        runs = 3, // The best run is reported.
+        repetitions = 20; // Each run calls the function this many times.
+
+    // The widgets are written as text, since their classes aren't visible outside of `widgets.cpp`.
+    std::string MakeProcedureText()
+    {
+        std::string ret = "{name=\"Synthetic procedure\",current_step=0,steps=[";
+        for (int i = 0; i < step_count; i++)
+        {
+            if (i > 0)
+                ret += ',';
+            ret += "{name=\"Step {}\",widgets=["_format(i + 1);
+            for (int j = 0; j < widgets_per_step; j++)
+            {
+                if (j > 0)
+                    ret += ',';
+                switch (j % 5)
+                {
+                  case 0:
+                    ret += "Text{text=\"Check the value of parameter {} and write it down below.\"}"_format(j);
+                    break;
+                  case 1:
+                    ret += "TextInput{label=\"Parameter {}\",value=\"{}\",hint=\"Measured value\"}"_format(j, i * j);
+                    break;
+                  case 2:
+                    ret += "CheckBoxList{checkboxes=[{label=\"First\",state=true},{label=\"Second\",state=false},{label=\"Third\",state=false,tooltip=\"Optional\"}]}";
+                    break;
+                  case 3:
+                    ret += "Spacing{}";
+                    break;
+                  case 4:
+                    ret += "Line{}";
+                    break;
+                }
+            }
+            ret += "]}";
+        }
+        ret += "]}";
+        return ret;
+    }
+
+    // Returns the best average time per call of `func()` across the runs, in milliseconds.
+    template <typename F> double Measure(F &&func)
+    {
+        double best = std::numeric_limits<double>::infinity();
+        for (int i = 0; i < runs; i++)
+        {
+            auto start = std::chrono::steady_clock::now();
+            for (int j = 0; j < repetitions; j++)
+                func();
+            std::chrono::duration<double, std::milli> duration = std::chrono::steady_clock::now() - start;
+            best = std::min(best, duration.count() / repetitions);
+        }
+        return best;
+    }
+
+    void PrintRow(const char *name, double virtual_time, double inline_time)
+    {
+        std::cout << "{:<12}{:>8.2f} ms{:>8.2f} ms\n"_format(name, virtual_time, inline_time);
+    }
+}
+
+int _main_(int, char **)
+{
+    Data::Procedure proc = Refl::FromString<Data::Procedure>(MakeProcedureText());
+    std::string text = Refl::ToString(proc, Refl::ToStringOptions::Pretty());
+    std::vector<unsigned char> binary = Refl::ToBinary<std::vector<unsigned char>>(proc);
+
+    if (Refl::Inline::ToString(proc, Refl::ToStringOptions::Pretty()) != text || Refl::Inline::ToBinary<std::vector<unsigned char>>(proc) != binary)
+    {
+        std::cout << "The inline functions produce different output!\n";
+        return 1;
+    }
+
+    std::size_t checksum = 0; // Prevents the calls from being optimized away.
+
+    std::cout << "{} steps x {} widgets, {} KB as text, {} KB as binary.\n"_format(step_count, widgets_per_step, text.size() / 1024, binary.size() / 1024);
+    std::cout << "{:<12}{:>11}{:>11}\n"_format("", "virtual", "inline");
+
+    PrintRow("ToBinary",
+        Measure([&]{checksum += Refl::ToBinary<std::vector<unsigned char>>(proc).size();}),
+        Measure([&]{checksum += Refl::Inline::ToBinary<std::vector<unsigned char>>(proc).size();})
+    );
+    PrintRow("FromBinary",
+        Measure([&]{checksum += Refl::FromBinary<Data::Procedure>(Stream::ReadOnlyData::mem_reference(binary)).steps.size();}),
+        Measure([&]{checksum += Refl::Inline::FromBinary<Data::Procedure>(Stream::ReadOnlyData::mem_reference(binary)).steps.size();})
+    );
+    PrintRow("ToString",
+        Measure([&]{checksum += Refl::ToString(proc, Refl::ToStringOptions::Pretty()).size();}),
+        Measure([&]{checksum += Refl::Inline::ToString(proc, Refl::ToStringOptions::Pretty()).size();})
+    );
+    PrintRow("FromString",
+        Measure([&]{checksum += Refl::FromString<Data::Procedure>(text).steps.size();}),
+        Measure([&]{checksum += Refl::Inline::FromString<Data::Procedure>(text).steps.size();})
+    );
+
+    std::cout << "(checksum: {})\n"_format(checksum);
+    return 0;
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <algorithm>
+#include <cstdint>
 #include <vector>
 #include <utility>
 
@@ -17,42 +18,81 @@ namespace Graphics
     class Image
     {
         // Note that moved-from instance is left in an invalid (yet destructable) state.
+        // The images have 4 channels (RGBA) by default, but can have less: 1 (luminance), 2 (luminance and alpha), or 3 (RGB).
+        // The rows are tightly packed, with no padding. Most per-pixel functions only work with 4 channels.
 
         ivec2 size = ivec2(0);
-        std::vector<u8vec4> data;
+        int channels = 4;
+        std::vector<uint8_t> data;
 
       public:
         enum Format {png, tga};
         enum FlipMode {no_flip, flip_y};
 
         Image() {}
-        Image(ivec2 size, const uint8_t *bytes = 0) : size(size) // If `bytes == 0`, then the image will be filled with transparent black.
+        Image(ivec2 size, const uint8_t *bytes = 0) : Image(size, 4, bytes) {} // If `bytes == 0`, then the image will be filled with transparent black.
+        Image(ivec2 size, int channels, const uint8_t *bytes = 0) : size(size), channels(channels) // If `bytes == 0`, then the image will be filled with zeroes.
         {
+            DebugAssert("Invalid image channel count.", channels >= 1 && channels <= 4);
             if (bytes)
-                data = std::vector<u8vec4>((u8vec4 *)bytes, (u8vec4 *)bytes + size.prod());
+                data = std::vector<uint8_t>(bytes, bytes + ByteSize());
             else
-                data = std::vector<u8vec4>(size.prod());
+                data = std::vector<uint8_t>(ByteSize());
         }
         Image(ivec2 size, u8vec4 color) : size(size)
         {
-            data = std::vector<u8vec4>(size.prod(), color);
+            data = std::vector<uint8_t>(ByteSize());
+            for (std::size_t i = 0; i < data.size(); i += 4)
+                std::copy(color.as_array(), color.as_array() + 4, data.begin() + i);
         }
-        Image(Stream::ReadOnlyData file, FlipMode flip_mode = no_flip) // Throws on failure.
+        // If `desired_channels` is 0, the image keeps the channel count it has in the file.
+        Image(Stream::ReadOnlyData file, FlipMode flip_mode = no_flip, int desired_channels = 4) // Throws on failure.
         {
-            stbi_set_flip_vertically_on_load(flip_mode == flip_y);
+            DebugAssert("Invalid image channel count.", desired_channels >= 0 && desired_channels <= 4);
+            // We don't use `stbi_set_flip_vertically_on_load()`, since it's a global setting, and images are decoded on several threads at once.
             ivec2 img_size;
-            uint8_t *bytes = stbi_load_from_memory(file.data(), file.size(), &img_size.x, &img_size.y, 0, 4);
+            int file_channels = 0;
+            uint8_t *bytes = stbi_load_from_memory(file.data(), file.size(), &img_size.x, &img_size.y, &file_channels, desired_channels);
             if (!bytes)
                 Program::Error("Unable to parse image: ", file.name());
             FINALLY( stbi_image_free(bytes); )
-            *this = Image(img_size, bytes);
+            *this = Image(img_size, desired_channels ? desired_channels : file_channels, bytes);
+            if (flip_mode == flip_y)
+                FlipVertically();
+        }
+
+        // Returns the channel count of an image file, without decoding it. Throws on failure.
+        [[nodiscard]] static int FileChannels(Stream::ReadOnlyData file)
+        {
+            ivec2 img_size;
+            int file_channels = 0;
+            if (!stbi_info_from_memory(file.data(), file.size(), &img_size.x, &img_size.y, &file_channels))
+                Program::Error("Unable to parse image: ", file.name());
+            return file_channels;
         }
 
         explicit operator bool() const {return data.size() > 0;}
 
-        const u8vec4 *Pixels() const {return data.data();}
-        const uint8_t *Data() const {return (const uint8_t *)Pixels();}
+        const u8vec4 *Pixels() const // Only for 4-channel images.
+        {
+            DebugAssert("Attempt to access pixels of an image that doesn't have 4 channels.", channels == 4);
+            return (const u8vec4 *)data.data();
+        }
+        const uint8_t *Data() const {return data.data();}
         ivec2 Size() const {return size;}
+        int Channels() const {return channels;}
+        std::size_t RowBytes() const {return std::size_t(size.x) * channels;}
+        std::size_t ByteSize() const {return RowBytes() * size.y;}
+
+        void FlipVertically()
+        {
+            std::size_t row_bytes = RowBytes();
+            for (int y = 0; y < size.y / 2; y++)
+            {
+                auto row = data.begin() + y * row_bytes;
+                std::swap_ranges(row, row + row_bytes, data.begin() + (size.y - 1 - y) * row_bytes);
+            }
+        }
 
         bool PointInBounds(ivec2 point) const
         {
@@ -72,10 +112,10 @@ namespace Graphics
             switch (format)
             {
               case png:
-                ok = stbi_write_png(file_name.c_str(), size.x, size.y, 4, data.data(), 0);
+                ok = stbi_write_png(file_name.c_str(), size.x, size.y, channels, data.data(), 0);
                 break;
               case tga:
-                ok = stbi_write_tga(file_name.c_str(), size.x, size.y, 4, data.data());
+                ok = stbi_write_tga(file_name.c_str(), size.x, size.y, channels, data.data());
                 break;
             }
 
@@ -83,13 +123,18 @@ namespace Graphics
                 Program::Error("Unable to write image to file: ", file_name);
         }
 
-        u8vec4 &UnsafeAt(ivec2 pos)
+        u8vec4 &UnsafeAt(ivec2 pos) // Only for 4-channel images.
         {
             return const_cast<u8vec4 &>(std::as_const(*this).UnsafeAt(pos));
         }
-        const u8vec4 &UnsafeAt(ivec2 pos) const
+        const u8vec4 &UnsafeAt(ivec2 pos) const // Only for 4-channel images.
         {
-            return data[pos.x + pos.y * size.x];
+            return Pixels()[pos.x + pos.y * size.x];
+        }
+
+        const uint8_t *UnsafeRow(int y) const // Works with any channel count.
+        {
+            return data.data() + y * RowBytes();
         }
 
         u8vec4 TryGet(ivec2 pos) const // Returns transparent black if out of range.
@@ -120,5 +165,54 @@ namespace Graphics
                 std::copy(source_address, source_address + other.Size().x, &UnsafeAt(ivec2(pos.x, y + pos.y)));
             }
         }
+
+        // Returns a smaller copy of the image, using a box filter. Colors are weighted by alpha, so transparent pixels don't bleed into the result.
+        // `new_size` must be positive and not larger than the current size. Works with any channel count.
+        [[nodiscard]] Image Downscaled(ivec2 new_size) const
+        {
+            DebugAssert("Invalid downscaled image size.", (new_size > 0).all() && (new_size <= size).all());
+
+            Image ret(new_size, channels);
+
+            bool has_alpha = channels == 2 || channels == 4; // If there is alpha, it's the last channel.
+            int color_channels = has_alpha ? channels - 1 : channels;
+
+            for (int y = 0; y < new_size.y; y++)
+            {
+                int src_y_begin = std::int64_t(y) * size.y / new_size.y;
+                int src_y_end = std::int64_t(y + 1) * size.y / new_size.y;
+
+                for (int x = 0; x < new_size.x; x++)
+                {
+                    int src_x_begin = std::int64_t(x) * size.x / new_size.x;
+                    int src_x_end = std::int64_t(x + 1) * size.x / new_size.x;
+
+                    std::uint64_t color_sums[3] = {}, alpha_sum = 0;
+                    for (int src_y = src_y_begin; src_y < src_y_end; src_y++)
+                    {
+                        const uint8_t *pixel = UnsafeRow(src_y) + src_x_begin * channels;
+                        for (int src_x = src_x_begin; src_x < src_x_end; src_x++, pixel += channels)
+                        {
+                            unsigned int alpha = has_alpha ? pixel[color_channels] : 1;
+                            for (int i = 0; i < color_channels; i++)
+                                color_sums[i] += pixel[i] * alpha;
+                            alpha_sum += alpha;
+                        }
+                    }
+
+                    if (alpha_sum == 0)
+                        continue; // Fully transparent, leave it zeroed.
+
+                    std::uint64_t count = std::uint64_t(src_x_end - src_x_begin) * (src_y_end - src_y_begin);
+                    uint8_t *target = ret.data.data() + y * ret.RowBytes() + x * channels;
+                    for (int i = 0; i < color_channels; i++)
+                        target[i] = (color_sums[i] + alpha_sum/2) / alpha_sum;
+                    if (has_alpha)
+                        target[color_channels] = (alpha_sum + count/2) / count;
+                }
+            }
+
+            return ret;
+        }
     };
 }
@@ -30,6 +30,15 @@ namespace Graphics
         #endif
     };
 
+    // Whether 1 and 2 channel images can be uploaded as luminance (and alpha) textures. They're not available in the core profiles.
+    // If they aren't, such images should be converted to RGB(A) before uploading.
+    inline constexpr bool have_luminance_formats =
+    #ifdef GL_LUMINANCE
+        true;
+    #else
+        false;
+    #endif
+
     class TexObject
     {
         struct Data
@@ -96,6 +105,39 @@ namespace Graphics
 
         inline static int active_index = 0;
 
+        // Returns the internal format and the pixel format for an image with the specified channel count.
+        [[nodiscard]] static std::pair<GLenum, GLenum> FormatsForChannels(int channels)
+        {
+            switch (channels)
+            {
+              #ifdef GL_LUMINANCE
+              case 1:
+                return {GL_LUMINANCE8, GL_LUMINANCE};
+              case 2:
+                return {GL_LUMINANCE8_ALPHA8, GL_LUMINANCE_ALPHA};
+              #endif
+              case 3:
+                #ifdef GL_RGB8
+                return {GL_RGB8, GL_RGB};
+                #else
+                return {GL_RGB, GL_RGB};
+                #endif
+              case 4:
+                #ifdef GL_RGBA8
+                return {GL_RGBA8, GL_RGBA};
+                #else
+                return {GL_RGBA, GL_RGBA};
+                #endif
+            }
+            Program::Error("Unsupported texture channel count: ", channels, ".");
+        }
+
+        // The rows of `Image`s are tightly packed, but by default OpenGL expects them to be aligned to 4 bytes, which only matters for 1 to 3 channels.
+        static void SetPackedRows(bool packed)
+        {
+            glPixelStorei(GL_UNPACK_ALIGNMENT, packed ? 1 : 4);
+        }
+
       public:
         TexUnit()
         {
@@ -257,10 +299,18 @@ namespace Graphics
             glTexImage2D(GL_TEXTURE_2D, 0, internal_format, size.x, size.y, 0, format, type, pixels);
             return std::move(*this);
         }
+        TexUnit &&SetData(ivec2 size, int channels, const uint8_t *pixels) // Chooses the format based on the channel count.
+        {
+            auto [internal_format, format] = FormatsForChannels(channels);
+            SetPackedRows(true);
+            SetData(internal_format, format, GL_UNSIGNED_BYTE, size, pixels);
+            SetPackedRows(false);
+            return std::move(*this);
+        }
         TexUnit &&SetData(const Image &image)
         {
             DebugAssert("Attempt to use a null image.", image);
-            SetData(image.Size(), image.Data());
+            SetData(image.Size(), image.Channels(), image.Data());
             return std::move(*this);
         }
 
@@ -269,6 +319,13 @@ namespace Graphics
             SetDataPart(GL_RGBA, GL_UNSIGNED_BYTE, pos, size, pixels);
             return std::move(*this);
         }
+        TexUnit &&SetDataPart(ivec2 pos, ivec2 size, int channels, const uint8_t *pixels) // The channel count must match the one used for `SetData()`.
+        {
+            SetPackedRows(true);
+            SetDataPart(FormatsForChannels(channels).second, GL_UNSIGNED_BYTE, pos, size, pixels);
+            SetPackedRows(false);
+            return std::move(*this);
+        }
         TexUnit &&SetDataPart(GLenum format, GLenum type, ivec2 pos, ivec2 size, const uint8_t *pixels)
         {
             DebugAssert("Attempt to use a texture unit without an attached texture.", HasAttachedHandle());
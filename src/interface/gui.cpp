@@ -0,0 +1,16 @@
+#include "gui.h"
+
+#include <imgui_internal.h>
+
+namespace Interface
+{
+    bool ImGuiController::WantsContinuousRedraw()
+    {
+        ImGuiContext *old_context = ImGui::GetCurrentContext();
+        FINALLY( ImGui::SetCurrentContext(old_context); )
+        Activate();
+
+        const ImGuiContext &context = *data.context;
+        return ImGui::IsAnyItemActive() || context.OpenPopupStack.Size > 0 || context.NavWindowingTarget || context.DimBgRatio > 0;
+    }
+}
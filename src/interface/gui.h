@@ -1,8 +1,10 @@
 #pragma once
 
 #include <algorithm>
+#include <cstdint>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <utility>
 
 #include <imgui.h>
@@ -17,6 +19,7 @@
 #include "meta/misc.h"
 #include "program/errors.h"
 #include "stream/readonly_data.h"
+#include "utils/hash.h"
 #include "utils/poly_storage.h"
 
 namespace Interface
@@ -263,6 +266,50 @@ namespace Interface
             }
         }
 
+        // Returns 1 if the GUI has something going on that needs redrawing even without any input:
+        // an active widget (e.g. a blinking text cursor), an open popup, or a fading modal background.
+        // Call this after `PreRender()`.
+        // This is defined in a separate file, since it needs the internal ImGui header, which we don't want to expose.
+        bool WantsContinuousRedraw();
+
+        // Returns a hash of the draw data produced by the last `PreRender()`, or 0 if there is none.
+        // If it didn't change since the last presented frame, there is no point in rendering it.
+        [[nodiscard]] std::size_t DrawDataHash()
+        {
+            ImGuiContext *old_context = ImGui::GetCurrentContext();
+            FINALLY( ImGui::SetCurrentContext(old_context); )
+            Activate();
+
+            const ImDrawData *draw_data = ImGui::GetDrawData();
+            if (!data.frame_rendered || !draw_data || !draw_data->Valid)
+                return 0;
+
+            auto HashBytes = [](const void *bytes, std::size_t size) -> std::size_t
+            {
+                return Hash::Compute(std::string_view(static_cast<const char *>(bytes), size));
+            };
+
+            std::size_t ret = Hash::Compute(draw_data->CmdListsCount, draw_data->DisplayPos.x, draw_data->DisplayPos.y, draw_data->DisplaySize.x, draw_data->DisplaySize.y);
+
+            for (int i = 0; i < draw_data->CmdListsCount; i++)
+            {
+                const ImDrawList &list = *draw_data->CmdLists[i];
+
+                Hash::Append(ret, HashBytes(list.VtxBuffer.Data, list.VtxBuffer.size_in_bytes()));
+                Hash::Append(ret, HashBytes(list.IdxBuffer.Data, list.IdxBuffer.size_in_bytes()));
+
+                for (const ImDrawCmd &cmd : list.CmdBuffer)
+                {
+                    Hash::Append(ret, {
+                        Hash::Compute(cmd.ElemCount, cmd.VtxOffset, cmd.IdxOffset, cmd.ClipRect.x, cmd.ClipRect.y, cmd.ClipRect.z, cmd.ClipRect.w),
+                        Hash::Compute(reinterpret_cast<std::uintptr_t>(cmd.TextureId), reinterpret_cast<std::uintptr_t>(cmd.UserCallback), reinterpret_cast<std::uintptr_t>(cmd.UserCallbackData)),
+                    });
+                }
+            }
+
+            return ret;
+        }
+
         // Reload graphics backend.
         // Good for updating font settings.
         // Call this after rendering a frame, but before ticking.
@@ -311,12 +311,12 @@ namespace Interface
         return data.context;
     }
 
-    void Window::SetTitle(std::string new_title)
+    void Window::SetTitle(std::string_view new_title)
     {
         if (new_title == data.title)
             return;
-        SDL_SetWindowTitle(data.handle, new_title.c_str());
         data.title = new_title;
+        SDL_SetWindowTitle(data.handle, data.title.c_str());
     }
 
     std::string Window::Title() const
@@ -380,10 +380,14 @@ namespace Interface
         data.dropped_files = {};
         data.dropped_strings = {};
 
+        data.received_events = 0;
+
         int index;
         SDL_Event event;
         while (SDL_PollEvent(&event))
         {
+            data.received_events = 1;
+
             bool drop_event = 0;
 
             for (auto &hook : hooks)
@@ -486,6 +490,9 @@ namespace Interface
                     data.resize_time = data.tick_counter;
                     SDL_GetWindowSize(data.handle, &data.size.x, &data.size.y);
                     break;
+                  case SDL_WINDOWEVENT_EXPOSED:
+                    data.expose_time = data.tick_counter;
+                    break;
                 }
                 break;
 
@@ -511,6 +518,19 @@ namespace Interface
         data.mouse_focus = SDL_GetMouseFocus() == data.handle;
     }
 
+    bool Window::WaitForEvents(double timeout)
+    {
+        // Passing a null pointer leaves the event in the queue.
+        return SDL_WaitEventTimeout(0, clamp_min(iround(timeout * 1000), 0));
+    }
+
+    void Window::WakeUp()
+    {
+        SDL_Event event{};
+        event.type = SDL_USEREVENT;
+        SDL_PushEvent(&event); // We silently ignore a failure, it only means the queue is full.
+    }
+
     void Window::SwapBuffers()
     {
         data.frame_counter++;
@@ -537,6 +557,16 @@ namespace Interface
         return instance->data.resize_time == instance->data.tick_counter;
     }
 
+    bool Window::Exposed() const
+    {
+        return data.expose_time == data.tick_counter;
+    }
+
+    bool Window::ReceivedEvents() const
+    {
+        return data.received_events;
+    }
+
     bool Window::HasKeyboardFocus() const
     {
         return data.keyboard_focus;
@@ -3,6 +3,7 @@
 #include <functional>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <utility>
 #include <vector>
 
@@ -90,8 +91,11 @@ namespace Interface
             uint64_t tick_counter = 1, frame_counter = 1;
 
             uint64_t resize_time = 0;
+            uint64_t expose_time = 0;
             uint64_t exit_request_time = 0;
 
+            bool received_events = 0;
+
             std::string text_input;
 
             ivec2 mouse_pos = ivec2(0);
@@ -122,7 +126,7 @@ namespace Interface
         SDL_Window *Handle() const;
         SDL_GLContext Context() const;
 
-        void SetTitle(std::string new_title);
+        void SetTitle(std::string_view new_title); // Does nothing if the title doesn't change.
         std::string Title() const;
 
         ivec2 Size() const;
@@ -134,6 +138,10 @@ namespace Interface
         FullscreenMode Mode() const;
 
         void ProcessEvents(std::vector<std::function<bool(SDL_Event &)>> hooks = {}); // If a hook returns `false`, the current event is discarded.
+        // Blocks until an event arrives or `timeout` (in seconds) expires. Returns 1 if there is an event.
+        // The event is left in the queue, call `ProcessEvents()` afterwards to handle it.
+        bool WaitForEvents(double timeout);
+        static void WakeUp(); // Thread-safe. Makes `WaitForEvents()` return early by posting an empty event.
         void SwapBuffers();
 
         // Those counters start from 1.
@@ -142,8 +150,11 @@ namespace Interface
 
         // Those return 1 for one tick after the corresponding event happend.
         bool Resized() const;
+        bool Exposed() const; // The window contents were damaged (e.g. it was uncovered) and should be redrawn.
         bool ExitRequested() const;
 
+        bool ReceivedEvents() const; // Returns 1 if at least one event (including discarded ones) was received at the last tick.
+
         bool HasKeyboardFocus() const; // Returns 1 if the window is active.
         bool HasMouseFocus() const; // Returns 1 if the window is hovered.
 
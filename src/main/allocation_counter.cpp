@@ -0,0 +1,50 @@
+#include "allocation_counter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+    std::atomic<std::uint64_t> allocation_count{0};
+}
+
+namespace AllocationCounter
+{
+    std::uint64_t Total()
+    {
+        return allocation_count.load(std::memory_order_relaxed);
+    }
+}
+
+// The other forms of `new` and `delete` (arrays, `nothrow`) call those by default.
+// Over-aligned allocations are not counted, since we don't replace their operators.
+
+void *operator new(std::size_t size)
+{
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+
+    if (size == 0)
+        size = 1;
+
+    while (1)
+    {
+        if (void *ret = std::malloc(size))
+            return ret;
+
+        std::new_handler handler = std::get_new_handler();
+        if (!handler)
+            throw std::bad_alloc{};
+        handler();
+    }
+}
+
+void operator delete(void *ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstdint>
+
+// Counts the heap allocations made with `operator new`, to check that the GUI doesn't allocate on every frame.
+// Memory allocated directly with `malloc()` (e.g. by SDL) is not counted.
+namespace AllocationCounter
+{
+    // The number of allocations since the program started.
+    [[nodiscard]] std::uint64_t Total();
+}
@@ -0,0 +1,53 @@
+#include "external_functions.h"
+
+#include <map>
+#include <system_error>
+
+namespace Data
+{
+    const ExternalFunction &LoadedLibrary::GetFunction(const std::string &name)
+    {
+        auto it = functions.find(name);
+        if (it != functions.end())
+            return it->second;
+
+        ExternalFunction func;
+        func.library = library;
+        func.call_mutex = call_mutex;
+        func.name = name;
+        func.ptr_ex = reinterpret_cast<external_func_ex_ptr_t>(library.GetFunctionOrNull(name + "_ex"));
+        if (!func.ptr_ex)
+            func.ptr = reinterpret_cast<external_func_ptr_t>(library.GetFunction(name)); // This throws if there's no such function.
+
+        return functions.try_emplace(name, std::move(func)).first->second;
+    }
+
+    std::shared_ptr<LoadedLibrary> LoadSharedLibrary(const std::filesystem::path &path)
+    {
+        // Only the GUI thread loads libraries, so there's no locking.
+        static std::map<std::filesystem::path, std::weak_ptr<LoadedLibrary>> cache;
+
+        std::error_code error;
+        std::filesystem::path canonical_path = std::filesystem::canonical(path, error);
+        if (error)
+            canonical_path = path; // Let `SharedLibrary` report the error.
+
+        // Forget the libraries that were unloaded.
+        for (auto it = cache.begin(); it != cache.end();)
+        {
+            if (it->second.expired())
+                it = cache.erase(it);
+            else
+                it++;
+        }
+
+        std::weak_ptr<LoadedLibrary> &entry = cache[canonical_path];
+        if (std::shared_ptr<LoadedLibrary> ret = entry.lock())
+            return ret;
+
+        auto ret = std::make_shared<LoadedLibrary>();
+        ret->library = SharedLibrary(canonical_path.string());
+        entry = ret;
+        return ret;
+    }
+}
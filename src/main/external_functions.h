@@ -0,0 +1,73 @@
+#pragma once
+
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "utils/shared_library.h"
+
+namespace Data
+{
+    // Should return 0 on success or a error message on failure.
+    // Caller shouldn't free the string.
+    // The error string has to remain allocated at least until the next library call.
+    // The functions are called on a separate thread, see `FunctionRunner`. Functions from the same library are never called at the same time.
+    using external_func_ptr_t = const char *(*)();
+
+    // The extended ABI. If a library exports `<name>_ex`, it's used instead of `<name>`, and the latter doesn't have to exist.
+    // The callbacks can be called from the thread the function runs on.
+    struct ExternalCallbacks
+    {
+        void *userdata;
+        void (*report_progress)(void *userdata, float progress); // `progress` is in range 0..1.
+        int (*cancel_requested)(void *userdata); // Returns non-zero if the user wants the function to stop. It should return as soon as possible then.
+    };
+    using external_func_ex_ptr_t = const char *(*)(const ExternalCallbacks *callbacks);
+
+    // A function loaded from a shared library.
+    struct ExternalFunction
+    {
+        SharedLibrary library; // Keeps the library loaded while the function is in use.
+        std::shared_ptr<std::mutex> call_mutex; // Shared by all functions of the library. Locked while any of them runs.
+        std::string name;
+        external_func_ptr_t ptr = 0;
+        external_func_ex_ptr_t ptr_ex = 0; // If not null, this is used instead of `ptr`.
+
+        [[nodiscard]] explicit operator bool() const
+        {
+            return ptr || ptr_ex;
+        }
+
+        // Identifies the function regardless of which ABI it uses.
+        [[nodiscard]] const void *Key() const
+        {
+            return ptr_ex ? reinterpret_cast<const void *>(ptr_ex) : reinterpret_cast<const void *>(ptr);
+        }
+    };
+
+    // A shared library, along with the functions that were looked up in it.
+    // Use `LoadSharedLibrary()` to get one.
+    class LoadedLibrary
+    {
+        SharedLibrary library;
+        std::shared_ptr<std::mutex> call_mutex = std::make_shared<std::mutex>(); // Libraries aren't required to be thread-safe, so we call them on one thread at a time.
+        std::unordered_map<std::string, ExternalFunction> functions; // Indexed by name.
+
+        friend std::shared_ptr<LoadedLibrary> LoadSharedLibrary(const std::filesystem::path &path);
+
+      public:
+        LoadedLibrary() {}
+        LoadedLibrary(const LoadedLibrary &) = delete;
+        LoadedLibrary &operator=(const LoadedLibrary &) = delete;
+
+        // Looks up a function by name, preferring the extended ABI. Throws on failure.
+        // The result is cached, so each symbol is looked up only once.
+        [[nodiscard]] const ExternalFunction &GetFunction(const std::string &name);
+    };
+
+    // Returns a library from the process-wide cache, loading it if necessary. Libraries are identified by their canonical paths.
+    // A library is unloaded when nothing references it anymore.
+    [[nodiscard]] std::shared_ptr<LoadedLibrary> LoadSharedLibrary(const std::filesystem::path &path);
+}
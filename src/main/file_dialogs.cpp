@@ -39,4 +39,13 @@ namespace FileDialogs
             return {};
         return result;
     }
+
+    std::optional<std::string> SelectFolder(std::string title, std::string default_path)
+    {
+        pfd::select_folder dialog(title, default_path);
+        auto result = dialog.result();
+        if (result.empty())
+            return {};
+        return result;
+    }
 }
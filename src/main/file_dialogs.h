@@ -11,6 +11,7 @@ namespace FileDialogs
 {
     std::optional<std::string> Open(std::string title, const std::vector<std::pair<std::string, std::string>> &filters, std::string default_path = "");
     std::optional<std::string> Save(std::string title, const std::vector<std::pair<std::string, std::string>> &filters, std::string default_path = "");
+    std::optional<std::string> SelectFolder(std::string title, std::string default_path = "");
 
     inline std::optional<std::string> OpenTemplate()
     {
@@ -31,4 +32,9 @@ namespace FileDialogs
     {
         return FileDialogs::Save("Сохранение отчета", {{"Файлы отчетов", Options::report_extension}, {"Все файлы", ".*"}});
     }
+
+    inline std::optional<std::string> SaveExport()
+    {
+        return FileDialogs::Save("Экспорт отчетов", {{"Таблицы CSV", ".csv"}, {"JSON Lines", ".jsonl"}, {"Все файлы", ".*"}});
+    }
 }
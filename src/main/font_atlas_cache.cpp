@@ -0,0 +1,293 @@
+#include "font_atlas_cache.h"
+
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <imgui.h>
+#include <imgui_internal.h>
+#include <imgui_freetype.h>
+
+#include "macros/adjust.h"
+#include "program/errors.h"
+#include "reflection/full.h"
+#include "reflection/short_macros.h"
+#include "stream/input.h"
+#include "stream/output.h"
+#include "stream/readonly_data.h"
+#include "stream/replace_file.h"
+#include "utils/hash.h"
+
+namespace fs = std::filesystem;
+
+namespace Data
+{
+    namespace
+    {
+        // The cache file starts with the signature and a little-endian `uint16_t` version,
+        // followed by `CachedAtlas` serialized with `Refl::ToBinary()`.
+        constexpr char signature[] = {'M','F','F','O','N','T','S','\0'};
+        constexpr std::uint16_t current_version = 1;
+
+        // Everything that affects the rasterized atlas.
+
+        SIMPLE_STRUCT( FontSourceKey
+            DECL(std::uint64_t INIT=0) data_hash, data_size
+            DECL(int INIT=0) font_index, oversample_h, oversample_v
+            DECL(float INIT=0) size_pixels, extra_spacing_x, extra_spacing_y, offset_x, offset_y, min_advance_x, max_advance_x, rasterizer_multiply
+            DECL(bool INIT=false) merge_mode, pixel_snap_h
+            DECL(unsigned int INIT=0) rasterizer_flags
+            DECL(std::vector<std::uint32_t>) glyph_ranges
+        )
+
+        SIMPLE_STRUCT( CustomRectKey
+            DECL(std::uint32_t INIT=0) id
+            DECL(int INIT=0) width, height
+        )
+
+        SIMPLE_STRUCT( AtlasKey
+            DECL(std::string) imgui_version
+            DECL(unsigned int INIT=0) freetype_flags
+            DECL(int INIT=0) atlas_flags, tex_desired_width, tex_glyph_padding
+            DECL(std::vector<FontSourceKey>) sources
+            DECL(std::vector<CustomRectKey>) custom_rects
+        )
+
+        // The result of building the atlas.
+
+        SIMPLE_STRUCT( CachedGlyph
+            DECL(std::uint32_t INIT=0) codepoint
+            DECL(float INIT=0) advance_x, x0, y0, x1, y1, u0, v0, u1, v1
+        )
+
+        SIMPLE_STRUCT( CachedSource
+            DECL(float INIT=0) ascent, descent
+        )
+
+        SIMPLE_STRUCT( CachedRect
+            DECL(int INIT=0) x, y
+        )
+
+        SIMPLE_STRUCT( CachedAtlas
+            DECL(std::vector<unsigned char>) key // `AtlasKey` serialized with `Refl::ToBinary()`, which makes it easy to compare.
+            DECL(int INIT=0) width, height
+            DECL(std::vector<unsigned char>) pixels // Alpha only.
+            DECL(std::vector<CachedSource>) sources // Parallel to `ImFontAtlas::ConfigData`.
+            DECL(std::vector<CachedRect>) custom_rects // Parallel to `ImFontAtlas::CustomRects`.
+            DECL(std::vector<std::vector<CachedGlyph>>) fonts // Parallel to `ImFontAtlas::Fonts`.
+        )
+
+        std::vector<unsigned char> MakeKey(const ImFontAtlas &atlas, unsigned int freetype_flags)
+        {
+            AtlasKey key;
+            key.imgui_version = IMGUI_VERSION;
+            key.freetype_flags = freetype_flags;
+            key.atlas_flags = atlas.Flags;
+            key.tex_desired_width = atlas.TexDesiredWidth;
+            key.tex_glyph_padding = atlas.TexGlyphPadding;
+
+            for (const ImFontConfig &config : atlas.ConfigData)
+            {
+                FontSourceKey &source = key.sources.emplace_back();
+                source.data_hash = Hash::Compute(std::string_view(static_cast<const char *>(config.FontData), config.FontDataSize));
+                source.data_size = config.FontDataSize;
+                source.font_index = config.FontNo;
+                source.oversample_h = config.OversampleH;
+                source.oversample_v = config.OversampleV;
+                source.size_pixels = config.SizePixels;
+                source.extra_spacing_x = config.GlyphExtraSpacing.x;
+                source.extra_spacing_y = config.GlyphExtraSpacing.y;
+                source.offset_x = config.GlyphOffset.x;
+                source.offset_y = config.GlyphOffset.y;
+                source.min_advance_x = config.GlyphMinAdvanceX;
+                source.max_advance_x = config.GlyphMaxAdvanceX;
+                source.rasterizer_multiply = config.RasterizerMultiply;
+                source.merge_mode = config.MergeMode;
+                source.pixel_snap_h = config.PixelSnapH;
+                source.rasterizer_flags = config.RasterizerFlags;
+
+                // Same as in `ImFontAtlasBuildWithFreeType()`.
+                const ImWchar *ranges = config.GlyphRanges ? config.GlyphRanges : atlas.GetGlyphRangesDefault();
+                for (; ranges[0] && ranges[1]; ranges += 2)
+                {
+                    source.glyph_ranges.push_back(ranges[0]);
+                    source.glyph_ranges.push_back(ranges[1]);
+                }
+            }
+
+            for (const ImFontAtlasCustomRect &rect : atlas.CustomRects)
+                key.custom_rects.push_back(adjust(CustomRectKey{}, id = rect.ID, width = rect.Width, height = rect.Height));
+
+            return Refl::ToBinary<std::vector<unsigned char>>(key);
+        }
+
+        // Returns true if the cached glyph comes from a custom rectangle. Those are added by `ImFontAtlasBuildFinish()`, so they're not cached.
+        bool IsCustomRectGlyph(const ImFontAtlas &atlas, const ImFont *font, ImWchar codepoint)
+        {
+            for (const ImFontAtlasCustomRect &rect : atlas.CustomRects)
+            {
+                if (rect.Font == font && rect.ID == codepoint)
+                    return true;
+            }
+            return false;
+        }
+
+        CachedAtlas SaveAtlas(const ImFontAtlas &atlas, std::vector<unsigned char> key)
+        {
+            CachedAtlas ret;
+            ret.key = std::move(key);
+            ret.width = atlas.TexWidth;
+            ret.height = atlas.TexHeight;
+            ret.pixels.assign(atlas.TexPixelsAlpha8, atlas.TexPixelsAlpha8 + std::size_t(atlas.TexWidth) * atlas.TexHeight);
+
+            for (const ImFontConfig &config : atlas.ConfigData)
+                ret.sources.push_back(adjust(CachedSource{}, ascent = config.DstFont->Ascent, descent = config.DstFont->Descent));
+
+            for (const ImFontAtlasCustomRect &rect : atlas.CustomRects)
+                ret.custom_rects.push_back(adjust(CachedRect{}, x = rect.X, y = rect.Y));
+
+            for (const ImFont *font : atlas.Fonts)
+            {
+                std::vector<CachedGlyph> &glyphs = ret.fonts.emplace_back();
+                for (const ImFontGlyph &glyph : font->Glyphs)
+                {
+                    if (IsCustomRectGlyph(atlas, font, glyph.Codepoint))
+                        continue;
+
+                    glyphs.push_back(adjust(CachedGlyph{}, codepoint = glyph.Codepoint, advance_x = glyph.AdvanceX,
+                        x0 = glyph.X0, y0 = glyph.Y0, x1 = glyph.X1, y1 = glyph.Y1, u0 = glyph.U0, v0 = glyph.V0, u1 = glyph.U1, v1 = glyph.V1));
+                }
+            }
+
+            return ret;
+        }
+
+        // Fills the atlas from the cache. Returns false if the cache doesn't match the atlas, then the atlas is left unchanged.
+        // This mirrors what `ImFontAtlasBuildWithFreeType()` does, minus the rasterization and the packing.
+        bool LoadAtlas(ImFontAtlas &atlas, const CachedAtlas &cached)
+        {
+            if (cached.width <= 0 || cached.height <= 0 || cached.pixels.size() != std::size_t(cached.width) * cached.height ||
+                cached.sources.size() != std::size_t(atlas.ConfigData.Size) || cached.fonts.size() != std::size_t(atlas.Fonts.Size))
+                return false;
+
+            ImFontAtlasBuildRegisterDefaultCustomRects(&atlas);
+            if (cached.custom_rects.size() != std::size_t(atlas.CustomRects.Size))
+                return false;
+            for (std::size_t i = 0; i < cached.custom_rects.size(); i++)
+            {
+                const ImFontAtlasCustomRect &rect = atlas.CustomRects[i];
+                const CachedRect &cached_rect = cached.custom_rects[i];
+                if (cached_rect.x < 0 || cached_rect.y < 0 || cached_rect.x + rect.Width > cached.width || cached_rect.y + rect.Height > cached.height)
+                    return false;
+            }
+
+            atlas.TexID = (ImTextureID)nullptr;
+            atlas.TexUvWhitePixel = ImVec2(0, 0);
+            atlas.ClearTexData();
+
+            for (std::size_t i = 0; i < cached.custom_rects.size(); i++)
+            {
+                atlas.CustomRects[i].X = cached.custom_rects[i].x;
+                atlas.CustomRects[i].Y = cached.custom_rects[i].y;
+            }
+
+            atlas.TexWidth = cached.width;
+            atlas.TexHeight = cached.height;
+            atlas.TexUvScale = ImVec2(1.0f / atlas.TexWidth, 1.0f / atlas.TexHeight);
+            atlas.TexPixelsAlpha8 = (unsigned char *)IM_ALLOC(cached.pixels.size());
+            std::memcpy(atlas.TexPixelsAlpha8, cached.pixels.data(), cached.pixels.size());
+
+            for (std::size_t i = 0; i < cached.sources.size(); i++)
+            {
+                ImFontConfig &config = atlas.ConfigData[i];
+                ImFontAtlasBuildSetupFont(&atlas, config.DstFont, &config, cached.sources[i].ascent, cached.sources[i].descent);
+            }
+
+            for (std::size_t i = 0; i < cached.fonts.size(); i++)
+            {
+                ImFont *font = atlas.Fonts[i];
+                for (const CachedGlyph &glyph : cached.fonts[i])
+                {
+                    // We don't use `ImFont::AddGlyph()`, because it would add `GlyphExtraSpacing.x` and snap the advance again,
+                    // while the cached advance already went through that. The rest mirrors what it does.
+                    font->Glyphs.resize(font->Glyphs.Size + 1);
+                    ImFontGlyph &new_glyph = font->Glyphs.back();
+                    new_glyph.Codepoint = ImWchar(glyph.codepoint);
+                    new_glyph.AdvanceX = glyph.advance_x;
+                    new_glyph.X0 = glyph.x0;
+                    new_glyph.Y0 = glyph.y0;
+                    new_glyph.X1 = glyph.x1;
+                    new_glyph.Y1 = glyph.y1;
+                    new_glyph.U0 = glyph.u0;
+                    new_glyph.V0 = glyph.v0;
+                    new_glyph.U1 = glyph.u1;
+                    new_glyph.V1 = glyph.v1;
+                    font->MetricsTotalSurface += int((glyph.u1 - glyph.u0) * atlas.TexWidth + 1.99f) * int((glyph.v1 - glyph.v0) * atlas.TexHeight + 1.99f);
+                }
+                font->DirtyLookupTables = true;
+            }
+
+            ImFontAtlasBuildFinish(&atlas);
+            return true;
+        }
+
+        void WriteCacheFile(const fs::path &cache_file, const CachedAtlas &cached)
+        {
+            // Since the atlas can always be rebuilt, the errors are ignored.
+            try
+            {
+                std::error_code error;
+                fs::create_directories(cache_file.parent_path(), error);
+
+                Stream::ReplaceFile(cache_file, [&](Stream::Output &output)
+                {
+                    output.WriteBytes(signature, sizeof signature);
+                    output.WriteLittle<std::uint16_t>(current_version);
+                    Refl::ToBinary(cached, output);
+                });
+            }
+            catch (std::exception &) {}
+        }
+    }
+
+    void BuildFontAtlasCached(ImFontAtlas &atlas, unsigned int freetype_flags, const fs::path &cache_file)
+    {
+        // `ImFontAtlasBuildRegisterDefaultCustomRects()` is called by both branches below, so the key has to include the default rectangle.
+        ImFontAtlasBuildRegisterDefaultCustomRects(&atlas);
+        std::vector<unsigned char> key = MakeKey(atlas, freetype_flags);
+
+        try
+        {
+            std::error_code error;
+            if (fs::is_regular_file(cache_file, error))
+            {
+                Stream::ReadOnlyData data = Stream::ReadOnlyData::file(cache_file.string());
+                Stream::Input input(data);
+
+                char file_signature[sizeof signature];
+                input.ReadLittle<char>(file_signature, sizeof signature);
+                if (std::memcmp(file_signature, signature, sizeof signature) == 0 && input.ReadLittle<std::uint16_t>() == current_version)
+                {
+                    CachedAtlas cached;
+                    Refl::FromBinary(cached, input);
+                    if (cached.key == key && LoadAtlas(atlas, cached))
+                        return;
+                }
+            }
+        }
+        catch (std::exception &)
+        {
+            // The atlas will be rebuilt.
+        }
+
+        if (!ImGuiFreeType::BuildFontAtlas(&atlas, freetype_flags))
+            Program::Error("Unable to build the font atlas.");
+
+        WriteCacheFile(cache_file, SaveAtlas(atlas, std::move(key)));
+    }
+}
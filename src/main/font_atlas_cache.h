@@ -0,0 +1,14 @@
+#pragma once
+
+#include <filesystem>
+
+struct ImFontAtlas;
+
+namespace Data
+{
+    // Builds the font atlas with FreeType, like `ImGuiFreeType::BuildFontAtlas()`, but saves the result to `cache_file`.
+    // On the next start the atlas is loaded from that file instead of rasterizing the fonts again, unless anything that affects
+    // the result has changed: the contents of the font files, the font sizes, the glyph ranges, the rasterizer flags, the atlas settings, or the ImGui version.
+    // Call this after adding the fonts to the atlas. Throws on failure. Errors when reading or writing the cache file are ignored.
+    void BuildFontAtlasCached(ImFontAtlas &atlas, unsigned int freetype_flags, const std::filesystem::path &cache_file);
+}
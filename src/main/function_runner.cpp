@@ -0,0 +1,145 @@
+#include "function_runner.h"
+
+#include <algorithm>
+#include <mutex>
+
+#include "interface/window.h"
+#include "macros/finally.h"
+#include "utils/mat.h"
+
+namespace Data
+{
+    FunctionRunner::~FunctionRunner()
+    {
+        CancelAll();
+        WaitForAll();
+    }
+
+    void FunctionRunner::ThreadFunc(Call &call)
+    {
+        {
+            std::lock_guard lock(*call.func.call_mutex);
+
+            // Don't start the function if it was cancelled while we were waiting for another function from the same library.
+            if (!call.cancel_requested.load(std::memory_order_relaxed))
+                CallFunction(call);
+        }
+
+        call.finished.store(true, std::memory_order_release);
+        Interface::Window::WakeUp(); // Let the GUI notice that the function has finished.
+    }
+
+    void FunctionRunner::CallFunction(Call &call)
+    {
+        const char *error = nullptr;
+
+        if (call.func.ptr_ex)
+        {
+            ExternalCallbacks callbacks;
+            callbacks.userdata = &call;
+            callbacks.report_progress = [](void *userdata, float progress)
+            {
+                // The GUI redraws continuously while functions are running, so we don't need to wake it up here.
+                static_cast<Call *>(userdata)->progress.store(clamp(progress, 0, 1), std::memory_order_relaxed);
+            };
+            callbacks.cancel_requested = [](void *userdata) -> int
+            {
+                return static_cast<Call *>(userdata)->cancel_requested.load(std::memory_order_relaxed);
+            };
+
+            error = call.func.ptr_ex(&callbacks);
+        }
+        else
+        {
+            error = call.func.ptr();
+        }
+
+        // The string is only guaranteed to live until the next library call, so we copy it before unlocking the library.
+        if (error)
+            call.error = error;
+    }
+
+    const FunctionRunner::Call *FunctionRunner::FindCall(const ExternalFunction &func) const
+    {
+        auto it = calls.find(func.Key());
+        return it == calls.end() ? nullptr : it->second.get();
+    }
+
+    bool FunctionRunner::Start(const ExternalFunction &func)
+    {
+        if (!func)
+            return false;
+
+        auto [it, inserted] = calls.try_emplace(func.Key());
+        if (!inserted)
+            return false; // Either still running, or finished but not cleaned up by `Update()` yet.
+        FINALLY_ON_THROW( calls.erase(it); )
+
+        Call &call = *(it->second = std::make_unique<Call>());
+        call.func = func;
+        call.thread = std::thread(ThreadFunc, std::ref(call));
+        return true;
+    }
+
+    bool FunctionRunner::IsRunning(const ExternalFunction &func) const
+    {
+        return FindCall(func) != nullptr;
+    }
+
+    bool FunctionRunner::AnyRunning() const
+    {
+        return calls.size() > 0;
+    }
+
+    float FunctionRunner::Progress(const ExternalFunction &func) const
+    {
+        const Call *call = FindCall(func);
+        return call ? call->progress.load(std::memory_order_relaxed) : -1;
+    }
+
+    void FunctionRunner::Cancel(const ExternalFunction &func)
+    {
+        auto it = calls.find(func.Key());
+        if (it != calls.end())
+            it->second->cancel_requested.store(true, std::memory_order_relaxed);
+    }
+
+    void FunctionRunner::CancelAll()
+    {
+        for (auto &[key, call] : calls)
+            call->cancel_requested.store(true, std::memory_order_relaxed);
+    }
+
+    std::vector<FunctionRunner::Failure> FunctionRunner::Update()
+    {
+        std::vector<Failure> ret;
+
+        for (auto it = calls.begin(); it != calls.end();)
+        {
+            Call &call = *it->second;
+            if (!call.finished.load(std::memory_order_acquire))
+            {
+                it++;
+                continue;
+            }
+
+            if (call.thread.joinable()) // It's not joinable if `WaitForAll()` was called.
+                call.thread.join();
+            if (call.error.size() > 0)
+                ret.push_back({call.func.name, std::move(call.error)});
+
+            it = calls.erase(it);
+        }
+
+        return ret;
+    }
+
+    void FunctionRunner::WaitForAll()
+    {
+        for (auto &[key, call] : calls)
+        {
+            if (call->thread.joinable())
+                call->thread.join();
+        }
+    }
+}
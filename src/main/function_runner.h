@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "main/procedure_data.h"
+
+namespace Data
+{
+    // Runs the functions from shared libraries on separate threads, so that slow functions don't freeze the GUI.
+    // A function can't be started again until it finishes. Functions from different libraries can run at the same time,
+    // but the ones from the same library wait for each other, since libraries aren't required to be thread-safe.
+    // All member functions must be called from the GUI thread.
+    class FunctionRunner
+    {
+      public:
+        struct Failure
+        {
+            std::string function_name;
+            std::string message;
+        };
+
+      private:
+        struct Call
+        {
+            ExternalFunction func;
+            std::atomic<float> progress{-1}; // Negative if the function didn't report progress.
+            std::atomic<bool> cancel_requested{false};
+            std::atomic<bool> finished{false};
+            std::string error; // Written by the thread before `finished` is set.
+            std::thread thread;
+        };
+
+        std::map<const void *, std::unique_ptr<Call>> calls; // The keys are `ExternalFunction::Key()`.
+
+        static void ThreadFunc(Call &call);
+        static void CallFunction(Call &call); // Called by `ThreadFunc()` with the library locked.
+
+        [[nodiscard]] const Call *FindCall(const ExternalFunction &func) const;
+
+      public:
+        FunctionRunner() {}
+        FunctionRunner(const FunctionRunner &) = delete;
+        FunctionRunner &operator=(const FunctionRunner &) = delete;
+        ~FunctionRunner(); // Cancels and waits for all running functions.
+
+        // Starts the function. Returns false if it's already running.
+        bool Start(const ExternalFunction &func);
+
+        [[nodiscard]] bool IsRunning(const ExternalFunction &func) const;
+        [[nodiscard]] bool AnyRunning() const;
+
+        // Returns the progress reported by a running function, in range 0..1, or a negative value if it's unknown.
+        [[nodiscard]] float Progress(const ExternalFunction &func) const;
+
+        // Only the functions using the extended ABI can be cancelled.
+        [[nodiscard]] static bool CanCancel(const ExternalFunction &func)
+        {
+            return bool(func.ptr_ex);
+        }
+        // Asks a running function to stop. It's up to the function to respect that.
+        void Cancel(const ExternalFunction &func);
+        void CancelAll();
+
+        // Cleans up the functions that have finished. Returns the errors they reported.
+        [[nodiscard]] std::vector<Failure> Update();
+
+        // Blocks until all running functions finish. Doesn't clean them up, call `Update()` for that.
+        void WaitForAll();
+    };
+
+    inline FunctionRunner function_runner;
+}
@@ -1,6 +1,17 @@
 #pragma once
 
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+#include <memory>
 #include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "utils/unicode.h"
 
 namespace Data // Strings
 {
@@ -20,4 +31,137 @@ namespace Data // Strings
 
         return ret;
     }
+
+    // Caches the result of `EscapeStringForWidgetName()`, to avoid recomputing it every frame.
+    // The cache is updated automatically when the source string changes (e.g. in the template editor).
+    class EscapedLabel
+    {
+        std::string source, escaped;
+
+      public:
+        EscapedLabel() {}
+
+        const char *Get(const std::string &label)
+        {
+            if (label != source)
+            {
+                source = label;
+                escaped = EscapeStringForWidgetName(label);
+            }
+            return escaped.c_str();
+        }
+    };
+
+    // Storage for temporary strings that live until the end of the frame, such as ImGui labels.
+    // Unlike `Str()` and `_format`, this doesn't allocate memory once the arena grows large enough.
+    class ScratchArena
+    {
+        static constexpr std::size_t block_size = 16 * 1024;
+
+        struct Block
+        {
+            std::unique_ptr<char[]> data;
+            std::size_t size = 0;
+        };
+
+        std::vector<Block> blocks;
+        std::size_t cur_block = 0;
+        std::size_t cur_pos = 0;
+
+        char *Allocate(std::size_t size)
+        {
+            while (cur_block < blocks.size() && blocks[cur_block].size - cur_pos < size)
+            {
+                cur_block++;
+                cur_pos = 0;
+            }
+
+            if (cur_block == blocks.size())
+            {
+                Block &block = blocks.emplace_back();
+                block.size = std::max(size, block_size);
+                block.data = std::make_unique<char[]>(block.size);
+            }
+
+            char *ret = blocks[cur_block].data.get() + cur_pos;
+            cur_pos += size;
+            return ret;
+        }
+
+        template <typename T> static std::size_t MaxLength(const T &param)
+        {
+            if constexpr (std::is_same_v<T, char>)
+                return 1;
+            else if constexpr (std::is_integral_v<T>)
+                return std::numeric_limits<T>::digits10 + 2; // Plus the sign and the last partial digit.
+            else
+                return std::string_view(param).size();
+        }
+
+        template <typename T> static char *Write(char *dst, const T &param)
+        {
+            if constexpr (std::is_same_v<T, char>)
+            {
+                *dst = param;
+                return dst + 1;
+            }
+            else if constexpr (std::is_integral_v<T>)
+            {
+                return std::to_chars(dst, dst + MaxLength(param), param).ptr;
+            }
+            else
+            {
+                std::string_view view(param);
+                std::memcpy(dst, view.data(), view.size());
+                return dst + view.size();
+            }
+        }
+
+      public:
+        ScratchArena() {}
+        ScratchArena(const ScratchArena &) = delete;
+        ScratchArena &operator=(const ScratchArena &) = delete;
+
+        // Concatenates strings and integers, like `Str()`. Returns a null-terminated string.
+        template <typename ...P> [[nodiscard]] const char *Str(const P &... params)
+        {
+            char *begin = Allocate((1 + ... + MaxLength(params)));
+            char *end = begin;
+            ((end = Write(end, params)), ...);
+            *end++ = '\0';
+            cur_pos = end - blocks[cur_block].data.get(); // Give back the unused space, since integers are usually shorter than `MaxLength()`.
+            return begin;
+        }
+
+        // Invalidates all strings. The memory is reused.
+        void Reset()
+        {
+            cur_block = 0;
+            cur_pos = 0;
+        }
+    };
+
+    // Reset once per frame.
+    inline ScratchArena frame_scratch;
+
+    // Converts a string to lowercase for case-insensitive searching. Handles ASCII and Cyrillic, other characters are left as is.
+    inline std::string LowercaseForSearch(const std::string &source_str)
+    {
+        std::string ret;
+        ret.reserve(source_str.size());
+
+        for (Unicode::Char ch : Unicode::Iterator(source_str))
+        {
+            if (ch >= 'A' && ch <= 'Z')
+                ch += 'a' - 'A';
+            else if (ch >= 0x410 && ch <= 0x42f) // А-Я
+                ch += 0x20;
+            else if (ch >= 0x400 && ch <= 0x40f) // Ѐ-Џ, including Ё
+                ch += 0x50;
+
+            Unicode::Encode(ch, ret);
+        }
+
+        return ret;
+    }
 }
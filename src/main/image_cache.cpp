@@ -0,0 +1,133 @@
+#include "image_cache.h"
+
+#include <algorithm>
+#include <system_error>
+
+#include "main/image_pyramid.h"
+#include "program/errors.h"
+
+namespace fs = std::filesystem;
+
+namespace Data
+{
+    std::shared_ptr<Image> ImageCache::Load(const fs::path &path)
+    {
+        FileKey key;
+        std::error_code error;
+
+        fs::path canonical_path = fs::canonical(path, error);
+        if (!error)
+        {
+            key.canonical_path = canonical_path.string();
+            key.file_size = fs::file_size(canonical_path, error);
+        }
+        if (!error)
+            key.modification_time = fs::last_write_time(canonical_path, error).time_since_epoch().count();
+        if (error)
+            Program::Error("Unable to open image `", path.string(), "`: ", error.message());
+
+        std::weak_ptr<Image> &entry = images[key];
+        if (std::shared_ptr<Image> image = entry.lock())
+        {
+            stats.hits++;
+            return image;
+        }
+
+        stats.misses++;
+        auto image = std::make_shared<Image>(key.canonical_path);
+        image->modification_time = key.modification_time;
+        image->file_size = key.file_size;
+        entry = image;
+        return image;
+    }
+
+    std::shared_ptr<const Graphics::TexObject> ImageCache::FindTexture(std::size_t content_hash, ImageLoader::Kind kind, ivec2 size)
+    {
+        auto it = textures.find({content_hash, kind});
+        if (it == textures.end() || it->second.size != size)
+            return nullptr;
+
+        auto texture = it->second.texture.lock();
+        if (texture)
+            stats.shared_textures++;
+        return texture;
+    }
+
+    void ImageCache::AddTexture(std::size_t content_hash, ImageLoader::Kind kind, const std::shared_ptr<const Graphics::TexObject> &texture, ivec2 size, int channels)
+    {
+        TextureEntry &entry = textures[{content_hash, kind}];
+        if (!entry.texture.expired())
+            return; // Two identical images were uploaded at the same time. Keep the first one, the second will be freed with its image.
+        entry.texture = texture;
+        entry.size = size;
+        entry.bytes = Image::Level::BytesForSize(size, channels);
+    }
+
+    void ImageCache::EndFrame()
+    {
+        frame++;
+
+        stats.live_images = 0;
+        stats.viewer_texture_bytes = 0;
+        for (auto it = images.begin(); it != images.end();)
+        {
+            std::shared_ptr<Image> image = it->second.lock();
+            if (!image)
+            {
+                it = images.erase(it);
+            }
+            else
+            {
+                stats.live_images++;
+                if (image->full_resolution.pyramid)
+                    stats.viewer_texture_bytes += image->full_resolution.pyramid->TextureBytes();
+                it++;
+            }
+        }
+
+        stats.texture_bytes = 0;
+        for (auto it = textures.begin(); it != textures.end();)
+        {
+            if (it->second.texture.expired())
+            {
+                it = textures.erase(it);
+            }
+            else
+            {
+                stats.texture_bytes += it->second.bytes;
+                it++;
+            }
+        }
+
+        if (stats.texture_bytes > memory_budget)
+            Evict();
+    }
+
+    void ImageCache::Evict()
+    {
+        eviction_candidates.clear();
+        for (const auto &[key, weak_image] : images)
+        {
+            std::shared_ptr<Image> image = weak_image.lock();
+            if (image && image->thumbnail.ready && image->last_use_frame + Options::Images::min_unused_frames_before_eviction <= frame)
+                eviction_candidates.push_back(std::move(image));
+        }
+
+        std::sort(eviction_candidates.begin(), eviction_candidates.end(), [](const auto &a, const auto &b){return a->last_use_frame < b->last_use_frame;});
+
+        for (const std::shared_ptr<Image> &image : eviction_candidates)
+        {
+            if (stats.texture_bytes <= memory_budget)
+                break;
+
+            // If the texture is shared with other images, this doesn't free anything yet, but it will once they're evicted too.
+            if (image->thumbnail.texture.use_count() == 1)
+                stats.texture_bytes -= clamp_max(image->thumbnail.Bytes(), stats.texture_bytes);
+
+            image->thumbnail = {};
+            stats.evictions++;
+        }
+
+        eviction_candidates.clear(); // Don't keep the images alive.
+    }
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "graphics/texture.h"
+#include "main/image_loader.h"
+#include "main/images.h"
+#include "main/options.h"
+#include "utils/hash.h"
+
+namespace Data
+{
+    // Shares the images between all tabs, and limits the amount of texture memory they use.
+    // The images are keyed by the canonical path, modification time and size of the file, so a changed file is loaded again.
+    // Images with identical contents (even if they come from different files) share the textures.
+    // When the textures take more than the budget, the thumbnails of the least recently used images are released. They are loaded again when needed.
+    // Only the thumbnails count towards the budget. The full resolution images are tiled, and the tiles have their own cap (see `ImagePyramid`).
+    // All member functions must be called from the GUI thread.
+    class ImageCache
+    {
+      public:
+        struct Stats
+        {
+            std::uint64_t hits = 0; // `Load()` calls that found an existing image.
+            std::uint64_t misses = 0; // `Load()` calls that had to create a new image.
+            std::uint64_t shared_textures = 0; // Uploads that were skipped because a texture with the same contents already existed.
+            std::uint64_t evictions = 0; // Thumbnails released to stay within the budget.
+
+            std::size_t texture_bytes = 0; // The current size of all thumbnail textures, not counting the shared ones twice.
+            std::size_t viewer_texture_bytes = 0; // The current size of the full resolution tiles. Those aren't counted towards the budget.
+            std::size_t live_images = 0;
+        };
+
+      private:
+        struct FileKey
+        {
+            std::string canonical_path;
+            std::int64_t modification_time = 0;
+            std::uintmax_t file_size = 0;
+
+            bool operator==(const FileKey &other) const
+            {
+                return canonical_path == other.canonical_path && modification_time == other.modification_time && file_size == other.file_size;
+            }
+
+            std::size_t hash() const
+            {
+                return Hash::Compute(canonical_path, modification_time, file_size);
+            }
+        };
+
+        struct ContentKey
+        {
+            std::size_t content_hash = 0;
+            ImageLoader::Kind kind = ImageLoader::thumbnail;
+
+            bool operator==(const ContentKey &other) const
+            {
+                return content_hash == other.content_hash && kind == other.kind;
+            }
+
+            std::size_t hash() const
+            {
+                return Hash::Compute(content_hash, int(kind));
+            }
+        };
+
+        struct TextureEntry
+        {
+            std::weak_ptr<const Graphics::TexObject> texture;
+            ivec2 size = ivec2(0);
+            std::size_t bytes = 0;
+        };
+
+        std::unordered_map<FileKey, std::weak_ptr<Image>, Hash::Obj> images;
+        std::unordered_map<ContentKey, TextureEntry, Hash::Obj> textures;
+
+        std::size_t memory_budget = Options::Images::texture_memory_budget;
+        std::uint64_t frame = 1;
+        Stats stats;
+
+        std::vector<std::shared_ptr<Image>> eviction_candidates; // Reused between frames to avoid allocations.
+
+        void Evict();
+
+      public:
+        ImageCache() {}
+        ImageCache(const ImageCache &) = delete;
+        ImageCache &operator=(const ImageCache &) = delete;
+
+        // Returns the image for a file, creating it if necessary. Only reads the file header, see `Image::Use()` for the actual loading.
+        // Throws if the file can't be opened or isn't an image.
+        [[nodiscard]] std::shared_ptr<Image> Load(const std::filesystem::path &path);
+
+        // Returns an existing texture with the same contents, or null if there is none.
+        [[nodiscard]] std::shared_ptr<const Graphics::TexObject> FindTexture(std::size_t content_hash, ImageLoader::Kind kind, ivec2 size);
+        // Registers a fully uploaded texture, so that it can be shared and counted towards the budget.
+        void AddTexture(std::size_t content_hash, ImageLoader::Kind kind, const std::shared_ptr<const Graphics::TexObject> &texture, ivec2 size, int channels);
+
+        // Should be called once per frame. Forgets the destroyed images and evicts the thumbnails if we're over the budget.
+        void EndFrame();
+
+        [[nodiscard]] std::uint64_t CurrentFrame() const {return frame;}
+
+        [[nodiscard]] std::size_t MemoryBudget() const {return memory_budget;}
+        void SetMemoryBudget(std::size_t bytes) {memory_budget = bytes;}
+
+        [[nodiscard]] const Stats &GetStats() const {return stats;}
+    };
+
+    inline ImageCache image_cache;
+}
@@ -0,0 +1,225 @@
+#include "image_loader.h"
+
+#include <algorithm>
+#include <exception>
+#include <string_view>
+
+#include "graphics/texture.h"
+#include "interface/window.h"
+#include "main/image_cache.h"
+#include "main/image_pyramid.h"
+#include "main/images.h"
+#include "main/options.h"
+#include "main/thumbnail_disk_cache.h"
+#include "program/errors.h"
+#include "stream/readonly_data.h"
+#include "utils/clock.h"
+#include "utils/hash.h"
+
+namespace Data
+{
+    ImageLoader::~ImageLoader()
+    {
+        {
+            std::lock_guard lock(mutex);
+            stop_requested = 1;
+        }
+        cond_var.notify_all();
+        for (std::thread &thread : threads)
+            thread.join();
+    }
+
+    void ImageLoader::Enqueue(const std::shared_ptr<Image> &image, Kind kind)
+    {
+        if (threads.empty())
+        {
+            int thread_count = std::clamp(int(std::thread::hardware_concurrency()) - 1, 1, Options::Images::max_decode_threads);
+            for (int i = 0; i < thread_count; i++)
+                threads.emplace_back([this]{ThreadFunc();});
+        }
+
+        {
+            std::lock_guard lock(mutex);
+            jobs.push_back({image, kind, image->file_name, image->modification_time, image->file_size});
+        }
+        cond_var.notify_one();
+    }
+
+    void ImageLoader::Upload(double time_budget)
+    {
+        uint64_t deadline = Clock::Time() + Clock::SecondsToTicks(time_budget);
+
+        while (1)
+        {
+            if (!current_upload)
+            {
+                std::lock_guard lock(mutex);
+                if (decoded.empty())
+                    return;
+                current_upload = std::move(decoded.front());
+                decoded.pop_front();
+            }
+
+            // Since we lock it on the GUI thread, the image can't end up being destroyed on a different thread.
+            std::shared_ptr<Image> image = current_upload->target.lock();
+            if (!image)
+            {
+                current_upload.reset();
+                continue;
+            }
+
+            if (current_upload->kind == full_resolution)
+            {
+                // The pyramid has no textures yet, its tiles are uploaded when they're drawn. Skip it if the viewer was closed since it was requested.
+                if (image->full_resolution.requested && !image->full_resolution.pyramid)
+                {
+                    image->full_resolution.pyramid = std::move(current_upload->pyramid);
+                    image->full_resolution.error = std::move(current_upload->error);
+                }
+                current_upload.reset();
+                continue;
+            }
+
+            Image::Level &level = image->thumbnail;
+
+            // Skip the thumbnails that were evicted since they were requested. Also skip duplicates.
+            if (!level.requested || (level.ready && current_upload->next_row == 0))
+            {
+                current_upload.reset();
+                continue;
+            }
+
+            if (current_upload->error.size() > 0)
+            {
+                level.error = std::move(current_upload->error);
+                current_upload.reset();
+                continue;
+            }
+
+            const Graphics::Image &pixels = current_upload->pixels;
+            ivec2 size = pixels.Size();
+
+            if (current_upload->next_row > 0 && !level.texture)
+                current_upload->next_row = 0; // The texture was released and requested again while we were uploading it, start over.
+
+            if (current_upload->next_row == 0)
+            {
+                level.size = size;
+                level.channels = pixels.Channels();
+
+                // If another image has the same contents, share its texture instead of uploading a new one.
+                if (auto existing = image_cache.FindTexture(current_upload->content_hash, current_upload->kind, size))
+                {
+                    level.texture = std::move(existing);
+                    level.ready = true;
+                    current_upload.reset();
+                    continue;
+                }
+
+                auto texture = std::make_shared<Graphics::TexObject>(nullptr);
+                Graphics::TexUnit(*texture).Interpolation(Graphics::linear).Wrap(Graphics::fill).SetData(size, pixels.Channels(), nullptr);
+                level.texture = std::move(texture);
+            }
+
+            int &next_row = current_upload->next_row;
+            int row_count = std::clamp(int(Options::Images::upload_chunk_bytes / pixels.RowBytes()), 1, size.y - next_row);
+            Graphics::TexUnit(*level.texture).SetDataPart(ivec2(0, next_row), ivec2(size.x, row_count), pixels.Channels(), pixels.UnsafeRow(next_row));
+            next_row += row_count;
+
+            if (next_row >= size.y)
+            {
+                level.ready = true;
+                image_cache.AddTexture(current_upload->content_hash, current_upload->kind, level.texture, size, pixels.Channels());
+                current_upload.reset();
+            }
+
+            if (Clock::Time() >= deadline)
+                return;
+        }
+    }
+
+    bool ImageLoader::HasPendingUploads()
+    {
+        if (current_upload)
+            return true;
+        std::lock_guard lock(mutex);
+        return decoded.size() > 0;
+    }
+
+    void ImageLoader::ThreadFunc()
+    {
+        std::unique_lock lock(mutex);
+
+        while (1)
+        {
+            if (stop_requested)
+                return;
+
+            if (jobs.empty())
+            {
+                cond_var.wait(lock);
+                continue;
+            }
+
+            Job job = std::move(jobs.front());
+            jobs.pop_front();
+
+            if (job.target.expired())
+                continue; // Nobody needs this image anymore.
+
+            lock.unlock();
+
+            Decoded result{std::move(job.target), job.kind, 0, {}, {}, {}};
+            try
+            {
+                std::optional<ThumbnailDiskCache::Entry> cached;
+                if (job.kind == thumbnail)
+                    cached = thumbnail_disk_cache.Find(job.file_name, job.modification_time, job.file_size);
+
+                if (cached)
+                {
+                    result.content_hash = cached->content_hash;
+                    result.pixels = std::move(cached->pixels);
+                }
+                else
+                {
+                    Stream::ReadOnlyData file(job.file_name);
+                    result.content_hash = Hash::Compute(std::string_view(file.data_char(), file.size()), file.size());
+
+                    // Keep the native channel count, so that opaque and grayscale images take less memory.
+                    int channels = Graphics::Image::FileChannels(file);
+                    if (channels < 3 && !Graphics::have_luminance_formats)
+                        channels += 2; // Add the color channels.
+
+                    result.pixels = Graphics::Image(file, Graphics::Image::no_flip, channels);
+                    if (result.pixels.Size().x <= 0 || result.pixels.Size().y <= 0)
+                        Program::Error("The image is empty.");
+
+                    if (job.kind == thumbnail)
+                    {
+                        ivec2 thumbnail_size = Image::ThumbnailSize(result.pixels.Size());
+                        if (thumbnail_size != result.pixels.Size())
+                            result.pixels = result.pixels.Downscaled(thumbnail_size);
+
+                        thumbnail_disk_cache.Store(job.file_name, job.modification_time, job.file_size, result.content_hash, result.pixels);
+                    }
+                    else
+                    {
+                        result.pyramid = std::make_shared<ImagePyramid>(std::move(result.pixels));
+                        result.pixels = {};
+                    }
+                }
+            }
+            catch (std::exception &e)
+            {
+                result.pixels = {};
+                result.pyramid = nullptr;
+                result.error = "While loading image `{}`: {}"_format(job.file_name, e.what());
+            }
+
+            lock.lock();
+            decoded.push_back(std::move(result));
+            Interface::Window::WakeUp(); // Let the GUI upload the image.
+        }
+    }
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "graphics/image.h"
+
+namespace Data
+{
+    class Image;
+    class ImagePyramid;
+
+    // Decodes images on a pool of background threads, then uploads them to textures on the GUI thread, a bit at a time.
+    // The threads are started when the first image is enqueued.
+    // The loader doesn't keep the images alive. If an image is destroyed before it's loaded, it's silently skipped.
+    // All member functions must be called from the GUI thread.
+    class ImageLoader
+    {
+      public:
+        enum Kind {thumbnail, full_resolution};
+
+      private:
+        struct Job
+        {
+            std::weak_ptr<Image> target; // The threads only check if it's expired, they never lock it.
+            Kind kind = thumbnail;
+            std::string file_name;
+            std::int64_t modification_time = 0;
+            std::uintmax_t file_size = 0;
+        };
+
+        struct Decoded
+        {
+            std::weak_ptr<Image> target;
+            Kind kind = thumbnail;
+            std::size_t content_hash = 0; // A hash of the file contents, used to share textures between identical images.
+            Graphics::Image pixels; // For thumbnails.
+            std::shared_ptr<ImagePyramid> pyramid; // For full resolution images.
+            std::string error; // If not empty, `pixels` and `pyramid` are null.
+            int next_row = 0; // The rows before this one are already uploaded.
+        };
+
+        std::mutex mutex;
+        std::condition_variable cond_var; // Notified when a job is added, and when the loader is being destroyed.
+        std::deque<Job> jobs;
+        std::deque<Decoded> decoded;
+        bool stop_requested = 0;
+
+        std::optional<Decoded> current_upload; // Only touched by the GUI thread, so it's not protected by the mutex.
+
+        std::vector<std::thread> threads;
+
+        void ThreadFunc();
+
+      public:
+        ImageLoader() {}
+        ImageLoader(const ImageLoader &) = delete;
+        ImageLoader &operator=(const ImageLoader &) = delete;
+        ~ImageLoader(); // Abandons the queued images and waits for the ones being decoded.
+
+        // Schedules decoding `image->file_name`. When it's done and uploaded, `image->thumbnail` becomes ready or `image->full_resolution` receives the pyramid.
+        // Thumbnails are downscaled on the decoding threads, so the full resolution pixels never reach the GPU in one piece.
+        // The mip levels of the full resolution images are built on the decoding threads too, and their tiles are uploaded when they're drawn.
+        void Enqueue(const std::shared_ptr<Image> &image, Kind kind);
+
+        // Uploads the decoded images to textures, spending roughly `time_budget` seconds on it.
+        // Should be called once per frame.
+        void Upload(double time_budget);
+
+        // Returns true if there are decoded images waiting to be uploaded, which means that we need more frames.
+        [[nodiscard]] bool HasPendingUploads();
+    };
+
+    inline ImageLoader image_loader;
+}
@@ -0,0 +1,207 @@
+#include "image_pyramid.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <exception>
+#include <random>
+#include <system_error>
+
+#include "main/options.h"
+#include "stream/output.h"
+#include "utils/clock.h"
+
+namespace fs = std::filesystem;
+
+namespace Data
+{
+    namespace
+    {
+        // Returns a unique name for a tile file. Several instances of the program can run at the same time, hence the random part.
+        fs::path MakeTileFilePath()
+        {
+            static std::atomic<std::uint64_t> counter = 0;
+            std::random_device random;
+            return fs::temp_directory_path() / "modular-forms-tiles-{:08x}{:08x}-{}.tmp"_format(random(), random(), counter++);
+        }
+
+        // Returns the part of the level that is stored for a tile: the tile itself, plus a 1 pixel border around it, except at the level edges.
+        // The border lets the linear filtering blend the edge pixels with their neighbors, otherwise the tile edges would be visible as seams.
+        void StoredTileRect(ivec2 level_size, ivec2 tile_pos, ivec2 tile_size, ivec2 &stored_a, ivec2 &stored_b)
+        {
+            stored_a = clamp_min(tile_pos - 1, 0);
+            stored_b = clamp_max(tile_pos + tile_size + 1, level_size);
+        }
+    }
+
+    ImagePyramid::ImagePyramid(Graphics::Image full_resolution)
+    {
+        constexpr int tile_size = Options::Images::viewer_tile_size;
+
+        channels = full_resolution.Channels();
+        tile_file_path = MakeTileFilePath();
+
+        try
+        {
+            {
+                Stream::Output output(tile_file_path.string());
+                std::size_t offset = 0;
+
+                Graphics::Image pixels = std::move(full_resolution);
+                while (1)
+                {
+                    Level &level = levels.emplace_back();
+                    level.size = pixels.Size();
+
+                    ivec2 tile_count = (level.size + tile_size - 1) / tile_size;
+                    for (int y = 0; y < tile_count.y; y++)
+                    for (int x = 0; x < tile_count.x; x++)
+                    {
+                        ivec2 tile_pos = ivec2(x,y) * tile_size;
+                        ivec2 this_tile_size = clamp_max(level.size - tile_pos, tile_size);
+                        ivec2 stored_a, stored_b;
+                        StoredTileRect(level.size, tile_pos, this_tile_size, stored_a, stored_b);
+                        std::size_t stored_row_bytes = std::size_t(stored_b.x - stored_a.x) * channels;
+
+                        level.tile_offsets.push_back(offset);
+                        for (int row = stored_a.y; row < stored_b.y; row++)
+                            output.WriteBytes(pixels.UnsafeRow(row) + stored_a.x * channels, stored_row_bytes);
+                        offset += stored_row_bytes * (stored_b.y - stored_a.y);
+                    }
+
+                    // Stop when the whole level fits into a single tile.
+                    if (level.size.max() <= tile_size)
+                        break;
+
+                    // This frees the previous level.
+                    pixels = pixels.Downscaled(clamp_min((level.size + 1) / 2, 1));
+                }
+
+                output.Flush();
+            }
+
+            tile_file = Stream::Input(tile_file_path.string());
+        }
+        catch (...)
+        {
+            std::error_code ignored;
+            fs::remove(tile_file_path, ignored);
+            throw;
+        }
+    }
+
+    ImagePyramid::~ImagePyramid()
+    {
+        if (tile_file_path.empty())
+            return;
+
+        tile_file = {}; // Some platforms can't remove open files.
+        std::error_code ignored;
+        fs::remove(tile_file_path, ignored);
+    }
+
+    void ImagePyramid::Draw(ImDrawList &draw_list, fvec2 a, fvec2 b, fvec2 clip_a, fvec2 clip_b, double time_budget)
+    {
+        missing_tiles = false;
+        if (levels.empty() || (b <= a).any())
+            return;
+
+        draw_counter++;
+
+        constexpr int tile_size = Options::Images::viewer_tile_size;
+        uint64_t deadline = Clock::Time() + Clock::SecondsToTicks(time_budget);
+        bool uploaded_any = false;
+
+        // Pick the smallest level that still has at least one pixel per screen pixel.
+        float image_pixels_per_screen_pixel = levels.front().size.x / (b.x - a.x);
+        int level_index = clamp(int(std::floor(std::log2(image_pixels_per_screen_pixel))), 0, int(levels.size()) - 1);
+        const Level &level = levels[level_index];
+        ivec2 level_size = level.size;
+
+        // Find the visible tiles.
+        fvec2 screen_per_level_pixel = (b - a) / fvec2(level_size);
+        fvec2 visible_a = (clamp_min(clip_a, a) - a) / screen_per_level_pixel;
+        fvec2 visible_b = (clamp_max(clip_b, b) - a) / screen_per_level_pixel;
+        if ((visible_b <= visible_a).any())
+            return;
+
+        ivec2 tile_count = (level_size + tile_size - 1) / tile_size;
+        ivec2 first_tile = clamp(ivec2(floor(visible_a / tile_size)), 0, tile_count - 1);
+        ivec2 last_tile = clamp(ivec2(ceil(visible_b / tile_size)) - 1, 0, tile_count - 1);
+
+        for (int y = first_tile.y; y <= last_tile.y; y++)
+        for (int x = first_tile.x; x <= last_tile.x; x++)
+        {
+            TileKey key{level_index, ivec2(x,y)};
+            ivec2 tile_pos = key.index * tile_size;
+            ivec2 this_tile_size = clamp_max(level_size - tile_pos, tile_size);
+            ivec2 stored_a, stored_b;
+            StoredTileRect(level_size, tile_pos, this_tile_size, stored_a, stored_b);
+            ivec2 stored_size = stored_b - stored_a;
+
+            auto it = tiles.find(key);
+            if (it == tiles.end())
+            {
+                if (uploaded_any && Clock::Time() >= deadline)
+                {
+                    missing_tiles = true; // We'll upload it during one of the next frames.
+                    continue;
+                }
+
+                tile_pixels.resize(std::size_t(stored_size.x) * stored_size.y * channels);
+                try
+                {
+                    tile_file.Seek(level.tile_offsets[x + y * tile_count.x], Stream::absolute);
+                    tile_file.Read(tile_pixels.data(), tile_pixels.size());
+                }
+                catch (std::exception &)
+                {
+                    continue; // Someone broke our temporary file. There's nothing we can do, so we leave a hole in the image.
+                }
+
+                Tile tile;
+                tile.texture = Graphics::TexObject(nullptr);
+                Graphics::TexUnit(tile.texture).Interpolation(Graphics::linear).Wrap(Graphics::clamp).SetData(stored_size, channels, tile_pixels.data());
+                tile.bytes = tile_pixels.size();
+                tile_bytes += tile.bytes;
+                it = tiles.emplace(key, std::move(tile)).first;
+                uploaded_any = true;
+            }
+
+            it->second.last_use = draw_counter;
+
+            fvec2 tile_a = a + tile_pos * screen_per_level_pixel;
+            fvec2 tile_b = a + (tile_pos + this_tile_size) * screen_per_level_pixel;
+            // Skip the border, it's only there for the filtering.
+            fvec2 uv_a = fvec2(tile_pos - stored_a) / stored_size;
+            fvec2 uv_b = fvec2(tile_pos + this_tile_size - stored_a) / stored_size;
+            draw_list.AddImage((ImTextureID)(uintptr_t)it->second.texture.Handle(), tile_a, tile_b, uv_a, uv_b);
+        }
+
+        EvictTiles();
+    }
+
+    void ImagePyramid::EvictTiles()
+    {
+        if (tile_bytes <= Options::Images::viewer_texture_budget)
+            return;
+
+        eviction_candidates.clear();
+        for (const auto &[key, tile] : tiles)
+        {
+            if (tile.last_use != draw_counter) // Never evict the tiles that are visible right now.
+                eviction_candidates.emplace_back(tile.last_use, key);
+        }
+
+        std::sort(eviction_candidates.begin(), eviction_candidates.end(), [](const auto &a, const auto &b){return a.first < b.first;});
+
+        for (const auto &candidate : eviction_candidates)
+        {
+            if (tile_bytes <= Options::Images::viewer_texture_budget)
+                break;
+            auto it = tiles.find(candidate.second);
+            tile_bytes -= it->second.bytes;
+            tiles.erase(it);
+        }
+    }
+}
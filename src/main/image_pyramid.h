@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <unordered_map>
+#include <vector>
+
+#include "imgui.h"
+
+#include "graphics/image.h"
+#include "graphics/texture.h"
+#include "stream/input.h"
+#include "utils/hash.h"
+#include "utils/mat.h"
+
+namespace Data
+{
+    // A full resolution image for the image viewer, split into tiles of `Options::Images::viewer_tile_size` at several mip levels.
+    // The levels are built on a background thread (see `ImageLoader`), and their tiles are written to a temporary file, one level at a time.
+    // Then the pixels are freed, so only the previous level and the one being built are in memory at the same time.
+    // The tiles are read back and uploaded to textures only when they become visible, at the mip level that matches the current zoom,
+    // so neither the RAM nor the texture memory usage depends on the image size.
+    // When the tiles take more than `Options::Images::viewer_texture_budget`, the least recently drawn ones are freed.
+    // The visible tiles are never freed, so the budget can be exceeded by at most one screen worth of tiles.
+    class ImagePyramid
+    {
+        struct TileKey
+        {
+            int level = 0;
+            ivec2 index = ivec2(0);
+
+            bool operator==(const TileKey &other) const
+            {
+                return level == other.level && index == other.index;
+            }
+
+            std::size_t hash() const
+            {
+                return Hash::Compute(level, index.x, index.y);
+            }
+        };
+
+        struct Tile
+        {
+            Graphics::TexObject texture;
+            std::size_t bytes = 0;
+            std::uint64_t last_use = 0; // The value of `draw_counter` when the tile was drawn last time.
+        };
+
+        struct Level
+        {
+            ivec2 size = ivec2(0);
+            std::vector<std::size_t> tile_offsets; // Where the tiles start in `tile_file`, row by row. Each tile has its rows tightly packed, and includes a 1 pixel border.
+        };
+
+        std::vector<Level> levels; // Each level is half the size of the previous one. The first one has the full resolution.
+        int channels = 4;
+
+        std::filesystem::path tile_file_path; // Removed in the destructor.
+        Stream::Input tile_file;
+
+        std::unordered_map<TileKey, Tile, Hash::Obj> tiles;
+        std::size_t tile_bytes = 0; // The total size of the tile textures.
+        std::uint64_t draw_counter = 0;
+        bool missing_tiles = false;
+
+        // Those are reused between frames, to avoid allocations.
+        std::vector<uint8_t> tile_pixels;
+        std::vector<std::pair<std::uint64_t, TileKey>> eviction_candidates;
+
+        void EvictTiles();
+
+      public:
+        ImagePyramid() {}
+        // Builds the mip levels and writes them to a temporary file. This is slow, so it should be called on a background thread. Throws on failure.
+        explicit ImagePyramid(Graphics::Image full_resolution);
+
+        ImagePyramid(const ImagePyramid &) = delete;
+        ImagePyramid &operator=(const ImagePyramid &) = delete;
+        ~ImagePyramid();
+
+        [[nodiscard]] ivec2 Size() const
+        {
+            return levels.empty() ? ivec2(0) : levels.front().size;
+        }
+
+        // Draws the image so that its corners end up at `a` and `b` (in screen coordinates).
+        // Only the tiles intersecting the rectangle from `clip_a` to `clip_b` are drawn. The caller is responsible for the actual clipping.
+        // The missing tiles are uploaded, for at most `time_budget` seconds (but at least one tile is uploaded).
+        // Must be called on the GUI thread.
+        void Draw(ImDrawList &draw_list, fvec2 a, fvec2 b, fvec2 clip_a, fvec2 clip_b, double time_budget);
+
+        // Returns the amount of texture memory used by the tiles.
+        [[nodiscard]] std::size_t TextureBytes() const
+        {
+            return tile_bytes;
+        }
+
+        // Returns true if the last `Draw()` ran out of time before uploading all visible tiles. If so, you need to draw it again.
+        [[nodiscard]] bool HasMissingTiles() const
+        {
+            return missing_tiles;
+        }
+    };
+}
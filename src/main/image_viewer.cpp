@@ -1,6 +1,7 @@
 #include "image_viewer.h"
 
 #include "main/common.h"
+#include "main/image_pyramid.h"
 #include "main/options.h"
 #include "main/widgets.h"
 
@@ -8,7 +9,10 @@ void GuiElements::ImageViewer::Display()
 {
     if (Data::clicked_image)
     {
+        if (current_image)
+            current_image->ReleaseFullResolution();
         current_image = std::exchange(Data::clicked_image, nullptr);
+        current_image->RequestFullResolution(); // Until it's loaded, we show the thumbnail.
         ImGui::OpenPopup(modal_name);
     }
 
@@ -21,7 +25,8 @@ void GuiElements::ImageViewer::Display()
         {
             const std::string text_close = "Закрыть";
 
-            const auto &image = *current_image;
+            auto &image = *current_image;
+            image.Use(); // Don't let the thumbnail get evicted while we're showing it.
             ivec2 available_size = iround(fvec2(ImGui::GetContentRegionAvail())) with(y -= ImGui::GetFrameHeightWithSpacing() + 2);
 
             fvec2 relative_image_size = image.pixel_size / fvec2(available_size);
@@ -85,12 +90,31 @@ void GuiElements::ImageViewer::Display()
 
             ivec2 window_coord_a = image_pixel_offset + (available_size - image_visual_size) / 2;
             ivec2 window_coord_b = window_coord_a + image_visual_size;
-            fmat3 m = Math::linear_mapping<fvec2>(window_coord_a, window_coord_b, fvec2(0), fvec2(1)).matrix();
-
-            fvec2 tex_coord_a = (m * ivec2(0).to_vec3(1)).to_vec2();
-            fvec2 tex_coord_b = (m * available_size.to_vec3(1)).to_vec2();
-
-            ImGui::Image(image.TextureHandle(), available_size, tex_coord_a, tex_coord_b, fvec4(1), ImGui::GetStyleColorVec4(ImGuiCol_Border));
+            fvec2 clip_a = ImGui::GetCursorScreenPos();
+            fvec2 clip_b = clip_a + available_size;
+            fvec2 image_a = clip_a + window_coord_a;
+            fvec2 image_b = clip_a + window_coord_b;
+            ImGui::Dummy(available_size);
+
+            ImDrawList &draw_list = *ImGui::GetWindowDrawList();
+            draw_list.PushClipRect(clip_a, clip_b, true);
+
+            // The full resolution tiles go to the upper channel. The thumbnail is drawn below them while some of them are missing.
+            draw_list.ChannelsSplit(2);
+            draw_list.ChannelsSetCurrent(1);
+            Data::ImagePyramid *pyramid = image.full_resolution.pyramid.get();
+            if (pyramid)
+                pyramid->Draw(draw_list, image_a, image_b, clip_a, clip_b, Options::Images::upload_budget_per_frame);
+            draw_list.ChannelsSetCurrent(0);
+            if ((!pyramid || pyramid->HasMissingTiles()) && image.IsReady())
+                draw_list.AddImage(image.thumbnail.Handle(), image_a, image_b);
+            draw_list.ChannelsMerge();
+
+            if (image.full_resolution.error.size() > 0)
+                draw_list.AddText(clip_a + fvec2(ImGui::GetStyle().FramePadding), ImGui::GetColorU32(fvec4(0.8,0,0,1)), "Не удалось загрузить изображение в полном размере.");
+
+            draw_list.PopClipRect();
+            draw_list.AddRect(clip_a, clip_b, ImGui::GetColorU32(ImGuiCol_Border));
 
             ImGui::EndPopup();
         }
@@ -98,5 +122,15 @@ void GuiElements::ImageViewer::Display()
     else
     {
         modal_open = 0;
+        if (current_image)
+        {
+            current_image->ReleaseFullResolution();
+            current_image = nullptr;
+        }
     }
 }
+
+bool GuiElements::ImageViewer::WantsContinuousRedraw() const
+{
+    return current_image && current_image->full_resolution.pyramid && current_image->full_resolution.pyramid->HasMissingTiles();
+}
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <memory>
+
 #include "main/images.h"
 #include "utils/mat.h"
 
@@ -9,7 +11,7 @@ namespace GuiElements
     {
         static constexpr const char *modal_name = "image_view_modal";
         bool modal_open = 0;
-        const Data::Image *current_image = 0;
+        std::shared_ptr<Data::Image> current_image; // We keep it alive, in case the tab is closed while it's open. Its full resolution is released when the viewer closes.
         float scale_power = 0;
         fvec2 offset = fvec2(0);
         float scale = 1;
@@ -19,5 +21,8 @@ namespace GuiElements
 
       public:
         void Display();
+
+        // Returns true if the visible tiles of the image are still being uploaded.
+        [[nodiscard]] bool WantsContinuousRedraw() const;
     };
 }
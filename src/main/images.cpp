@@ -0,0 +1,19 @@
+#include "images.h"
+
+#include "main/image_cache.h"
+
+namespace Data
+{
+    bool Image::Use()
+    {
+        last_use_frame = image_cache.CurrentFrame();
+
+        if (!thumbnail.requested)
+        {
+            thumbnail.requested = true;
+            image_loader.Enqueue(shared_from_this(), ImageLoader::thumbnail);
+        }
+
+        return thumbnail.ready;
+    }
+}
@@ -1,90 +1,127 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
 #include <memory>
-#include <set>
 #include <string>
 
 #include "imgui.h"
 
+#include "graphics/image.h"
 #include "graphics/texture.h"
+#include "macros/finally.h"
+#include "main/image_loader.h"
+#include "main/options.h"
 #include "program/errors.h"
-#include "stream/readonly_data.h"
+#include "stream/better_fopen.h"
 
 namespace Data // Images
 {
-    class Image
+    class ImagePyramid;
+
+    // An image from a file. Use `ImageCache::Load()` to obtain them.
+    class Image : public std::enable_shared_from_this<Image>
     {
       public:
-        std::string file_name;
-        Graphics::TexObject texture;
-        ivec2 pixel_size = ivec2(0);
-
-      private:
-        struct LoadedImage
+        // A texture holding the image at some resolution.
+        struct Level
         {
-            std::shared_ptr<Image> data;
+            // Images with identical contents share the textures, see `ImageCache`.
+            std::shared_ptr<const Graphics::TexObject> texture; // Don't use it until `ready` is true, it might be partially uploaded.
+            ivec2 size = ivec2(0); // Set when the upload starts.
+            int channels = 4; // Opaque and grayscale images use less channels, see `Graphics::Image`.
+            bool requested = false; // Set when the level is queued for loading. Resetting the level discards the pending result.
+            bool ready = false;
+            std::string error; // If the decoding fails, this is set instead of `ready`.
 
-            operator const std::string &() const
+            [[nodiscard]] static std::size_t BytesForSize(ivec2 size, int channels)
             {
-                DebugAssert("Loaded image handle is null.", bool(data));
-                return data->file_name;
+                return std::size_t(size.prod()) * channels;
             }
 
-            friend bool operator<(const std::string &a, const std::string &b)
+            [[nodiscard]] std::size_t Bytes() const
             {
-                return a < b;
+                return BytesForSize(size, channels);
             }
-        };
-
-      public:
-        class Cache
-        {
-            using image_set_t = std::set<LoadedImage, std::less<>>;
-            std::shared_ptr<image_set_t> loaded_images;
-
-          public:
-            Cache() : loaded_images(std::make_shared<image_set_t>()) {}
-            Cache(const Cache &other) : loaded_images(other.loaded_images) {}
-            Cache &operator=(const Cache &other) {loaded_images = other.loaded_images; return *this;}
 
-            [[nodiscard]] std::shared_ptr<Image> Load(std::string file_name)
+            ImTextureID Handle() const
             {
-                auto it = loaded_images->find(file_name);
-                if (it == loaded_images->end())
-                    return loaded_images->emplace(LoadedImage{std::make_shared<Image>(file_name)}).first->data;
-                else
-                    return it->data;
+                return (ImTextureID)(uintptr_t)texture->Handle();
             }
+        };
 
-            void Reset()
-            {
-                loaded_images->clear();
-            }
+        std::string file_name;
+        ivec2 pixel_size = ivec2(0); // The full size. This is known right away, from the file header.
+
+        // Those are set by `ImageCache`, they're used as a key for `ThumbnailDiskCache`.
+        std::int64_t modification_time = 0;
+        std::uintmax_t file_size = 0;
+
+        // A downscaled copy for the image lists, no larger than `Options::Images::thumbnail_max_size`.
+        // It's loaded when the image is first used, and can be evicted by `ImageCache` when it's not used for a while.
+        Level thumbnail;
+        // Only loaded on request, for the image viewer. See `RequestFullResolution()`.
+        // Instead of a single texture, this is split into tiles at several mip levels, since the images can be larger than the maximum texture size.
+        struct FullResolution
+        {
+            bool requested = false; // Set when the image is queued for loading. Resetting this struct discards the pending result.
+            std::shared_ptr<ImagePyramid> pyramid; // Null until it's loaded.
+            std::string error; // If the decoding fails, this is set instead of `pyramid`.
         };
+        FullResolution full_resolution;
+
+        std::uint64_t last_use_frame = 0; // See `Use()`.
 
-        // Don't use this constructor directly, as it doesn't do caching. Use `Cache::Load()` instead.
+        // Don't use this constructor directly, as it doesn't do caching. Use `ImageCache::Load()` instead.
+        // Only reads the header, to know the size. The pixels are decoded in the background by `ImageLoader`.
         Image(std::string file_name) : file_name(file_name)
         {
-            Stream::ReadOnlyData file(file_name);
-            try
-            {
-                Graphics::Image image(file);
-                pixel_size = image.Size();
-                texture = Graphics::TexObject(nullptr);
-                Graphics::TexUnit(texture).Interpolation(Graphics::linear).Wrap(Graphics::fill).SetData(image);
-            }
-            catch (std::exception &e)
-            {
-                Program::Error("While loading image `", file_name, "`: ", e.what());
-            }
+            FILE *file = Stream::better_fopen(file_name.c_str(), "rb");
+            if (!file)
+                Program::Error("Unable to open image `", file_name, "`.");
+            FINALLY( std::fclose(file); )
+
+            int channels = 0;
+            if (!stbi_info_from_file(file, &pixel_size.x, &pixel_size.y, &channels) || pixel_size.x <= 0 || pixel_size.y <= 0)
+                Program::Error("Unable to parse image `", file_name, "`.");
+        }
+
+        // Returns the thumbnail size for an image of size `full_size`, preserving the aspect ratio.
+        [[nodiscard]] static ivec2 ThumbnailSize(ivec2 full_size)
+        {
+            int max_side = full_size.max();
+            if (max_side <= Options::Images::thumbnail_max_size)
+                return full_size;
+            return clamp_min(iround(full_size * (Options::Images::thumbnail_max_size / float(max_side))), 1);
+        }
+
+        // Returns true when the thumbnail is loaded.
+        [[nodiscard]] bool IsReady() const
+        {
+            return thumbnail.ready;
+        }
+
+        // Marks the image as used in this frame, which protects the thumbnail from eviction.
+        // Starts loading the thumbnail if it's not loaded or loading already. Returns `IsReady()`.
+        bool Use();
+
+        // Starts loading the full resolution texture, if it's not loaded or loading already.
+        void RequestFullResolution()
+        {
+            if (full_resolution.requested)
+                return;
+            full_resolution.requested = true;
+            image_loader.Enqueue(shared_from_this(), ImageLoader::full_resolution);
         }
 
-        ImTextureID TextureHandle() const
+        // Frees the full resolution image and its tiles. If it's still loading, the result will be discarded.
+        void ReleaseFullResolution()
         {
-            return (ImTextureID)(uintptr_t)texture.Handle();
+            full_resolution = {};
         }
     };
 
     [[maybe_unused]] // Clang is silly.
-    inline const Image *clicked_image = 0;
+    inline std::shared_ptr<Image> clicked_image;
 }
@@ -1,11 +1,26 @@
+#include <cstdlib>
 #include <iostream>
 
+#include "main/allocation_counter.h"
 #include "main/common.h"
 #include "main/file_dialogs.h"
+#include "main/font_atlas_cache.h"
+#include "main/function_runner.h"
 #include "main/gui_strings.h"
+#include "main/image_cache.h"
+#include "main/image_loader.h"
 #include "main/image_viewer.h"
 #include "main/options.h"
 #include "main/procedure_data.h"
+#include "main/procedure_file.h"
+#include "main/report_exporter.h"
+#include "main/report_journal.h"
+#include "main/report_writer.h"
+#include "main/search_panel.h"
+#include "main/template_browser.h"
+#include "main/template_history.h"
+#include "main/template_index.h"
+#include "main/thumbnail_disk_cache.h"
 #include "main/widgets.h"
 
 namespace fs = std::filesystem;
@@ -18,11 +33,24 @@ Input::Mouse mouse;
 
 fs::path program_directory;
 
+struct FrameStats
+{
+    uint64_t rendered = 0; // Frames that were actually drawn and presented.
+    uint64_t skipped = 0; // Frames that were ticked, but not presented because nothing changed on screen.
+    uint64_t allocations_last_frame = 0; // Heap allocations made during the last frame, see `AllocationCounter`.
+};
+FrameStats frame_stats;
+
 struct State
 {
     bool exit_requested = 0;
 
+    State() = default;
+    State(const State &) = delete; // States own threads and other non-copyable things.
+    State &operator=(const State &) = delete;
+
     virtual void Tick() = 0;
+    virtual bool WantsContinuousRedraw() const {return false;} // If true, we keep redrawing even if there are no events.
     virtual ~State() = default;
 };
 
@@ -33,13 +61,23 @@ struct StateMain : State
         Data::Procedure proc;
         std::string pretty_name;
         fs::path path; // Don't modify this directly. Use `AssignPath()`.
+        std::string path_string; // Same as `path.string()`, cached to avoid recomputing it every frame.
+        Data::EscapedLabel tab_label;
         bool first_tick = 1;
 
         int visible_step = 0;
         bool should_adjust_step_list_scrolling = 0;
 
+        std::string step_filter; // Only the steps containing this string (case-insensitively) are listed.
+        bool step_names_changed = 1; // Set this when steps are added, removed, reordered or renamed, to update `step_search_names`.
+        std::vector<std::string> step_search_names; // Step names converted with `LowercaseForSearch()`.
+        std::vector<std::string> step_display_names; // Step names converted with `EscapeStringForWidgetName()`.
+        std::vector<int> filtered_steps; // Indices of the steps matching `step_filter`.
+
         bool now_previewing_template = false; // Only makes sense for templates.
 
+        std::size_t journal_size = 0; // Only makes sense for reports. The journal size in bytes, including the records that are not written yet.
+
         int step_insertion_pos = -1; // Only makes sense for templates.
         int step_deletion_pos = -1; // Only makes sense for templates.
         int step_swap_pos = -1; // Only makes sense for templates.
@@ -48,6 +86,8 @@ struct StateMain : State
         int widget_deletion_pos = -1; // Only makes sense for templates.
         int widget_swap_pos = -1; // Only makes sense for templates.
 
+        Data::TemplateHistory history; // Only makes sense for templates.
+
         inline static unsigned int id_counter = 1;
         int id = id_counter++;
 
@@ -58,6 +98,7 @@ struct StateMain : State
                 new_path.replace_extension(IsTemplate() ? Options::template_extension : Options::report_extension);
 
             path = fs::weakly_canonical(new_path);
+            path_string = path.string();
             pretty_name = path.stem().string(); // `stem` means file name without extension.
         }
 
@@ -66,6 +107,37 @@ struct StateMain : State
             return proc.current_step >= int(proc.steps.size());
         }
 
+        // Updates `filtered_steps`. Does nothing if neither the steps nor the filter have changed.
+        void UpdateStepFilter(bool filter_changed)
+        {
+            if (step_names_changed)
+            {
+                step_search_names.clear();
+                step_search_names.reserve(proc.steps.size());
+                step_display_names.clear();
+                step_display_names.reserve(proc.steps.size());
+                for (const Data::ProcedureStep &step : proc.steps)
+                {
+                    step_search_names.push_back(Data::LowercaseForSearch(step.name));
+                    step_display_names.push_back(Data::EscapeStringForWidgetName(step.name));
+                }
+            }
+            else if (!filter_changed)
+            {
+                return;
+            }
+
+            step_names_changed = 0;
+
+            std::string filter = Data::LowercaseForSearch(step_filter);
+            filtered_steps.clear();
+            for (std::size_t i = 0; i < step_search_names.size(); i++)
+            {
+                if (step_search_names[i].find(filter) != std::string::npos)
+                    filtered_steps.push_back(i);
+            }
+        }
+
         bool IsTemplate() const
         {
             return proc.current_step == -1;
@@ -78,6 +150,12 @@ struct StateMain : State
     bool HaveActiveTab() const {return active_tab >= 0 && active_tab < int(tabs.size());}
 
     GuiElements::ImageViewer image_viewer;
+    GuiElements::TemplateBrowser template_browser;
+    GuiElements::SearchPanel search_panel;
+
+    Data::ReportWriter report_writer;
+
+    bool export_progress_requested = false;
 
     StateMain() {}
 
@@ -101,8 +179,28 @@ struct StateMain : State
         }
         else
         {
-            Stream::Input input_stream(path.string());
-            new_tab.proc = Refl::FromString<Data::Procedure>(input_stream);
+            new_tab.proc = ProcedureFile::Read(Stream::ReadOnlyData::file(path.string()), true);
+
+            if (!expect_template)
+            {
+                std::string damage;
+                new_tab.journal_size = Journal::Replay(new_tab.proc, path, &damage);
+                try
+                {
+                    // New records will be appended after the last valid one.
+                    Journal::Truncate(path, new_tab.journal_size);
+                }
+                catch (std::exception &e)
+                {
+                    // Otherwise new records would end up after the ignored ones, so the next change saves the full report, which removes the journal.
+                    new_tab.journal_size = Options::journal_compaction_threshold;
+                    if (damage.size() > 0)
+                        damage += "\n\n";
+                    damage += e.what();
+                }
+                if (damage.size() > 0)
+                    Interface::MessageBox(Interface::MessageBoxType::warning, "Error", damage);
+            }
         }
 
         // Validate data.
@@ -126,6 +224,8 @@ struct StateMain : State
         // Note that this has to be done after setting the resource directory.
         if (!new_tab.IsTemplate())
             Widgets::InitializeWidgets(new_tab.proc);
+        else
+            new_tab.history.Reset(new_tab.proc);
 
         // Set the visible step.
         new_tab.visible_step = 0;
@@ -160,7 +260,9 @@ struct StateMain : State
             new_tab.AssignPath(report_path);
             Widgets::InitializeWidgets(new_tab.proc); // This is not done automatically for tabs loaded as templates.
 
-            AddTab(std::move(new_tab));
+            Tab &tab = AddTab(std::move(new_tab));
+            // Write the report right away, so that the journal always has a report to apply to.
+            report_writer.Save(tab.id, tab.path, tab.proc, Options::report_format);
         }
         catch (std::exception &e)
         {
@@ -220,27 +322,130 @@ struct StateMain : State
         }
     }
 
-    bool Tab_Save() // Returns `true` on success.
+    // Saves the active tab in the background.
+    // If `wait` is false, returns `true` immediately, and the errors are reported later by `ReportSaveFailures()`.
+    // If `wait` is true, blocks until the file is written and returns `true` on success.
+    bool Tab_Save(bool wait = false)
     {
         if (!HaveActiveTab())
             return 0;
 
+        Tab &tab = tabs[active_tab];
+
         try
         {
-            Stream::Output output_stream(tabs[active_tab].path.string());
-            Refl::ToString(tabs[active_tab].proc, output_stream, Refl::ToStringOptions::Pretty());
-            output_stream.Flush();
-            return 1;
+            report_writer.Save(tab.id, tab.path, tab.proc, tab.IsTemplate() ? Options::template_format : Options::report_format);
+            tab.journal_size = 0; // Writing the full report removes the journal.
         }
         catch (std::exception &e)
         {
-            Interface::MessageBox(Interface::MessageBoxType::warning, "Error", "Unable to save `{}`:\n{}"_format(tabs[active_tab].path.string(), e.what()));
+            Interface::MessageBox(Interface::MessageBoxType::warning, "Error", "Unable to save `{}`:\n{}"_format(tab.path.string(), e.what()));
             return 0;
         }
+
+        if (!wait)
+            return 1;
+
+        return report_writer.Wait(tab.id) == Data::ReportWriter::Status::saved;
+    }
+
+    // Exports the reports from `directory` in the background. The format is chosen by the extension of `output_file`, CSV by default.
+    void ExportReports(fs::path directory, fs::path output_file)
+    {
+        if (!output_file.has_extension())
+            output_file.replace_extension(".csv");
+
+        auto format = output_file.extension() == ".jsonl" ? Data::ReportExporter::Format::jsonl : Data::ReportExporter::Format::csv;
+        Data::report_exporter.Start(std::move(directory), std::move(output_file), format);
+        export_progress_requested = true;
+    }
+
+    // Undoes or redoes the last change in the active template.
+    void Tab_Undo(bool redo = false)
+    {
+        if (!HaveActiveTab())
+            return;
+
+        Tab &tab = tabs[active_tab];
+        if (!tab.IsTemplate() || tab.now_previewing_template)
+            return;
+
+        int visible_step = tab.visible_step;
+        if (!(redo ? tab.history.Redo(tab.proc, visible_step) : tab.history.Undo(tab.proc, visible_step)))
+            return;
+
+        tab.visible_step = clamp(visible_step, 0, int(tab.proc.steps.size()) - 1);
+        tab.should_adjust_step_list_scrolling = true;
+        tab.step_names_changed = true;
+
+        // The positions could refer to the widgets that no longer exist.
+        tab.widget_deletion_pos = -1;
+        tab.widget_swap_pos = -1;
+        tab.step_insertion_pos = -1;
+        tab.step_deletion_pos = -1;
+        tab.step_swap_pos = -1;
+    }
+
+    // Appends a record to the journal of the active report.
+    // If the journal grows too large, saves the full report instead, which removes the journal.
+    void Tab_AppendJournal(std::string record)
+    {
+        if (!HaveActiveTab())
+            return;
+
+        Tab &tab = tabs[active_tab];
+        if (tab.IsTemplate())
+            return; // Templates don't have journals.
+
+        tab.journal_size += record.size();
+        if (tab.journal_size > Options::journal_compaction_threshold)
+        {
+            Tab_Save();
+            return;
+        }
+
+        report_writer.AppendJournal(tab.id, tab.path, std::move(record));
+    }
+
+    void ReportSaveFailures()
+    {
+        for (const Data::ReportWriter::Failure &failure : report_writer.TakeFailures())
+            Interface::MessageBox(Interface::MessageBoxType::warning, "Error", "Unable to save `{}`:\n{}"_format(failure.path.string(), failure.message));
+    }
+
+    void ReportFunctionFailures()
+    {
+        for (const Data::FunctionRunner::Failure &failure : Data::function_runner.Update())
+            Interface::MessageBox(Interface::MessageBoxType::warning, "Function error", failure.message);
+    }
+
+    // Returns a short description of a saving status, to be displayed next to the tab name.
+    static const char *SaveStatusString(Data::ReportWriter::Status status)
+    {
+        switch (status)
+        {
+          case Data::ReportWriter::Status::none:
+            return "";
+          case Data::ReportWriter::Status::saving:
+            return "сохранение...";
+          case Data::ReportWriter::Status::saved:
+            return "сохранено";
+          case Data::ReportWriter::Status::failed:
+            return "не сохранено!";
+        }
+        return "";
+    }
+
+    bool WantsContinuousRedraw() const override
+    {
+        return image_viewer.WantsContinuousRedraw() || search_panel.WantsContinuousRedraw();
     }
 
     void Tick() override
     {
+        ReportSaveFailures();
+        ReportFunctionFailures();
+
         for (const std::string &new_file : window.DroppedFiles())
             Tab_LoadReportOrTemplate(new_file);
 
@@ -302,6 +507,19 @@ struct StateMain : State
                             Tab_LoadReportOrTemplate(*result);
                     }
 
+                    if (ImGui::MenuItem("Обзор шаблонов"))
+                        template_browser.Open();
+
+                    if (ImGui::MenuItem("Поиск по отчетам"))
+                        search_panel.Open(program_directory / Options::Search::index_dir);
+
+                    if (ImGui::MenuItem("Экспорт отчетов"))
+                    {
+                        if (auto directory = FileDialogs::SelectFolder("Папка с отчетами"))
+                            if (auto output_file = FileDialogs::SaveExport())
+                                ExportReports(*directory, *output_file);
+                    }
+
                     ImGui::Separator();
 
                     if (ImGui::IsItemHovered() && HaveActiveTab() && !tabs[active_tab].IsTemplate())
@@ -335,11 +553,11 @@ struct StateMain : State
 
                         if (got_path)
                         {
-                            bool ok = Tab_Save();
+                            bool ok = Tab_Save(true);
                             if (!ok)
                             {
                                 got_path = false;
-                                Interface::MessageBox(Interface::MessageBoxType::error, "Error", "Unable to write file.");
+                                ReportSaveFailures();
                             }
                         }
 
@@ -357,12 +575,50 @@ struct StateMain : State
                     ImGui::EndMenu();
                 }
 
+                if (ImGui::BeginMenu("Правка"))
+                {
+                    bool can_edit = HaveActiveTab() && tabs[active_tab].IsTemplate() && !tabs[active_tab].now_previewing_template;
+
+                    if (ImGui::MenuItem("Отменить", "Ctrl+Z", nullptr, can_edit && tabs[active_tab].history.CanUndo()))
+                        Tab_Undo();
+                    if (ImGui::MenuItem("Повторить", "Ctrl+Y", nullptr, can_edit && tabs[active_tab].history.CanRedo()))
+                        Tab_Undo(true);
+
+                    ImGui::EndMenu();
+                }
+
+                if (ImGui::BeginMenu("Отладка"))
+                {
+                    uint64_t total_frames = frame_stats.rendered + frame_stats.skipped;
+                    ImGui::TextUnformatted("Кадров отрисовано: {}"_format(frame_stats.rendered).c_str());
+                    ImGui::TextUnformatted("Кадров пропущено: {} ({:.1f}%)"_format(frame_stats.skipped, total_frames ? frame_stats.skipped * 100. / total_frames : 0).c_str());
+                    ImGui::TextUnformatted("Выделений памяти за кадр: {}"_format(frame_stats.allocations_last_frame).c_str());
+
+                    const Data::ImageCache::Stats &image_stats = Data::image_cache.GetStats();
+                    ImGui::Separator();
+                    ImGui::TextUnformatted("Изображений загружено: {}"_format(image_stats.live_images).c_str());
+                    ImGui::TextUnformatted("Память текстур: {:.1f} / {:.1f} МБ"_format(image_stats.texture_bytes / 1048576., Data::image_cache.MemoryBudget() / 1048576.).c_str());
+                    ImGui::TextUnformatted("Память текстур просмотра: {:.1f} / {:.1f} МБ"_format(image_stats.viewer_texture_bytes / 1048576., Options::Images::viewer_texture_budget / 1048576.).c_str());
+                    ImGui::TextUnformatted("Попаданий в кэш: {}, промахов: {}"_format(image_stats.hits, image_stats.misses).c_str());
+                    ImGui::TextUnformatted("Общих текстур: {}, вытеснений: {}"_format(image_stats.shared_textures, image_stats.evictions).c_str());
+                    ImGui::EndMenu();
+                }
+
                 ImGui::EndMenuBar();
             }
         }
 
         ImGui::PopStyleVar(3);
 
+        // Undo shortcuts. They are ignored while a text field is active, since it has its own undo.
+        if (!ImGui::IsAnyItemActive() && (Input::Button(Input::l_ctrl).down() || Input::Button(Input::r_ctrl).down()))
+        {
+            if (Input::Button(Input::z).pressed())
+                Tab_Undo();
+            else if (Input::Button(Input::y).pressed())
+                Tab_Undo(true);
+        }
+
         bool need_step_end_confirmation = 0;
         auto EndStep = [&]
         {
@@ -376,7 +632,7 @@ struct StateMain : State
 
             tab.proc.current_step++;
 
-            Tab_Save();
+            Tab_AppendJournal(Journal::CurrentStepRecord(tab.proc.current_step));
 
             if (tab.IsFinished()) // Sic!
                 return;
@@ -409,6 +665,7 @@ struct StateMain : State
                     active_tab = tab_index;
 
                     Tab_Save();
+                    report_writer.Forget(tabs[tab_index].id);
 
                     tabs.erase(tabs.begin() + tab_index);
                 };
@@ -419,12 +676,21 @@ struct StateMain : State
 
                     bool keep_tab_open = 1;
 
+                    Data::ReportWriter::Status save_status_enum = report_writer.GetStatus(tab.id);
+                    const char *save_status = SaveStatusString(save_status_enum);
+                    // "Saved" is only shown in the window title, to avoid cluttering the tab bar.
+                    bool show_save_status_in_tab = save_status_enum == Data::ReportWriter::Status::saving || save_status_enum == Data::ReportWriter::Status::failed;
+
                     // The current tab
-                    if (ImGui::BeginTabItem(Str(Data::EscapeStringForWidgetName(tab.pretty_name), "###tab:", tab.id).c_str(), &keep_tab_open))
+                    const char *tab_label = show_save_status_in_tab ? Data::frame_scratch.Str(tab.tab_label.Get(tab.pretty_name), " (", save_status, ")###tab:", tab.id)
+                                                                    : Data::frame_scratch.Str(tab.tab_label.Get(tab.pretty_name), "###tab:", tab.id);
+                    if (ImGui::BeginTabItem(tab_label, &keep_tab_open))
                     {
                         FINALLY( ImGui::EndTabItem(); )
 
-                        window.SetTitle("{}{} - {} - {}"_format(tab.proc.name, tab.proc.IsTemplate() ? " [шаблон]" : "", tab.path.string(), program_name));
+                        bool have_save_status = *save_status != '\0';
+                        window.SetTitle(Data::frame_scratch.Str(tab.proc.name, tab.proc.IsTemplate() ? " [шаблон]" : "", have_save_status ? " [" : "", save_status, have_save_status ? "]" : "",
+                            " - ", tab.path_string, " - ", program_name));
 
                         ImGui::PushStyleVar(ImGuiStyleVar_FrameBorderSize, old_frame_border_size);
                         FINALLY( ImGui::PopStyleVar(); )
@@ -462,6 +728,18 @@ struct StateMain : State
                         else if (int max_list_column_width = iround(Options::Visual::step_list_max_width_relative * ImGui::GetWindowContentRegionWidth()); list_column_width > max_list_column_width)
                             ImGui::SetColumnWidth(-1, max_list_column_width);
 
+                        // Large files have their steps loaded on demand. If this fails, the step is displayed without widgets, along with the error.
+                        std::string step_load_error;
+                        try
+                        {
+                            tab.proc.LoadStep(tab.visible_step);
+                        }
+                        catch (std::exception &e)
+                        {
+                            step_load_error = e.what();
+                        }
+                        tab.proc.UnloadSteps(Options::LazySteps::max_loaded_bytes, {tab.visible_step, tab.proc.current_step});
+
                         Data::ProcedureStep &current_step = tab.proc.steps[tab.visible_step];
 
                         { // Step list
@@ -471,7 +749,8 @@ struct StateMain : State
                                 FINALLY( ImGui::PopItemWidth(); );
 
                                 ImGui::TextUnformatted("Название процедуры");
-                                ImGui::InputText("###proc_name_input", &tab.proc.name);
+                                if (ImGui::InputText("###proc_name_input", &tab.proc.name))
+                                    tab.history.ProcedureChanged();
 
 
                                 if (ImGui::SmallButton("Список библиотек"))
@@ -501,11 +780,13 @@ struct StateMain : State
 
                                         ImGui::Separator();
 
+                                        bool libraries_changed = false;
+
                                         int lib_index = 0, del_lib_index = -1;
                                         for (Data::Library &lib : tab.proc.libraries)
                                         {
-                                            ImGui::InputText("ID###libname:{}"_format(lib_index).c_str(), &lib.id);
-                                            ImGui::InputText("Файл (без расширения)###libfile:{}"_format(lib_index).c_str(), &lib.file);
+                                            libraries_changed |= ImGui::InputText("ID###libname:{}"_format(lib_index).c_str(), &lib.id);
+                                            libraries_changed |= ImGui::InputText("Файл (без расширения)###libfile:{}"_format(lib_index).c_str(), &lib.file);
 
                                             if (ImGui::SmallButton("Удалить###libfuncdel:{}"_format(lib_index).c_str()))
                                                 del_lib_index = lib_index;
@@ -523,8 +804,8 @@ struct StateMain : State
                                                 int func_index = 0, del_func_index = -1;
                                                 for (Data::LibraryFunc &func : lib.functions)
                                                 {
-                                                    ImGui::InputText("ID###libfunclib:{}:{}"_format(lib_index, func_index).c_str(), &func.id);
-                                                    ImGui::InputText("Имя в библиотеке###libfunclib:{}:{}"_format(lib_index, func_index).c_str(), &func.name);
+                                                    libraries_changed |= ImGui::InputText("ID###libfunclib:{}:{}"_format(lib_index, func_index).c_str(), &func.id);
+                                                    libraries_changed |= ImGui::InputText("Имя в библиотеке###libfunclib:{}:{}"_format(lib_index, func_index).c_str(), &func.name);
                                                     if (ImGui::SmallButton("Удалить###libfuncdel:{}:{}"_format(lib_index, func_index).c_str()))
                                                         del_func_index = func_index;
 
@@ -535,10 +816,16 @@ struct StateMain : State
                                                 }
 
                                                 if (del_func_index != -1)
+                                                {
                                                     lib.functions.erase(lib.functions.begin() + del_func_index);
+                                                    libraries_changed = true;
+                                                }
 
                                                 if (ImGui::Button("+"))
+                                                {
                                                     lib.functions.emplace_back();
+                                                    libraries_changed = true;
+                                                }
                                             }
 
                                             ImGui::Spacing();
@@ -549,14 +836,24 @@ struct StateMain : State
                                         }
 
                                         if (del_lib_index != -1)
+                                        {
                                             tab.proc.libraries.erase(tab.proc.libraries.begin() + del_lib_index);
+                                            libraries_changed = true;
+                                        }
 
                                         if (ImGui::Button("+"))
+                                        {
                                             tab.proc.libraries.emplace_back();
+                                            libraries_changed = true;
+                                        }
+
+                                        if (libraries_changed)
+                                            tab.history.ProcedureChanged();
                                     }
                                 }
 
-                                ImGui::Checkbox("Спрашивать\nпри закрытии", &tab.proc.confirm_exit);
+                                if (ImGui::Checkbox("Спрашивать\nпри закрытии", &tab.proc.confirm_exit))
+                                    tab.history.ProcedureChanged();
 
                                 ImGui::Spacing();
                             }
@@ -574,22 +871,45 @@ struct StateMain : State
                                     tab.step_insertion_pos = tab.visible_step + 1;
                             }
 
-                            ImGui::BeginChildFrame(ImGui::GetID("step_list:{}"_format(tab.visible_step).c_str()), ImGui::GetContentRegionAvail(), ImGuiWindowFlags_HorizontalScrollbar);
+                            { // Step filter
+                                ImGui::PushItemWidth(ImGui::GetContentRegionAvail().x);
+                                FINALLY( ImGui::PopItemWidth(); )
 
-                            for (std::size_t i = 0; i < tab.proc.steps.size(); i++)
-                            {
-                                ImGui::PushStyleColor(ImGuiCol_Text, ImGui::GetStyleColorVec4(int(i) > tab.proc.current_step && !tab.IsTemplate() ? ImGuiCol_TextDisabled : ImGuiCol_Text));
-                                FINALLY( ImGui::PopStyleColor(); )
+                                bool filter_changed = ImGui::InputTextWithHint("###step_filter", "Поиск", &tab.step_filter);
+                                tab.UpdateStepFilter(filter_changed);
+                            }
+
+                            ImGui::BeginChildFrame(ImGui::GetID(Data::frame_scratch.Str("step_list:", tab.visible_step)), ImGui::GetContentRegionAvail(), ImGuiWindowFlags_HorizontalScrollbar);
 
-                                if (ImGui::Selectable(Data::EscapeStringForWidgetName(tab.proc.steps[i].name).c_str(), int(i) == tab.visible_step))
+                            // Only the visible part of the list is submitted, so long lists don't slow down each frame.
+                            float step_height = ImGui::GetTextLineHeightWithSpacing();
+
+                            if (tab.should_adjust_step_list_scrolling)
+                            {
+                                // We can't use `SetScrollHereY()`, since the target step is not necessarily submitted, so we compute its position manually.
+                                auto it = std::lower_bound(tab.filtered_steps.begin(), tab.filtered_steps.end(), tab.visible_step);
+                                if (it != tab.filtered_steps.end() && *it == tab.visible_step)
                                 {
-                                    tab.visible_step = i;
+                                    float step_y = ImGui::GetCursorScreenPos().y + (it - tab.filtered_steps.begin()) * step_height;
+                                    ImGui::SetScrollFromPosY(step_y + step_height * 0.75 - ImGui::GetWindowPos().y, 0.75);
                                 }
+                                tab.should_adjust_step_list_scrolling = 0;
+                            }
 
-                                if (tab.should_adjust_step_list_scrolling && int(i) == tab.visible_step)
+                            ImGuiListClipper clipper(tab.filtered_steps.size(), step_height);
+                            while (clipper.Step())
+                            {
+                                for (int j = clipper.DisplayStart; j < clipper.DisplayEnd; j++)
                                 {
-                                    ImGui::SetScrollHereY(0.75);
-                                    tab.should_adjust_step_list_scrolling = 0;
+                                    int i = tab.filtered_steps[j];
+
+                                    ImGui::PushStyleColor(ImGuiCol_Text, ImGui::GetStyleColorVec4(i > tab.proc.current_step && !tab.IsTemplate() ? ImGuiCol_TextDisabled : ImGuiCol_Text));
+                                    FINALLY( ImGui::PopStyleColor(); )
+
+                                    if (ImGui::Selectable(Data::frame_scratch.Str(tab.step_display_names[i], "###step:", i), i == tab.visible_step))
+                                    {
+                                        tab.visible_step = i;
+                                    }
                                 }
                             }
 
@@ -650,10 +970,15 @@ struct StateMain : State
                                 ImGui::PushItemWidth(ImGui::GetContentRegionAvail().x * 0.35);
                                 FINALLY( ImGui::PopItemWidth(); )
 
-                                ImGui::InputText("###step_name", &current_step.name);
+                                if (ImGui::InputText("###step_name", &current_step.name))
+                                {
+                                    tab.step_names_changed = 1;
+                                    tab.history.StepChanged(tab.visible_step);
+                                }
 
                                 ImGui::SameLine();
-                                ImGui::Checkbox("Требовать подтверждения шага", &current_step.confirm);
+                                if (ImGui::Checkbox("Требовать подтверждения шага", &current_step.confirm))
+                                    tab.history.StepChanged(tab.visible_step);
                             }
                             else
                             {
@@ -666,7 +991,7 @@ struct StateMain : State
 
                             int bottom_panel_h = ImGui::GetFrameHeightWithSpacing();
                             // ImGui::BeginChildFrame(ImGui::GetID(Str("widgets:", tab.proc.current_step).c_str()), fvec2(0, -bottom_panel_h), 1);
-                            ImGui::BeginChildFrame(ImGui::GetID(Str("widgets{}:", tab.now_previewing_template ? "" : "_editing", tab.proc.current_step).c_str()),
+                            ImGui::BeginChildFrame(ImGui::GetID(Data::frame_scratch.Str("widgets{}:", tab.now_previewing_template ? "" : "_editing", tab.proc.current_step)),
                                 ivec2(ImGui::GetContentRegionAvail()) + ivec2(ImGui::GetStyle().WindowPadding.x, tab.IsTemplate() ? 0 : -bottom_panel_h), 1);
 
 
@@ -677,7 +1002,7 @@ struct StateMain : State
                                 FINALLY( ImGui::Unindent(indent_w); )
 
                                 static constexpr const char *text = "Вставить виджет";
-                                if (ImGui::SmallButton("{}###insert_widget:{}"_format(text, index).c_str()))
+                                if (ImGui::SmallButton(Data::frame_scratch.Str(text, "###insert_widget:", index)))
                                 {
                                     tab.widget_insertion_pos = index;
                                     ImGui::OpenPopup("new_widget");
@@ -685,12 +1010,20 @@ struct StateMain : State
                             };
 
 
+                            if (!step_load_error.empty())
+                                ImGui::TextColored(fvec4(0.8,0,0,1), "%s", "Не удалось загрузить шаг:\n{}"_format(step_load_error).c_str());
+
+                            if (tab.IsTemplate() && !tab.now_previewing_template)
+                                tab.history.BeginEditingStep(tab.proc, tab.visible_step);
+
                             // Widget list.
                             int widget_index = 0;
                             for (Widgets::Widget &widget : current_step.widgets)
                             {
                                 if (tab.IsTemplate() && !tab.now_previewing_template)
                                 {
+                                    tab.proc.MarkStepModified(tab.visible_step); // The editor can change anything, so the step can't be unloaded anymore.
+
                                     // Customization controls
 
                                     if (widget_index != 0)
@@ -709,14 +1042,14 @@ struct StateMain : State
 
                                     ImGui::SetCursorPosX(ImGui::GetCursorPosX() + ImGui::GetContentRegionAvail().x - button_total_w);
 
-                                    if (ImGui::SmallButton("{}###move_widget_up:{}"_format(button_up, widget_index).c_str()))
+                                    if (ImGui::SmallButton(Data::frame_scratch.Str(button_up, "###move_widget_up:", widget_index)))
                                         tab.widget_swap_pos = widget_index - 1;
 
                                     ImGui::SameLine();
-                                    if (ImGui::SmallButton("{}###move_widget_down:{}"_format(button_down, widget_index).c_str()))
+                                    if (ImGui::SmallButton(Data::frame_scratch.Str(button_down, "###move_widget_down:", widget_index)))
                                         tab.widget_swap_pos = widget_index;
                                     ImGui::SameLine();
-                                    if (ImGui::SmallButton("{}###move_widget_delete:{}"_format(button_delete, widget_index).c_str()))
+                                    if (ImGui::SmallButton(Data::frame_scratch.Str(button_delete, "###move_widget_delete:", widget_index)))
                                         tab.widget_deletion_pos = widget_index;
 
                                     // Name
@@ -729,16 +1062,25 @@ struct StateMain : State
                                         ImGui::Indent(indent_w);
                                         FINALLY( ImGui::Unindent(indent_w); )
 
-                                        if (ImGui::CollapsingHeader("{}###widget_collapsing_header:{}"_format("Редактировать", widget_index).c_str()))
+                                        if (ImGui::CollapsingHeader(Data::frame_scratch.Str("Редактировать###widget_collapsing_header:", widget_index)))
                                         {
+                                            // The group lets us check if any of the editor controls were used.
+                                            ImGui::BeginGroup();
                                             widget->DisplayEditor(tab.proc, widget_index);
+                                            ImGui::EndGroup();
+                                            if (ImGui::IsItemEdited() || ImGui::IsItemDeactivated())
+                                                tab.history.WidgetChanged(tab.visible_step, widget_index);
                                         }
                                     }
                                 }
                                 else
                                 {
                                     // Render widget normally.
-                                    widget->Display(widget_index, tab.proc.current_step == tab.visible_step && !tab.IsTemplate());
+                                    if (widget->Display(widget_index, tab.proc.current_step == tab.visible_step && !tab.IsTemplate()))
+                                    {
+                                        tab.proc.MarkStepModified(tab.visible_step);
+                                        Tab_AppendJournal(Journal::WidgetRecord(tab.visible_step, widget_index, widget));
+                                    }
                                     ImGui::Spacing(); // The gui looks better with spacing after each widget including the last one.
                                 }
 
@@ -806,7 +1148,7 @@ struct StateMain : State
                                             if (ImGui::Selectable(menu_entry.name.c_str(), false, ImGuiSelectableFlags_DontClosePopups))
                                             {
                                                 clamp_var(tab.widget_insertion_pos, 0, int(current_step.widgets.size()));
-                                                current_step.widgets.insert(current_step.widgets.begin() + tab.widget_insertion_pos,
+                                                tab.history.InsertWidget(tab.proc, tab.visible_step, tab.widget_insertion_pos,
                                                     Refl::Polymorphic::ConstructFromIndex<Widgets::BasicWidget>(menu_entry.internal_index));
                                                 ImGui::CloseCurrentPopup();
                                             }
@@ -820,7 +1162,7 @@ struct StateMain : State
                                 if (tab.widget_deletion_pos != -1)
                                 {
                                     if (tab.widget_deletion_pos >= 0 && tab.widget_deletion_pos < int(current_step.widgets.size()))
-                                        current_step.widgets.erase(current_step.widgets.begin() + tab.widget_deletion_pos);
+                                        tab.history.EraseWidget(tab.proc, tab.visible_step, tab.widget_deletion_pos);
 
                                     tab.widget_deletion_pos = -1;
 
@@ -832,7 +1174,7 @@ struct StateMain : State
                                 if (tab.widget_swap_pos != -1)
                                 {
                                     if (tab.widget_swap_pos >= 0 && tab.widget_swap_pos + 1 < int(current_step.widgets.size()))
-                                        std::swap(current_step.widgets[tab.widget_swap_pos], current_step.widgets[tab.widget_swap_pos+1]);
+                                        tab.history.SwapWidgets(tab.proc, tab.visible_step, tab.widget_swap_pos);
 
                                     tab.widget_swap_pos = -1;
 
@@ -849,8 +1191,9 @@ struct StateMain : State
                                 {
                                     if (tab.step_insertion_pos >= 0 && tab.step_insertion_pos <=/*sic*/ int(tab.proc.steps.size()))
                                     {
-                                        tab.proc.steps.emplace(tab.proc.steps.begin() + tab.step_insertion_pos);
+                                        tab.history.InsertStep(tab.proc, tab.step_insertion_pos);
                                         tab.visible_step = tab.step_insertion_pos;
+                                        tab.step_names_changed = 1;
                                     }
 
                                     tab.step_insertion_pos = -1;
@@ -864,8 +1207,9 @@ struct StateMain : State
                                 {
                                     if (tab.step_deletion_pos >= 0 && tab.step_deletion_pos < int(tab.proc.steps.size()))
                                     {
-                                        tab.proc.steps.erase(tab.proc.steps.begin() + tab.step_deletion_pos);
+                                        tab.history.EraseStep(tab.proc, tab.step_deletion_pos);
                                         clamp_var(tab.visible_step, 0, int(tab.proc.steps.size()));
+                                        tab.step_names_changed = 1;
                                     }
 
                                     tab.step_deletion_pos = -1;
@@ -879,7 +1223,8 @@ struct StateMain : State
                                 {
                                     if (tab.step_swap_pos >= 0 && tab.step_swap_pos + 1 < int(tab.proc.steps.size()))
                                     {
-                                        std::swap(tab.proc.steps[tab.step_swap_pos], tab.proc.steps[tab.step_swap_pos+1]);
+                                        tab.history.SwapSteps(tab.proc, tab.step_swap_pos);
+                                        tab.step_names_changed = 1;
                                         if (tab.visible_step == tab.step_swap_pos)
                                         {
                                             tab.visible_step++;
@@ -898,6 +1243,10 @@ struct StateMain : State
                                     tab.step_insertion_pos = -1;
                                     tab.step_deletion_pos = -1;
                                 }
+
+                                // Text fields are committed when they lose focus, so that typing doesn't produce a separate change for every letter.
+                                if (!ImGui::IsAnyItemActive())
+                                    tab.history.Commit(tab.proc, tab.visible_step);
                             }
 
                             ImGui::EndChildFrame();
@@ -981,6 +1330,58 @@ struct StateMain : State
 
         image_viewer.Display();
 
+        { // Template browser
+            GuiElements::TemplateBrowser::Result result = template_browser.Display();
+            fs::path template_path = program_directory / Options::template_dir / result.path;
+
+            switch (result.action)
+            {
+              case GuiElements::TemplateBrowser::Action::none:
+                break;
+              case GuiElements::TemplateBrowser::Action::open_template:
+                Tab_LoadReportOrTemplate(template_path);
+                break;
+              case GuiElements::TemplateBrowser::Action::make_report:
+                if (auto result_report = FileDialogs::SaveReport())
+                    Tab_MakeReportFromTemplate(template_path, *result_report);
+                break;
+            }
+        }
+
+        { // Search panel
+            fs::path found_path = search_panel.Display();
+            if (!found_path.empty())
+                Tab_LoadReportOrTemplate(found_path);
+        }
+
+        { // Report export progress
+            if (export_progress_requested)
+            {
+                export_progress_requested = false;
+                ImGui::OpenPopup("export_progress_modal");
+            }
+
+            if (ImGui::BeginPopupModal("export_progress_modal", 0, Options::Visual::modal_window_flags))
+            {
+                Data::ReportExporter::Progress progress = Data::report_exporter.GetProgress();
+                if (progress.running)
+                {
+                    ImGui::TextUnformatted("Экспорт отчетов: {} готово, {} с ошибками"_format(progress.files_written, progress.files_failed).c_str());
+                    if (ImGui::Button("Отмена") || Input::Button(Input::escape).pressed())
+                        Data::report_exporter.Cancel();
+                }
+                else
+                {
+                    ImGui::CloseCurrentPopup();
+                    if (!progress.error.empty())
+                        Interface::MessageBox(Interface::MessageBoxType::error, "Error", "Unable to export the reports:\n{}"_format(progress.error));
+                    else if (!progress.canceled)
+                        Interface::MessageBox(Interface::MessageBoxType::info, "Экспорт", "Отчетов экспортировано: {}, из них не удалось прочитать: {}."_format(progress.files_written, progress.files_failed));
+                }
+                ImGui::EndPopup();
+            }
+        }
+
         { // Modal: "Are you sure you want to end the step?"
             if (need_step_end_confirmation)
                 ImGui::OpenPopup("end_step_modal");
@@ -1010,7 +1411,10 @@ struct StateMain : State
                     active_tab = i;
                     Tab_Save();
                 }
-                Program::Exit();
+                report_writer.WaitForAll();
+                ReportSaveFailures();
+
+                Program::Exit(); // This also stops the running functions, see the initialization of the window.
             };
 
             if (exit_requested)
@@ -1078,6 +1482,15 @@ int _main_(int argc, char **argv)
             window_settings.vsync = Interface::VSync::disabled;
 
             window = Interface::Window("Modular forms", window_size, Interface::windowed, window_settings);
+
+            // The functions wake up the window when they finish, so they must be stopped before the window is destroyed.
+            // `window` is a global constructed before this point, so this runs before its destructor, and also covers `Program::Exit()`.
+            // The functions can't be killed, so we ask them to stop and wait for them.
+            std::atexit([]
+            {
+                Data::function_runner.CancelAll();
+                Data::function_runner.WaitForAll();
+            });
         }
 
         { // GUI
@@ -1095,13 +1508,13 @@ int _main_(int argc, char **argv)
             ImVector<ImWchar> glyph_ranges;
             glyph_ranges_builder.BuildRanges(&glyph_ranges);
 
-            std::string font_filename = (program_directory / fs::path("assets/Roboto-Regular.ttf")).string();
+            std::string font_filename = (program_directory / fs::path(Options::Fonts::file)).string();
             if (!std::filesystem::exists(font_filename))
                 Program::Error("Font file `", font_filename, "` is missing.");
-            if (!io.Fonts->AddFontFromFileTTF(font_filename.c_str(), 16.0f, 0, glyph_ranges.begin()))
+            if (!io.Fonts->AddFontFromFileTTF(font_filename.c_str(), Options::Fonts::size, 0, glyph_ranges.begin()))
                 Program::Error("Unable to load font `", font_filename, "`.");
 
-            ImGuiFreeType::BuildFontAtlas(io.Fonts, ImGuiFreeType::MonoHinting);
+            Data::BuildFontAtlasCached(*io.Fonts, ImGuiFreeType::MonoHinting, program_directory / Options::Fonts::atlas_cache_file);
 
             Options::Visual::GuiStyle(ImGui::GetStyle());
 
@@ -1112,6 +1525,9 @@ int _main_(int argc, char **argv)
 
     Graphics::SetClearColor(fvec3(1));
 
+    Data::thumbnail_disk_cache.Open(program_directory / Options::Images::disk_cache_dir);
+    Data::template_index.Open(program_directory / Options::template_dir, program_directory / Options::TemplateIndex::index_file);
+
     Poly::Storage<State> state;
     auto &new_state = state.assign<StateMain>();
 
@@ -1124,23 +1540,57 @@ int _main_(int argc, char **argv)
 
     constexpr double target_frame_duration = 1 / 60.;
 
+    int frames_to_redraw = Options::Idle::redraw_frames_after_events;
+    std::size_t last_draw_data_hash = 0;
+
     while (1)
     {
+        // If nothing is going on, sleep until the next event.
+        if (frames_to_redraw <= 0)
+            window.WaitForEvents(Options::Idle::max_wait_duration);
+
         uint64_t frame_start = Clock::Time();
+        uint64_t allocations_at_frame_start = AllocationCounter::Total();
 
         window.ProcessEvents({gui_controller.EventHook(Interface::ImGuiController::pass_events)});
+        if (window.ReceivedEvents())
+            frames_to_redraw = Options::Idle::redraw_frames_after_events;
         if (window.Resized())
             Graphics::Viewport(window.Size());
         if (window.ExitRequested())
             state->exit_requested = 1;
 
+        Data::image_loader.Upload(Options::Images::upload_budget_per_frame);
+
         gui_controller.PreTick();
         state->Tick();
 
         gui_controller.PreRender();
-        Graphics::Clear();
-        gui_controller.PostRender();
-        window.SwapBuffers();
+
+        // The running functions are displayed with animated spinners, and the decoded images and the viewer tiles need more frames to be uploaded.
+        if (gui_controller.WantsContinuousRedraw() || Data::function_runner.AnyRunning() || Data::image_loader.HasPendingUploads() || state->WantsContinuousRedraw())
+            frames_to_redraw = clamp_min(frames_to_redraw, 1);
+        else if (frames_to_redraw > 0)
+            frames_to_redraw--;
+
+        // Don't present the frame if it would look exactly the same as the previous one.
+        std::size_t draw_data_hash = gui_controller.DrawDataHash();
+        if (draw_data_hash != last_draw_data_hash || draw_data_hash == 0 || window.Resized() || window.Exposed())
+        {
+            last_draw_data_hash = draw_data_hash;
+            Graphics::Clear();
+            gui_controller.PostRender();
+            window.SwapBuffers();
+            frame_stats.rendered++;
+        }
+        else
+        {
+            frame_stats.skipped++;
+        }
+
+        Data::image_cache.EndFrame();
+        Data::frame_scratch.Reset();
+        frame_stats.allocations_last_frame = AllocationCounter::Total() - allocations_at_frame_start;
 
         double delta = Clock::TicksToSeconds(Clock::Time() - frame_start);
         if (target_frame_duration > delta)
@@ -2,12 +2,118 @@
 
 #include <imgui.h>
 
+#include "main/procedure_file.h"
 #include "utils/mat.h"
 
 namespace Options
 {
     inline const std::string template_extension = ".template", template_dir = "templates", report_extension = ".report";
 
+    // Templates are kept as text, since they're edited by hand and by the template editor. Reports are only read by this program.
+    inline constexpr ProcedureFile::Format template_format = ProcedureFile::Format::text, report_format = ProcedureFile::Format::binary_compressed;
+
+    inline constexpr std::size_t journal_compaction_threshold = 64 * 1024; // When a report journal grows larger than this (in bytes), the report is rewritten in full.
+
+    namespace LazySteps
+    {
+        inline constexpr std::size_t
+            min_file_size = 1024 * 1024, // Text files larger than this (in bytes) have their steps parsed only when they're needed.
+            max_loaded_bytes = 16 * 1024 * 1024; // When the loaded steps take more than this many bytes in the source file, the least recently used ones are unloaded.
+    }
+
+    namespace UndoHistory
+    {
+        inline constexpr std::size_t
+            max_entries = 1000, // The template editor forgets the oldest changes past this count.
+            max_bytes = 64 * 1024 * 1024; // Same, when the history takes more memory than this (approximately).
+    }
+
+    namespace Images
+    {
+        inline constexpr double
+            upload_budget_per_frame = 0.004; // Decoded images are uploaded to textures for at most this long (in seconds) per frame. At least one chunk is uploaded per frame.
+
+        inline constexpr int
+            max_decode_threads = 4, // Images are decoded on this many threads, or less if the CPU doesn't have enough cores.
+            thumbnail_max_size = 512, // The image lists use downscaled copies of the images, with the larger side no longer than this (in pixels).
+            viewer_tile_size = 256, // The image viewer splits the full resolution images into tiles of this size (in pixels).
+            min_unused_frames_before_eviction = 60, // Thumbnails that were used during this many last frames are never evicted, even if we're over the budget.
+            upload_chunk_bytes = 256 * 1024; // Large images are uploaded in chunks of approximately this size (in bytes), so that we can stop when the time runs out.
+
+        inline constexpr std::size_t
+            texture_memory_budget = 256 * 1024 * 1024, // When the image textures take more than this (in bytes), the least recently used thumbnails are evicted. Can be changed at runtime, see `ImageCache`.
+            viewer_texture_budget = 64 * 1024 * 1024, // When the image viewer tiles take more than this (in bytes), the least recently drawn ones are freed. Separate from `texture_memory_budget`.
+            disk_cache_max_size = 128 * 1024 * 1024; // When the thumbnail cache directory grows larger than this (in bytes), the least recently used thumbnails are removed.
+
+        inline constexpr double
+            disk_cache_size_after_pruning = 0.75; // When pruning the thumbnail cache, we remove files until it's this much smaller than the maximum size.
+
+        inline const std::string disk_cache_dir = "cache/thumbnails"; // Relative to the program directory.
+    }
+
+    namespace TemplateIndex
+    {
+        inline constexpr double
+            rescan_interval = 5; // If we can't watch the template directory for changes (or on platforms other than Linux), it's rescanned this often (in seconds).
+
+        inline constexpr int
+            max_depth = 16; // Nested directories deeper than this are not indexed. This also protects us from circular symlinks.
+
+        inline const std::string index_file = "cache/template_index"; // Relative to the program directory.
+    }
+
+    namespace Search
+    {
+        inline constexpr float
+            bm25_k1 = 1.2, // The usual BM25 parameters for ranking the search results.
+            bm25_b = 0.75,
+            prefix_match_weight = 0.5; // When a query word is only a prefix of an indexed word, the match is weighted by this.
+
+        inline constexpr int
+            max_depth = 16; // Nested directories deeper than this are not indexed.
+
+        inline constexpr std::size_t
+            max_word_length = 64, // Longer words are truncated (in bytes).
+            max_results = 200,
+            save_interval = 1000; // During a long scan, the index is saved after parsing this many files.
+
+        inline const std::string index_dir = "cache/search"; // Relative to the program directory. Each indexed directory has its own file there.
+    }
+
+    namespace Export
+    {
+        inline constexpr char csv_separator = ';'; // Spreadsheets in the Russian locale expect this instead of a comma.
+
+        inline constexpr int
+            max_threads = 8, // Reports are parsed on this many threads at most (one less than the core count by default).
+            max_depth = 16; // Nested directories deeper than this are not exported.
+
+        inline constexpr std::size_t
+            max_rows_in_flight = 64; // At most this many parsed reports wait to be written, which limits the memory usage.
+
+        inline constexpr double
+            progress_update_interval = 0.1; // While exporting, the GUI is woken up to display the progress at most this often (in seconds).
+    }
+
+    namespace Idle
+    {
+        inline constexpr double
+            max_wait_duration = 0.5; // When idle, we still wake up this often (in seconds) in case something changed without an event.
+
+        inline constexpr int
+            redraw_frames_after_events = 4; // After any input, keep redrawing for this many frames to let the GUI settle.
+    }
+
+    namespace Fonts
+    {
+        inline constexpr float
+            size = 16; // In pixels.
+
+        inline const std::string
+            file = "assets/Roboto-Regular.ttf", // Relative to the program directory.
+            atlas_cache_file = "cache/font_atlas"; // Relative to the program directory. The rasterized font is kept here, so that it's not rebuilt on every start.
+    }
+
     namespace Visual
     {
         inline constexpr float
@@ -0,0 +1,93 @@
+#include "procedure_data.h"
+
+#include <algorithm>
+#include <exception>
+
+#include "program/errors.h"
+
+namespace Data
+{
+    void Procedure::ParseStep(int index)
+    {
+        ProcedureStep &step = steps[index];
+        LazyStepState &lazy = *step.lazy;
+
+        try
+        {
+            Stream::Input input(lazy.source);
+            input.Seek(lazy.widgets_begin, Stream::absolute);
+
+            std::vector<Widgets::Widget> widgets;
+            Refl::Interface(widgets).FromString(widgets, input, {}, Refl::initial_state);
+            step.widgets = std::move(widgets);
+        }
+        catch (std::exception &e)
+        {
+            Program::Error("In step {} `{}`:\n{}"_format(index + 1, step.name, e.what()));
+        }
+
+        lazy.loaded = true;
+        lazy.initialized = false;
+    }
+
+    void Procedure::LoadStep(int index)
+    {
+        DebugAssert("Step index is out of range.", index >= 0 && index < int(steps.size()));
+
+        ProcedureStep &step = steps[index];
+        if (!step.lazy)
+            return;
+
+        step.lazy->last_use = ++step_use_counter;
+
+        if (!step.lazy->loaded)
+            ParseStep(index);
+
+        if (widgets_initialized && !step.lazy->initialized)
+        {
+            Widgets::InitializeStepWidgets(*this, step, index);
+            step.lazy->initialized = true;
+        }
+    }
+
+    void Procedure::MarkStepModified(int index)
+    {
+        DebugAssert("Step index is out of range.", index >= 0 && index < int(steps.size()));
+
+        if (steps[index].lazy)
+            steps[index].lazy->modified = true;
+    }
+
+    void Procedure::UnloadSteps(std::size_t max_loaded_bytes, std::initializer_list<int> keep)
+    {
+        // There are not many steps, so linear searches are good enough.
+
+        std::size_t loaded_bytes = 0;
+        for (const ProcedureStep &step : steps)
+        {
+            if (step.lazy && step.lazy->loaded)
+                loaded_bytes += step.lazy->SourceSize();
+        }
+
+        while (loaded_bytes > max_loaded_bytes)
+        {
+            ProcedureStep *oldest = nullptr;
+            for (std::size_t i = 0; i < steps.size(); i++)
+            {
+                const std::optional<LazyStepState> &lazy = steps[i].lazy;
+                if (!lazy || !lazy->loaded || lazy->modified || std::find(keep.begin(), keep.end(), int(i)) != keep.end())
+                    continue;
+                if (!oldest || lazy->last_use < oldest->lazy->last_use)
+                    oldest = &steps[i];
+            }
+
+            if (!oldest)
+                break; // Everything that's left is either modified or in use.
+
+            oldest->widgets = {};
+            oldest->lazy->loaded = false;
+            oldest->lazy->initialized = false;
+            loaded_bytes -= oldest->lazy->SourceSize();
+        }
+    }
+}
@@ -1,29 +1,53 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
 #include <map>
+#include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include <optional>
 
 #include "reflection/full_with_poly.h"
 #include "reflection/short_macros.h"
-#include "utils/shared_library.h"
+#include "stream/readonly_data.h"
+#include "utils/hash.h"
 
+#include "main/external_functions.h"
 #include "main/images.h"
 #include "main/widgets.h"
 
 namespace Data
 {
-    SIMPLE_STRUCT( ProcedureStep
-        DECL(std::string) name
-        DECL(bool INIT=false ATTR Refl::Optional) confirm
-        DECL(std::vector<Widgets::Widget>) widgets
-    )
+    // For large text files, the widgets of each step are parsed only when needed. See `Procedure::LoadStep()`.
+    struct LazyStepState
+    {
+        Stream::ReadOnlyData source;
+        std::size_t widgets_begin = 0, widgets_end = 0; // The location of the widget list in `source`.
+
+        bool loaded = false; // If false, `ProcedureStep::widgets` is empty and has to be parsed before use.
+        bool initialized = false; // If the loaded widgets were initialized.
+        bool modified = false; // If the widgets could've been changed since loading. Such steps are never unloaded.
+        std::uint64_t last_use = 0; // For unloading the least recently used steps.
+
+        std::size_t SourceSize() const
+        {
+            return widgets_end - widgets_begin;
+        }
+    };
+
+    struct ProcedureStep
+    {
+        MEMBERS(
+            DECL(std::string) name
+            DECL(bool INIT=false ATTR Refl::Optional) confirm
+            DECL(std::vector<Widgets::Widget>) widgets
+        )
 
-    // Should return 0 on success or a error message on failure.
-    // Caller shouldn't free the string.
-    // The error string has to remain allocated at least until the next library call.
-    using external_func_ptr_t = const char *(*)();
+        std::optional<LazyStepState> lazy; // Null if the step was loaded eagerly.
+    };
 
     struct LibraryFunc
     {
@@ -32,7 +56,7 @@ namespace Data
             DECL(std::string) name
         )
 
-        external_func_ptr_t ptr = 0;
+        ExternalFunction loaded; // Set by `Widgets::InitializeWidgets()`.
     };
 
 
@@ -44,7 +68,22 @@ namespace Data
             DECL(std::vector<LibraryFunc>) functions
         )
 
-        SharedLibrary library;
+        std::shared_ptr<LoadedLibrary> loaded; // Set by `Widgets::InitializeWidgets()`.
+    };
+
+    struct FunctionId
+    {
+        std::string library_id, func_id;
+
+        bool operator==(const FunctionId &other) const
+        {
+            return library_id == other.library_id && func_id == other.func_id;
+        }
+
+        std::size_t hash() const
+        {
+            return Hash::Compute(library_id, func_id);
+        }
     };
 
     struct Procedure
@@ -58,11 +97,30 @@ namespace Data
         )
 
         fs::path resource_dir;
-        mutable Image::Cache image_cache;
+
+        // Maps library and function ids to functions. Filled by `Widgets::InitializeWidgets()`.
+        std::unordered_map<FunctionId, ExternalFunction, Hash::Obj> function_table;
+
+        bool widgets_initialized = false; // Set by `Widgets::InitializeWidgets()`. Steps loaded after that are initialized immediately.
+        std::uint64_t step_use_counter = 0;
 
         bool IsTemplate() const
         {
             return current_step == -1;
         }
+
+        // Makes sure the widgets of a step are parsed, and initialized if `widgets_initialized` is set.
+        // Does nothing if the step wasn't loaded lazily. Call this before touching `steps[index].widgets`.
+        void LoadStep(int index);
+
+        // Prevents the step from being unloaded, since unloading would lose the changes.
+        void MarkStepModified(int index);
+
+        // Unloads the least recently used unmodified steps, until the loaded ones take at most `max_loaded_bytes` in the source file.
+        // Steps listed in `keep` are never unloaded.
+        void UnloadSteps(std::size_t max_loaded_bytes, std::initializer_list<int> keep);
+
+      private:
+        void ParseStep(int index);
     };
 }
@@ -0,0 +1,211 @@
+#include "procedure_file.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <exception>
+#include <iterator>
+#include <map>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#include "program/errors.h"
+#include "reflection/inline.h"
+#include "reflection/utils.h"
+#include "utils/archive.h"
+
+#include "main/options.h"
+#include "main/procedure_data.h"
+
+namespace ProcedureFile
+{
+    namespace
+    {
+        using widget_list_t = std::vector<Widgets::Widget>;
+
+        // Reads procedures like `Refl::FromString()`, but only skips the widget lists, remembering their locations.
+        // This uses the inline dispatch only because it's the way to customize how specific types are read, not for speed.
+        // This way large text files are read without parsing the step contents, and everything else is validated as usual.
+        struct SkipWidgetsDispatch : Refl::impl::BasicInlineDispatch<SkipWidgetsDispatch>
+        {
+            // Receives the locations of the skipped lists, in the order they appear in the input.
+            std::vector<std::pair<std::size_t, std::size_t>> &widget_lists;
+
+            explicit SkipWidgetsDispatch(std::vector<std::pair<std::size_t, std::size_t>> &widget_lists) : widget_lists(widget_lists) {}
+
+            template <typename T> void FromString(T &object, Stream::Input &input, const Refl::FromStringOptions &options, Refl::impl::FromStringState state) const
+            {
+                if constexpr (std::is_same_v<T, widget_list_t>)
+                {
+                    std::size_t begin = input.Position();
+                    Refl::Utils::SkipValue(input);
+                    widget_lists.emplace_back(begin, input.Position());
+                }
+                else
+                {
+                    BasicInlineDispatch::FromString(object, input, options, state);
+                }
+            }
+        };
+
+        Data::Procedure ReadLazily(const Stream::ReadOnlyData &data)
+        {
+            std::vector<std::pair<std::size_t, std::size_t>> widget_lists;
+
+            Data::Procedure ret;
+            Stream::Input input(data);
+            input.WantLocationStyle(Stream::text_position);
+            Refl::Utils::SkipWhitespaceAndComments(input);
+            SkipWidgetsDispatch(widget_lists).FromString(ret, input, {}, Refl::initial_state);
+            Refl::Utils::SkipWhitespaceAndComments(input);
+            input.ExpectEnd();
+
+            // Each step has exactly one widget list, since it's a required member.
+            DebugAssert("The number of skipped widget lists doesn't match the number of steps.", widget_lists.size() == ret.steps.size());
+
+            for (std::size_t i = 0; i < ret.steps.size(); i++)
+            {
+                Data::LazyStepState &lazy = ret.steps[i].lazy.emplace();
+                lazy.source = data;
+                lazy.widgets_begin = widget_lists[i].first;
+                lazy.widgets_end = widget_lists[i].second;
+            }
+
+            return ret;
+        }
+
+        // Writes procedures like `Refl::Inline::ToString()`, but copies the widget lists of unloaded steps from their source text.
+        struct RawWidgetsDispatch : Refl::impl::BasicInlineDispatch<RawWidgetsDispatch>
+        {
+            // Maps the widget lists to be replaced to their text.
+            const std::map<const widget_list_t *, std::string_view> &raw_widget_lists;
+
+            explicit RawWidgetsDispatch(const std::map<const widget_list_t *, std::string_view> &raw_widget_lists) : raw_widget_lists(raw_widget_lists) {}
+
+            template <typename T> void ToString(const T &object, Stream::Output &output, const Refl::ToStringOptions &options, Refl::impl::ToStringState state) const
+            {
+                if constexpr (std::is_same_v<T, widget_list_t>)
+                {
+                    if (auto it = raw_widget_lists.find(&object); it != raw_widget_lists.end())
+                    {
+                        output.WriteBytes(it->second.data(), it->second.size());
+                        return;
+                    }
+                }
+
+                BasicInlineDispatch::ToString(object, output, options, state);
+            }
+        };
+
+        // The first byte is non-ASCII to make sure no text file looks like this.
+        constexpr std::uint8_t signature[] = {0x89, 'M', 'F', 'P', 'R', 'O', 'C', '\n'};
+
+        // The signature is followed by a little-endian `uint16_t` version and `uint8_t` flags. Then follows the procedure,
+        // serialized with `Refl::ToBinary()` and optionally compressed with `Archive::Compress()`.
+        constexpr std::uint16_t current_version = 1;
+
+        enum Flags : std::uint8_t
+        {
+            flag_compressed = 1 << 0,
+        };
+
+        constexpr std::size_t header_size = sizeof signature + sizeof(std::uint16_t) + sizeof(std::uint8_t);
+
+        // Reads the header of a binary file and returns the flags. The header must be followed by the serialized procedure.
+        std::uint8_t ReadBinaryHeader(Stream::Input &input)
+        {
+            input.Skip(sizeof signature);
+
+            std::uint16_t version = input.ReadLittle<std::uint16_t>();
+            if (version == 0 || version > current_version)
+                Program::Error(input.GetExceptionPrefix(), "Unsupported binary format version ", version, ", expected ", current_version, " or older.");
+
+            std::uint8_t flags = input.ReadLittle<std::uint8_t>();
+            if (flags & ~flag_compressed)
+                Program::Error(input.GetExceptionPrefix(), "Unknown binary format flags: ", int(flags), ".");
+
+            return flags;
+        }
+    }
+
+    bool IsBinary(const Stream::ReadOnlyData &data)
+    {
+        return data.size() >= sizeof signature && std::equal(std::begin(signature), std::end(signature), data.begin());
+    }
+
+    Data::Procedure Read(const Stream::ReadOnlyData &data, bool allow_lazy_steps)
+    {
+        if (!IsBinary(data))
+        {
+            if (allow_lazy_steps && data.size() >= Options::LazySteps::min_file_size)
+                return ReadLazily(data);
+
+            return Refl::FromString<Data::Procedure>(Stream::Input(data));
+        }
+
+        Stream::Input input(data);
+        std::uint8_t flags = ReadBinaryHeader(input);
+
+        if (flags & flag_compressed)
+            return Refl::FromBinary<Data::Procedure>(Stream::ReadOnlyData::mem_reference(data.begin() + header_size, data.end()).uncompress());
+        else
+            return Refl::FromBinary<Data::Procedure>(input);
+    }
+
+    void Write(Stream::Output &output, const std::vector<unsigned char> &serialized_procedure, Format format, const std::vector<UnloadedWidgets> &unloaded_widgets)
+    {
+        if (format == Format::text)
+        {
+            Data::Procedure proc = Refl::FromBinary<Data::Procedure>(Stream::ReadOnlyData::mem_reference(serialized_procedure));
+
+            std::map<const widget_list_t *, std::string_view> raw_widget_lists;
+            for (const UnloadedWidgets &unloaded : unloaded_widgets)
+            {
+                if (unloaded.step >= proc.steps.size())
+                    Program::Error("Unloaded step index is out of range.");
+                raw_widget_lists.try_emplace(&proc.steps[unloaded.step].widgets, unloaded.source.begin_char() + unloaded.begin, unloaded.end - unloaded.begin);
+            }
+
+            RawWidgetsDispatch(raw_widget_lists).ToString(proc, output, Refl::ToStringOptions::Pretty(), Refl::initial_state);
+            return;
+        }
+
+        if (unloaded_widgets.size() > 0)
+        {
+            // Parse the unloaded steps and serialize the procedure again.
+            Data::Procedure proc = Refl::FromBinary<Data::Procedure>(Stream::ReadOnlyData::mem_reference(serialized_procedure));
+            for (const UnloadedWidgets &unloaded : unloaded_widgets)
+            {
+                if (unloaded.step >= proc.steps.size())
+                    Program::Error("Unloaded step index is out of range.");
+
+                Stream::Input input(unloaded.source);
+                input.WantLocationStyle(Stream::text_position);
+                input.Seek(unloaded.begin, Stream::absolute);
+                widget_list_t &widgets = proc.steps[unloaded.step].widgets;
+                Refl::Interface(widgets).FromString(widgets, input, {}, Refl::initial_state);
+            }
+
+            Write(output, Refl::Inline::ToBinary<std::vector<unsigned char>>(proc), format);
+            return;
+        }
+
+        bool compress = format == Format::binary_compressed;
+
+        output.WriteBytes(signature, sizeof signature);
+        output.WriteLittle<std::uint16_t>(current_version);
+        output.WriteLittle<std::uint8_t>(compress ? flag_compressed : 0);
+
+        if (!compress)
+        {
+            output.WriteBytes(serialized_procedure.data(), serialized_procedure.size());
+        }
+        else
+        {
+            const std::uint8_t *begin = serialized_procedure.data(), *end = begin + serialized_procedure.size();
+            std::vector<std::uint8_t> buffer(Archive::MaxCompressedSize(begin, end));
+            std::uint8_t *buffer_end = Archive::Compress(begin, end, buffer.data(), buffer.data() + buffer.size());
+            output.WriteBytes(buffer.data(), buffer_end - buffer.data());
+        }
+    }
+}
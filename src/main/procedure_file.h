@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "stream/output.h"
+#include "stream/readonly_data.h"
+
+namespace Data
+{
+    struct Procedure;
+}
+
+// Reading and writing reports and templates.
+// There are two formats: the pretty-printed text produced by `Refl::ToString()`, and a binary one based on `Refl::ToBinary()`.
+// Binary files start with a signature, so the format is detected automatically when reading.
+namespace ProcedureFile
+{
+    enum class Format {text, binary, binary_compressed};
+
+    [[nodiscard]] bool IsBinary(const Stream::ReadOnlyData &data);
+
+    // Parses a procedure in any supported format. Widgets are not initialized.
+    // If `allow_lazy_steps` is true and the file is a large text file, the step widgets are not parsed until needed, see `Data::Procedure::LoadStep()`.
+    [[nodiscard]] Data::Procedure Read(const Stream::ReadOnlyData &data, bool allow_lazy_steps = false);
+
+    // The widget list of a step that wasn't parsed, see `Data::LazyStepState`.
+    struct UnloadedWidgets
+    {
+        std::size_t step = 0;
+        Stream::ReadOnlyData source;
+        std::size_t begin = 0, end = 0; // The location of the list in `source`.
+    };
+
+    // Writes a procedure that was serialized with `Refl::ToBinary()`.
+    // We accept it in this form to avoid a needless round trip when writing in a binary format.
+    // The steps listed in `unloaded_widgets` must have empty widget lists in `serialized_procedure`, their widgets are taken from the source text instead.
+    // When writing text, that text is copied as is. Otherwise it has to be parsed, which is why this isn't done before calling this function.
+    void Write(Stream::Output &output, const std::vector<unsigned char> &serialized_procedure, Format format, const std::vector<UnloadedWidgets> &unloaded_widgets = {});
+}
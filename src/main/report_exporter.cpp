@@ -0,0 +1,437 @@
+#include "report_exporter.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <exception>
+#include <system_error>
+#include <utility>
+
+#include "interface/window.h"
+#include "main/options.h"
+#include "main/procedure_data.h"
+#include "main/procedure_file.h"
+#include "main/report_journal.h"
+#include "program/errors.h"
+#include "stream/output.h"
+#include "stream/readonly_data.h"
+#include "stream/replace_file.h"
+#include "utils/clock.h"
+
+namespace fs = std::filesystem;
+
+namespace Data
+{
+    namespace
+    {
+        void AppendCsvCell(std::string &line, const std::string &cell)
+        {
+            if (line.size() > 0)
+                line += Options::Export::csv_separator;
+
+            if (cell.find_first_of(std::string{Options::Export::csv_separator, '"', '\n', '\r'}) == std::string::npos)
+            {
+                line += cell;
+                return;
+            }
+
+            line += '"';
+            for (char ch : cell)
+            {
+                if (ch == '"')
+                    line += '"';
+                line += ch;
+            }
+            line += '"';
+        }
+
+        void AppendJsonString(std::string &out, const std::string &str)
+        {
+            out += '"';
+            for (char ch : str)
+            {
+                switch (ch)
+                {
+                  case '"':
+                    out += "\\\"";
+                    break;
+                  case '\\':
+                    out += "\\\\";
+                    break;
+                  case '\n':
+                    out += "\\n";
+                    break;
+                  case '\r':
+                    out += "\\r";
+                    break;
+                  case '\t':
+                    out += "\\t";
+                    break;
+                  default:
+                    if ((unsigned char)ch < 0x20)
+                        out += "\\u{:04x}"_format(int(ch));
+                    else
+                        out += ch; // UTF-8 is allowed as is.
+                    break;
+                }
+            }
+            out += '"';
+        }
+    }
+
+    void ReportExporter::DirectoryWalker::Enter(const fs::path &dir)
+    {
+        Level &level = levels.emplace_back();
+
+        std::error_code error;
+        for (fs::directory_iterator it(dir, error), end; !error && it != end; it.increment(error))
+            level.entries.push_back(it->path());
+        std::sort(level.entries.begin(), level.entries.end());
+    }
+
+    ReportExporter::DirectoryWalker::DirectoryWalker(const fs::path &dir)
+    {
+        Enter(dir);
+    }
+
+    fs::path ReportExporter::DirectoryWalker::NextReport()
+    {
+        while (levels.size() > 0)
+        {
+            Level &level = levels.back();
+            if (level.next >= level.entries.size())
+            {
+                levels.pop_back();
+                continue;
+            }
+
+            fs::path path = std::move(level.entries[level.next++]);
+
+            std::error_code error;
+            fs::file_status status = fs::status(path, error);
+            if (error)
+                continue; // The file was removed while we were exporting.
+
+            if (fs::is_directory(status))
+            {
+                if (int(levels.size()) <= Options::Export::max_depth)
+                    Enter(path);
+            }
+            else if (fs::is_regular_file(status) && path.extension() == Options::report_extension)
+            {
+                return path;
+            }
+        }
+
+        return {};
+    }
+
+    ReportExporter::Row ReportExporter::MakeRow(const fs::path &directory, const fs::path &path, Format format)
+    {
+        Row row;
+        std::string relative_path = path.lexically_relative(directory).generic_string();
+
+        try
+        {
+            Procedure proc = ProcedureFile::Read(Stream::ReadOnlyData::file(path.string()));
+            Journal::Replay(proc, path);
+            if (proc.current_step < 0 || proc.current_step > int(proc.steps.size())) // Sic.
+                Program::Error("Current step index is out of range.");
+
+            std::vector<std::pair<std::string, std::string>> values;
+
+            if (format == Format::csv)
+            {
+                for (const char *column : {"Файл", "Процедура", "Ошибка", "Завершено шагов", "Всего шагов"})
+                    AppendCsvCell(row.header, column);
+                AppendCsvCell(row.line, relative_path);
+                AppendCsvCell(row.line, proc.name);
+                AppendCsvCell(row.line, "");
+                AppendCsvCell(row.line, std::to_string(proc.current_step));
+                AppendCsvCell(row.line, std::to_string(proc.steps.size()));
+
+                for (std::size_t i = 0; i < proc.steps.size(); i++)
+                {
+                    const ProcedureStep &step = proc.steps[i];
+                    AppendCsvCell(row.header, "{}. {}"_format(i + 1, step.name));
+                    AppendCsvCell(row.line, int(i) < proc.current_step ? "1" : "0");
+
+                    values.clear();
+                    for (const Widgets::Widget &widget : step.widgets)
+                        widget->ListExportedValues(values);
+                    for (const auto &[name, value] : values)
+                    {
+                        AppendCsvCell(row.header, "{}. {}: {}"_format(i + 1, step.name, name));
+                        AppendCsvCell(row.line, value);
+                    }
+                }
+
+                row.header += '\n';
+            }
+            else
+            {
+                row.line = "{\"file\":";
+                AppendJsonString(row.line, relative_path);
+                row.line += ",\"name\":";
+                AppendJsonString(row.line, proc.name);
+                row.line += ",\"current_step\":{},\"steps\":["_format(proc.current_step);
+
+                for (std::size_t i = 0; i < proc.steps.size(); i++)
+                {
+                    const ProcedureStep &step = proc.steps[i];
+                    if (i != 0)
+                        row.line += ',';
+                    row.line += "{\"name\":";
+                    AppendJsonString(row.line, step.name);
+                    row.line += ",\"done\":";
+                    row.line += int(i) < proc.current_step ? "true" : "false";
+                    row.line += ",\"values\":[";
+
+                    values.clear();
+                    for (const Widgets::Widget &widget : step.widgets)
+                        widget->ListExportedValues(values);
+                    bool first = true;
+                    for (const auto &[name, value] : values)
+                    {
+                        if (!first)
+                            row.line += ',';
+                        first = false;
+                        row.line += '[';
+                        AppendJsonString(row.line, name);
+                        row.line += ',';
+                        AppendJsonString(row.line, value);
+                        row.line += ']';
+                    }
+
+                    row.line += "]}";
+                }
+
+                row.line += "]}";
+            }
+        }
+        catch (std::exception &e)
+        {
+            row = {};
+            row.failed = true;
+            if (format == Format::csv)
+            {
+                AppendCsvCell(row.line, relative_path);
+                AppendCsvCell(row.line, "");
+                AppendCsvCell(row.line, e.what());
+            }
+            else
+            {
+                row.line = "{\"file\":";
+                AppendJsonString(row.line, relative_path);
+                row.line += ",\"error\":";
+                AppendJsonString(row.line, e.what());
+                row.line += '}';
+            }
+        }
+
+        row.line += '\n';
+        return row;
+    }
+
+    void ReportExporter::WorkerFunc(fs::path directory, Format format)
+    {
+        std::unique_lock lock(mutex);
+
+        while (1)
+        {
+            // Don't get too far ahead of the writer, to limit the memory usage.
+            cond_var.wait(lock, [&]{return cancel_requested || walker_finished || next_row < next_written_row + Options::Export::max_rows_in_flight;});
+            if (cancel_requested || walker_finished)
+                break;
+
+            // The walker is only used by one thread at a time.
+            fs::path path = walker.NextReport();
+            if (path.empty())
+            {
+                walker_finished = true;
+                break;
+            }
+            std::size_t index = next_row++;
+
+            lock.unlock();
+            Row row = MakeRow(directory, path, format);
+            lock.lock();
+
+            parsed_rows.try_emplace(index, std::move(row));
+            cond_var.notify_all();
+        }
+
+        running_workers--;
+        cond_var.notify_all();
+    }
+
+    void ReportExporter::ThreadFunc(fs::path directory, fs::path output_file, Format format)
+    {
+        int thread_count = std::clamp(int(std::thread::hardware_concurrency()) - 1, 1, Options::Export::max_threads);
+
+        {
+            std::lock_guard lock(mutex);
+            walker = DirectoryWalker(directory);
+            running_workers = thread_count;
+        }
+
+        std::vector<std::thread> workers;
+        for (int i = 0; i < thread_count; i++)
+            workers.emplace_back([this, directory, format]{WorkerFunc(directory, format);});
+
+        std::string error;
+        bool canceled = false;
+
+        try
+        {
+            canceled = !Stream::ReplaceFile(output_file, [&](Stream::Output &output)
+            {
+                if (format == Format::csv)
+                    output.WriteString("\xEF\xBB\xBF"); // Otherwise spreadsheets don't detect UTF-8.
+
+                // The header comes from the first readable report, so the failed reports before it have to wait.
+                // When a report has different columns (it was made from a different template), a new section with its own header starts.
+                // Failed reports only fill the first three columns, which are the same in all headers.
+                bool have_header = format != Format::csv;
+                std::string current_header;
+                std::vector<std::string> failed_lines_before_header;
+
+                std::uint64_t next_progress_update = 0;
+
+                std::unique_lock lock(mutex);
+                while (1)
+                {
+                    cond_var.wait(lock, [&]{return cancel_requested || parsed_rows.count(next_written_row) || running_workers == 0;});
+                    if (cancel_requested)
+                        return false;
+
+                    auto it = parsed_rows.find(next_written_row);
+                    if (it == parsed_rows.end())
+                        break; // All workers are done, and all rows were written, since the indices are contiguous.
+
+                    Row row = std::move(it->second);
+                    parsed_rows.erase(it);
+                    next_written_row++;
+                    lock.unlock();
+                    cond_var.notify_all(); // Let the workers continue.
+
+                    if (!have_header && row.failed)
+                    {
+                        failed_lines_before_header.push_back(std::move(row.line));
+                    }
+                    else
+                    {
+                        if (!have_header)
+                        {
+                            have_header = true;
+                            current_header = row.header;
+                            output.WriteString(row.header);
+                            for (const std::string &line : failed_lines_before_header)
+                                output.WriteString(line);
+                            failed_lines_before_header = {};
+                        }
+                        else if (!row.failed && format == Format::csv && row.header != current_header)
+                        {
+                            current_header = row.header;
+                            output.WriteString("\n"); // An empty line separates the sections.
+                            output.WriteString(row.header);
+                        }
+                        output.WriteString(row.line);
+                    }
+
+                    lock.lock();
+                    progress.files_written++;
+                    if (row.failed)
+                        progress.files_failed++;
+
+                    // The GUI doesn't redraw on its own while we're exporting, so we wake it up to show the progress.
+                    if (std::uint64_t time = Clock::Time(); time >= next_progress_update)
+                    {
+                        next_progress_update = time + Clock::SecondsToTicks(Options::Export::progress_update_interval);
+                        Interface::Window::WakeUp();
+                    }
+                }
+                lock.unlock();
+
+                // If no report could be read, there's no header.
+                for (const std::string &line : failed_lines_before_header)
+                    output.WriteString(line);
+
+                return true;
+            });
+        }
+        catch (std::exception &e)
+        {
+            error = e.what();
+        }
+
+        {
+            std::lock_guard lock(mutex);
+            cancel_requested = true; // Stop the workers if we failed to write.
+        }
+        cond_var.notify_all();
+        for (std::thread &worker : workers)
+            worker.join();
+
+        {
+            std::lock_guard lock(mutex);
+            progress.running = false;
+            progress.canceled = canceled;
+            progress.error = error;
+            parsed_rows.clear();
+            walker = {};
+        }
+
+        Interface::Window::WakeUp(); // Let the GUI display the result.
+    }
+
+    void ReportExporter::StopThread()
+    {
+        {
+            std::lock_guard lock(mutex);
+            cancel_requested = true;
+        }
+        cond_var.notify_all();
+
+        if (thread.joinable())
+            thread.join();
+    }
+
+    ReportExporter::~ReportExporter()
+    {
+        StopThread();
+    }
+
+    void ReportExporter::Start(fs::path directory, fs::path output_file, Format format)
+    {
+        StopThread();
+
+        {
+            std::lock_guard lock(mutex);
+            progress = {};
+            progress.running = true;
+            cancel_requested = false;
+            walker_finished = false;
+            next_row = 0;
+            next_written_row = 0;
+            parsed_rows.clear();
+            running_workers = 0;
+        }
+
+        thread = std::thread([this, directory = std::move(directory), output_file = std::move(output_file), format]{ThreadFunc(directory, output_file, format);});
+    }
+
+    void ReportExporter::Cancel()
+    {
+        {
+            std::lock_guard lock(mutex);
+            cancel_requested = true;
+        }
+        cond_var.notify_all();
+    }
+
+    ReportExporter::Progress ReportExporter::GetProgress()
+    {
+        std::lock_guard lock(mutex);
+        return progress;
+    }
+}
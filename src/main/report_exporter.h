@@ -0,0 +1,105 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Data
+{
+    // Exports all reports in a directory (recursively) to a single file, one report per line, on background threads.
+    // Each line contains the procedure name, the completion of each step, and the values filled by the user (see `Widgets::BasicWidget::ListExportedValues()`).
+    // Report journals are replayed before exporting.
+    // Reports are parsed in parallel, but written in a deterministic order (sorted by path). At most `Options::Export::max_rows_in_flight` parsed reports
+    // are kept in memory at the same time, and directories are listed one at a time, so the memory usage doesn't depend on the amount of files.
+    // Reports that can't be read produce lines with an error message.
+    // All member functions are thread-safe.
+    class ReportExporter
+    {
+      public:
+        enum class Format
+        {
+            // A header line with the column names, then one line per report. Reports made from the same template have the same columns.
+            // When the columns change, an empty line and a new header are written, and the following reports go under it.
+            csv,
+            jsonl, // One JSON object per line.
+        };
+
+        struct Progress
+        {
+            bool running = false;
+            bool canceled = false;
+            std::size_t files_written = 0;
+            std::size_t files_failed = 0; // Those are also counted in `files_written`.
+            std::string error; // Set if the export was aborted because the output file can't be written.
+        };
+
+      private:
+        struct Row
+        {
+            std::string header; // Only for CSV. The header line for this report.
+            std::string line;
+            bool failed = false;
+        };
+
+        // Walks a directory tree, listing one directory at a time. Entries are sorted to make the order deterministic.
+        class DirectoryWalker
+        {
+            struct Level
+            {
+                std::vector<std::filesystem::path> entries;
+                std::size_t next = 0;
+            };
+            std::vector<Level> levels;
+
+            void Enter(const std::filesystem::path &dir);
+
+          public:
+            DirectoryWalker() {}
+            DirectoryWalker(const std::filesystem::path &dir);
+
+            // Returns the next report, or an empty path if there are no more.
+            [[nodiscard]] std::filesystem::path NextReport();
+        };
+
+        std::mutex mutex;
+        std::condition_variable cond_var; // Notified when a row is parsed or written, when the reports run out, and on cancellation.
+
+        // Those are protected by the mutex.
+        Progress progress;
+        bool cancel_requested = false;
+        DirectoryWalker walker;
+        bool walker_finished = false;
+        std::size_t next_row = 0; // The index of the next report taken by a worker.
+        std::size_t next_written_row = 0;
+        std::map<std::size_t, Row> parsed_rows; // Parsed rows waiting to be written, by index.
+        int running_workers = 0;
+
+        std::thread thread; // Writes the rows. Started by `Start()`.
+
+        void ThreadFunc(std::filesystem::path directory, std::filesystem::path output_file, Format format);
+        void WorkerFunc(std::filesystem::path directory, Format format);
+
+        [[nodiscard]] static Row MakeRow(const std::filesystem::path &directory, const std::filesystem::path &path, Format format);
+
+        void StopThread();
+
+      public:
+        ReportExporter() {}
+        ReportExporter(const ReportExporter &) = delete;
+        ReportExporter &operator=(const ReportExporter &) = delete;
+        ~ReportExporter(); // Cancels the export.
+
+        // Starts exporting the reports from `directory` to `output_file`. Cancels the previous export, if it's still running.
+        void Start(std::filesystem::path directory, std::filesystem::path output_file, Format format);
+        void Cancel();
+
+        [[nodiscard]] Progress GetProgress();
+    };
+
+    inline ReportExporter report_exporter;
+}
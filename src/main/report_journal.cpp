@@ -0,0 +1,136 @@
+#include "report_journal.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <exception>
+#include <optional>
+#include <string>
+#include <system_error>
+
+#include "program/errors.h"
+#include "stream/readonly_data.h"
+
+namespace Journal
+{
+    namespace
+    {
+        SIMPLE_STRUCT( WidgetChange
+            DECL(int) step, index
+            DECL(std::string) type, state // The widget class name, and the result of `StateToString()`.
+        )
+
+        // Exactly one of the members is set in each record.
+        SIMPLE_STRUCT( Record
+            DECL(std::optional<int> ATTR Refl::Optional) current_step
+            DECL(std::optional<WidgetChange> ATTR Refl::Optional) widget_change
+        )
+
+        std::string RecordToLine(const Record &record)
+        {
+            std::string ret = Refl::ToString(record);
+            ret += '\n';
+            return ret;
+        }
+    }
+
+    fs::path PathForReport(fs::path report_path)
+    {
+        report_path += ".journal";
+        return report_path;
+    }
+
+    std::string CurrentStepRecord(int current_step)
+    {
+        Record record;
+        record.current_step = current_step;
+        return RecordToLine(record);
+    }
+
+    std::string WidgetRecord(int step_index, int widget_index, const Widgets::Widget &widget)
+    {
+        Record record;
+        record.widget_change.emplace();
+        record.widget_change->step = step_index;
+        record.widget_change->index = widget_index;
+        record.widget_change->type = Refl::Polymorphic::Name(widget);
+        record.widget_change->state = widget->StateToString();
+        return RecordToLine(record);
+    }
+
+    std::size_t Replay(Data::Procedure &proc, const fs::path &report_path, std::string *damage)
+    {
+        fs::path journal_path = PathForReport(report_path);
+
+        std::error_code error;
+        if (!fs::is_regular_file(journal_path, error))
+            return 0;
+
+        Stream::ReadOnlyData file = Stream::ReadOnlyData::file(journal_path.string());
+        const char *begin = file.begin_char(), *end = file.end_char();
+
+        int line_number = 0;
+
+        try
+        {
+            while (begin != end)
+            {
+                const char *line_end = std::find(begin, end, '\n');
+                if (line_end == end)
+                    break; // The last record is incomplete, ignore it.
+
+                line_number++;
+
+                Record record = Refl::FromString<Record>(std::string_view(begin, line_end - begin));
+
+                if (record.current_step)
+                {
+                    proc.current_step = *record.current_step;
+                }
+
+                if (record.widget_change)
+                {
+                    const WidgetChange &change = *record.widget_change;
+
+                    if (change.step < 0 || change.step >= int(proc.steps.size()))
+                        Program::Error("Step index is out of range.");
+
+                    proc.LoadStep(change.step);
+                    proc.MarkStepModified(change.step);
+
+                    std::vector<Widgets::Widget> &widgets = proc.steps[change.step].widgets;
+                    if (change.index < 0 || change.index >= int(widgets.size()))
+                        Program::Error("Widget index is out of range.");
+
+                    if (Refl::Polymorphic::Name(widgets[change.index]) != change.type)
+                        Program::Error("Widget type doesn't match the report.");
+
+                    widgets[change.index]->StateFromString(change.state);
+                }
+
+                begin = line_end + 1;
+            }
+        }
+        catch (std::exception &e)
+        {
+            // Keep the changes up to this record, like any append-only log would.
+            if (damage)
+                *damage = Str("In journal `", journal_path.string(), "`, record ", line_number, ": ", e.what(), "\nThis record and the ones after it are ignored.");
+        }
+
+        return begin - file.begin_char();
+    }
+
+    void Truncate(const fs::path &report_path, std::size_t valid_size)
+    {
+        fs::path journal_path = PathForReport(report_path);
+
+        std::error_code error;
+        std::uintmax_t size = fs::file_size(journal_path, error);
+        if (error || size <= valid_size)
+            return;
+
+        fs::resize_file(journal_path, valid_size, error);
+        if (error)
+            Program::Error("Unable to truncate the journal `", journal_path.string(), "`: ", error.message());
+    }
+}
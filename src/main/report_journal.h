@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include "main/procedure_data.h"
+
+// A report can have a journal: a sidecar file with small records describing the changes made since the report was last saved in full.
+// This way a checkbox toggle costs a few dozen bytes of I/O instead of rewriting the whole report.
+// Each record is a single line of text.
+// Records set absolute values, so replaying records that are already included in the report is harmless.
+// Widget records only contain the state filled by the user (see `Widgets::BasicWidget::StateToString()`), since the rest of a widget comes from the template.
+namespace Journal
+{
+    [[nodiscard]] fs::path PathForReport(fs::path report_path);
+
+    [[nodiscard]] std::string CurrentStepRecord(int current_step);
+    [[nodiscard]] std::string WidgetRecord(int step_index, int widget_index, const Widgets::Widget &widget);
+
+    // Applies the journal of the report at `report_path` to `proc`, if the journal exists.
+    // Returns the size of the valid part of the journal in bytes, or 0 if there is no journal.
+    // An incomplete last record (e.g. if the program crashed while writing it) is ignored.
+    // If a record is damaged, it and all records after it are ignored, and if `damage` is not null, the problem is described there. The preceding records stay applied.
+    // Widgets are not initialized by this function.
+    std::size_t Replay(Data::Procedure &proc, const fs::path &report_path, std::string *damage = nullptr);
+
+    // Cuts the journal of the report at `report_path` to `valid_size` bytes, as returned by `Replay()`.
+    // This removes the ignored records, so that new records can be appended after the valid ones. Does nothing if there's nothing to remove.
+    void Truncate(const fs::path &report_path, std::size_t valid_size);
+}
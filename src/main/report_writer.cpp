@@ -0,0 +1,191 @@
+#include "report_writer.h"
+
+#include <algorithm>
+#include <exception>
+#include <system_error>
+#include <utility>
+
+#include "interface/window.h"
+#include "main/report_journal.h"
+#include "reflection/inline.h"
+#include "stream/output.h"
+#include "stream/replace_file.h"
+#include "stream/save_to_file.h"
+
+namespace Data
+{
+    ReportWriter::ReportWriter() : thread([this]{ThreadFunc();}) {}
+
+    ReportWriter::~ReportWriter()
+    {
+        {
+            std::lock_guard lock(mutex);
+            stop_requested = 1;
+        }
+        cond_var.notify_all();
+        thread.join();
+    }
+
+    void ReportWriter::Save(int id, fs::path path, const Procedure &proc, ProcedureFile::Format format)
+    {
+        // Binary serialization is fast, and it only touches the reflected members,
+        // so the writer thread never sees the textures and libraries owned by the widgets.
+        Job job{std::move(path), format, Refl::Inline::ToBinary<std::vector<unsigned char>>(proc), {}};
+
+        for (std::size_t i = 0; i < proc.steps.size(); i++)
+        {
+            const std::optional<LazyStepState> &lazy = proc.steps[i].lazy;
+            if (lazy && !lazy->loaded)
+                job.unloaded_widgets.push_back({i, lazy->source, lazy->widgets_begin, lazy->widgets_end});
+        }
+
+        {
+            std::lock_guard lock(mutex);
+            Entry &entry = entries[id];
+            entry.pending = std::move(job); // If there was an older pending snapshot, this replaces it.
+            entry.pending_journal.clear(); // The new snapshot already includes those changes.
+            entry.status = Status::saving;
+        }
+        cond_var.notify_all();
+    }
+
+    void ReportWriter::AppendJournal(int id, fs::path path, std::string records)
+    {
+        {
+            std::lock_guard lock(mutex);
+            Entry &entry = entries[id];
+            if (entry.pending_journal.size() > 0 && entry.pending_journal_report_path != path)
+                entry.pending_journal.clear(); // The report was renamed, the old records don't belong to it.
+            entry.pending_journal += records;
+            entry.pending_journal_report_path = std::move(path);
+            entry.status = Status::saving;
+        }
+        cond_var.notify_all();
+    }
+
+    void ReportWriter::Forget(int id)
+    {
+        std::lock_guard lock(mutex);
+        auto it = entries.find(id);
+        if (it == entries.end())
+            return;
+
+        if (it->second.HasPendingWork() || it->second.writing_now)
+            it->second.forgotten = 1; // The writer thread erases it when it's done.
+        else
+            entries.erase(it);
+    }
+
+    ReportWriter::Status ReportWriter::Wait(int id)
+    {
+        std::unique_lock lock(mutex);
+        cond_var.wait(lock, [&]
+        {
+            auto it = entries.find(id);
+            return it == entries.end() || (!it->second.HasPendingWork() && !it->second.writing_now);
+        });
+
+        auto it = entries.find(id);
+        return it == entries.end() ? Status::none : it->second.status;
+    }
+
+    void ReportWriter::WaitForAll()
+    {
+        std::unique_lock lock(mutex);
+        cond_var.wait(lock, [&]
+        {
+            return std::none_of(entries.begin(), entries.end(), [](const auto &pair){return pair.second.HasPendingWork() || pair.second.writing_now;});
+        });
+    }
+
+    ReportWriter::Status ReportWriter::GetStatus(int id)
+    {
+        std::lock_guard lock(mutex);
+        auto it = entries.find(id);
+        return it == entries.end() ? Status::none : it->second.status;
+    }
+
+    std::vector<ReportWriter::Failure> ReportWriter::TakeFailures()
+    {
+        std::lock_guard lock(mutex);
+        return std::exchange(failures, {});
+    }
+
+    void ReportWriter::ThreadFunc()
+    {
+        std::unique_lock lock(mutex);
+
+        while (1)
+        {
+            auto it = std::find_if(entries.begin(), entries.end(), [](const auto &pair){return pair.second.HasPendingWork();});
+            if (it == entries.end())
+            {
+                if (stop_requested)
+                    return;
+                cond_var.wait(lock);
+                continue;
+            }
+
+            int id = it->first;
+            std::optional<Job> job = std::exchange(it->second.pending, {});
+            std::string journal = std::exchange(it->second.pending_journal, {});
+            fs::path journal_report_path = it->second.pending_journal_report_path;
+            it->second.writing_now = 1;
+
+            lock.unlock();
+
+            fs::path current_path;
+            std::string error;
+            try
+            {
+                if (job)
+                {
+                    current_path = job->path;
+                    WriteFile(*job);
+                }
+
+                if (journal.size() > 0)
+                {
+                    current_path = journal_report_path;
+                    AppendToJournal(journal_report_path, journal);
+                }
+            }
+            catch (std::exception &e)
+            {
+                error = e.what();
+            }
+
+            lock.lock();
+
+            Entry &entry = entries[id];
+            entry.writing_now = 0;
+            if (!entry.HasPendingWork()) // Otherwise there's more work waiting, and we're still saving.
+                entry.status = error.empty() ? Status::saved : Status::failed;
+            if (!error.empty())
+                failures.push_back({id, std::move(current_path), std::move(error)});
+            if (entry.forgotten && !entry.HasPendingWork())
+                entries.erase(id);
+
+            cond_var.notify_all();
+            Interface::Window::WakeUp(); // Let the GUI display the new status.
+        }
+    }
+
+    void ReportWriter::WriteFile(const Job &job)
+    {
+        Stream::ReplaceFile(job.path, [&](Stream::Output &output)
+        {
+            ProcedureFile::Write(output, job.snapshot, job.format, job.unloaded_widgets);
+        });
+
+        // The full report includes everything the journal had.
+        // If we fail to remove the journal, it's not a problem, since replaying it on top of the new report changes nothing.
+        std::error_code ignored;
+        fs::remove(Journal::PathForReport(job.path), ignored);
+    }
+
+    void ReportWriter::AppendToJournal(const fs::path &report_path, const std::string &records)
+    {
+        Stream::SaveFile(Journal::PathForReport(report_path).string(), records, Stream::append);
+    }
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <condition_variable>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "main/procedure_data.h"
+#include "main/procedure_file.h"
+
+namespace Data
+{
+    // Saves procedures to files on a background thread, so that slow disks don't freeze the GUI.
+    // The procedure is snapshotted at the moment `Save()` is called, so it can be modified freely afterwards.
+    // If the same id is saved several times before the writer gets to it, only the last snapshot is written.
+    // Each file is written to a temporary file first, which then replaces the target file.
+    // Reports can also be updated incrementally by appending records to their journals (see `report_journal.h`).
+    // Writing a full report deletes its journal, so journal records must be appended only after the full report they apply to.
+    class ReportWriter
+    {
+      public:
+        enum class Status {none, saving, saved, failed};
+
+        struct Failure
+        {
+            int id = 0;
+            fs::path path;
+            std::string message;
+        };
+
+      private:
+        struct Job
+        {
+            fs::path path;
+            ProcedureFile::Format format = ProcedureFile::Format::text;
+            std::vector<unsigned char> snapshot; // The procedure, serialized with `Refl::ToBinary()`.
+            std::vector<ProcedureFile::UnloadedWidgets> unloaded_widgets; // The steps that weren't loaded have empty widget lists in `snapshot`, their widgets are written from here.
+        };
+
+        struct Entry
+        {
+            Status status = Status::none;
+            std::optional<Job> pending;
+            std::string pending_journal; // Appended to the journal after `pending` is written, if any.
+            fs::path pending_journal_report_path;
+            bool writing_now = 0;
+            bool forgotten = 0; // Set by `Forget()`. The entry is erased once its pending work is done.
+
+            bool HasPendingWork() const
+            {
+                return pending || pending_journal.size() > 0;
+            }
+        };
+
+        std::mutex mutex;
+        std::condition_variable cond_var; // Notified when a job is added or finished, and when the writer is being destroyed.
+        std::map<int, Entry> entries;
+        std::vector<Failure> failures;
+        bool stop_requested = 0;
+
+        std::thread thread; // This has to be the last member, so that it's started after everything else is initialized.
+
+        void ThreadFunc();
+        static void WriteFile(const Job &job);
+        static void AppendToJournal(const fs::path &report_path, const std::string &records);
+
+      public:
+        ReportWriter();
+        ReportWriter(const ReportWriter &) = delete;
+        ReportWriter &operator=(const ReportWriter &) = delete;
+        ~ReportWriter(); // Finishes all pending writes before returning.
+
+        // Schedules saving `proc` to `path`. `id` identifies the tab, it's used for merging saves and querying the status.
+        // Steps that weren't loaded (see `Procedure::LoadStep()`) are written from their source text, without parsing it on this thread.
+        void Save(int id, fs::path path, const Procedure &proc, ProcedureFile::Format format);
+        // Schedules appending `records` to the journal of the report at `path`. See `Save()` for the meaning of `id`.
+        void AppendJournal(int id, fs::path path, std::string records);
+
+        // Call this when the tab `id` is closed. Its entry is erased once its pending writes finish, and its status becomes `none`.
+        // The failures of those writes are still reported by `TakeFailures()`.
+        void Forget(int id);
+
+        // Blocks until there are no pending writes for `id`. Returns the resulting status.
+        Status Wait(int id);
+        // Blocks until there are no pending writes at all.
+        void WaitForAll();
+
+        [[nodiscard]] Status GetStatus(int id);
+
+        // Returns the failures that happened since the last call.
+        [[nodiscard]] std::vector<Failure> TakeFailures();
+    };
+}
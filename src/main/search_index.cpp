@@ -0,0 +1,777 @@
+#include "search_index.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <exception>
+#include <string_view>
+#include <system_error>
+
+#include "interface/window.h"
+#include "main/gui_strings.h"
+#include "main/options.h"
+#include "main/procedure_data.h"
+#include "main/procedure_file.h"
+#include "main/report_journal.h"
+#include "program/errors.h"
+#include "stream/input.h"
+#include "stream/output.h"
+#include "stream/readonly_data.h"
+#include "stream/replace_file.h"
+#include "utils/filesystem.h"
+#include "utils/hash.h"
+#include "utils/unicode.h"
+
+namespace fs = std::filesystem;
+
+namespace Data
+{
+    namespace
+    {
+        constexpr char signature[] = {'M','F','S','E','A','R','C','H'};
+        constexpr std::uint16_t current_version = 1;
+
+        // The index file starts with the signature and a little-endian `uint16_t` version.
+        // Then follows the dictionary: the amount of terms, then the terms in the alphabetical order. Each term is stored as the length of
+        // the prefix shared with the previous term, and the rest of the term (as a length and the bytes).
+        // Then follows the amount of documents, then the documents. Each document is: path, name, `uint8_t` flags, the modification times and sizes
+        // of the file and its journal, the content hash, and then the amount of unique terms followed by pairs of: the difference between
+        // the dictionary index of the term and the previous one, and the term count.
+        // Strings are stored as a length and the bytes. All lengths, counts and indices are unsigned LEB128. Other numbers are little-endian.
+
+        enum DocumentFlags : std::uint8_t
+        {
+            flag_template = 1 << 0,
+        };
+
+        void WriteVarInt(Stream::Output &output, std::uint64_t value)
+        {
+            while (value >= 0x80)
+            {
+                output.WriteLittle<std::uint8_t>((value & 0x7f) | 0x80);
+                value >>= 7;
+            }
+            output.WriteLittle<std::uint8_t>(value);
+        }
+
+        std::uint64_t ReadVarInt(Stream::Input &input)
+        {
+            std::uint64_t ret = 0;
+            for (int shift = 0; shift < 64; shift += 7)
+            {
+                std::uint8_t byte = input.ReadLittle<std::uint8_t>();
+                ret |= std::uint64_t(byte & 0x7f) << shift;
+                if (!(byte & 0x80))
+                    return ret;
+            }
+            Program::Error(input.GetExceptionPrefix() + "Invalid variable-length integer.");
+        }
+
+        void WriteString(Stream::Output &output, std::string_view string)
+        {
+            WriteVarInt(output, string.size());
+            output.WriteBytes(string.data(), string.size());
+        }
+
+        // Reads an element count. Each element takes at least one byte, so a count larger than the remaining input means the file is broken.
+        // This stops a corrupted file from making us allocate a huge array before the reading fails.
+        std::size_t ReadCount(Stream::Input &input)
+        {
+            std::uint64_t count = ReadVarInt(input);
+            if (count > input.RemainingBytes())
+                Program::Error(input.GetExceptionPrefix() + "Element count is out of range.");
+            return count;
+        }
+
+        std::string ReadString(Stream::Input &input)
+        {
+            std::uint64_t size = ReadVarInt(input);
+            if (size > input.RemainingBytes())
+                Program::Error(input.GetExceptionPrefix() + "String length is out of range.");
+            std::string ret(size, '\0');
+            input.ReadLittle<char>(ret.data(), size);
+            return ret;
+        }
+
+        // Words consist of letters and digits. We treat all non-ASCII characters as letters, except for the common punctuation.
+        bool IsWordCharacter(Unicode::Char ch)
+        {
+            if (ch < 0x80)
+                return (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || (ch >= '0' && ch <= '9');
+            if (ch >= 0xa0 && ch <= 0xbf) // Latin-1 punctuation, such as `«»`.
+                return false;
+            if (ch >= 0x2000 && ch <= 0x206f) // General punctuation, such as dashes and spaces.
+                return false;
+            if (ch == 0xfeff) // Zero-width space.
+                return false;
+            return true;
+        }
+
+        struct ScannedFile
+        {
+            std::string path; // Relative to the directory.
+            bool is_template = false;
+        };
+    }
+
+    SearchIndex::~SearchIndex()
+    {
+        StopThread();
+    }
+
+    void SearchIndex::StopThread()
+    {
+        if (!thread.joinable())
+            return;
+
+        {
+            std::lock_guard lock(mutex);
+            stop_requested = true;
+        }
+        cond_var.notify_all();
+        thread.join();
+        stop_requested = false;
+    }
+
+    void SearchIndex::SetDirectory(fs::path new_directory, fs::path new_index_file)
+    {
+        StopThread();
+
+        {
+            std::lock_guard lock(mutex);
+            Clear();
+            directory = std::move(new_directory);
+            index_file = std::move(new_index_file);
+            progress = {};
+            rescan_requested = false;
+            generation++;
+        }
+
+        thread = std::thread([this]{ThreadFunc();});
+    }
+
+    fs::path SearchIndex::Directory()
+    {
+        std::lock_guard lock(mutex);
+        return directory;
+    }
+
+    void SearchIndex::Rescan()
+    {
+        {
+            std::lock_guard lock(mutex);
+            rescan_requested = true;
+        }
+        cond_var.notify_all();
+    }
+
+    SearchIndex::Progress SearchIndex::GetProgress()
+    {
+        std::lock_guard lock(mutex);
+        Progress ret = progress;
+        ret.documents = document_count;
+        return ret;
+    }
+
+    std::uint64_t SearchIndex::Generation()
+    {
+        std::lock_guard lock(mutex);
+        return generation;
+    }
+
+    void SearchIndex::Tokenize(const std::string &text, std::vector<std::string> &words)
+    {
+        std::string word;
+        auto FinishWord = [&]
+        {
+            if (word.empty())
+                return;
+            if (word.size() > Options::Search::max_word_length)
+            {
+                // Cut at a character boundary.
+                std::size_t size = Options::Search::max_word_length;
+                while (size > 0 && !Unicode::IsFirstByte(word[size]))
+                    size--;
+                word.resize(size);
+            }
+            words.push_back(std::move(word));
+            word.clear();
+        };
+
+        std::string lowercase_text = LowercaseForSearch(text);
+        for (Unicode::Char ch : Unicode::Iterator(lowercase_text))
+        {
+            if (IsWordCharacter(ch))
+                Unicode::Encode(ch, word);
+            else
+                FinishWord();
+        }
+        FinishWord();
+    }
+
+    void SearchIndex::Clear()
+    {
+        documents.clear();
+        free_document_ids.clear();
+        document_ids.clear();
+        term_ids.clear();
+        postings.clear();
+        total_length = 0;
+        document_count = 0;
+    }
+
+    SearchIndex::TermId SearchIndex::GetTermId(const std::string &term)
+    {
+        auto [it, inserted] = term_ids.try_emplace(term, postings.size());
+        if (inserted)
+            postings.emplace_back();
+        return it->second;
+    }
+
+    SearchIndex::DocId SearchIndex::AddDocument(Document document, const std::vector<std::pair<std::string, std::uint32_t>> &words)
+    {
+        DocId id;
+        if (free_document_ids.size() > 0)
+        {
+            id = free_document_ids.back();
+            free_document_ids.pop_back();
+        }
+        else
+        {
+            id = documents.size();
+            documents.emplace_back();
+        }
+
+        document.exists = true;
+        document.length = 0;
+        document.terms.clear();
+        document.terms.reserve(words.size());
+        for (const auto &[word, count] : words)
+        {
+            TermId term = GetTermId(word);
+            document.terms.emplace_back(term, count);
+            postings[term].push_back({id, count});
+            document.length += count;
+        }
+
+        total_length += document.length;
+        document_count++;
+        document_ids[document.path] = id;
+        documents[id] = std::move(document);
+        return id;
+    }
+
+    void SearchIndex::RemoveDocuments(const std::vector<DocId> &ids)
+    {
+        if (ids.empty())
+            return;
+
+        // Mark the documents as removed, then filter each affected posting list once.
+        // Removing the documents one by one would scan the common lists once per document.
+        std::vector<char> removed(documents.size());
+        std::vector<TermId> affected_terms;
+        for (DocId id : ids)
+        {
+            removed[id] = true;
+            for (const auto &[term, count] : documents[id].terms)
+                affected_terms.push_back(term);
+        }
+        std::sort(affected_terms.begin(), affected_terms.end());
+        affected_terms.erase(std::unique(affected_terms.begin(), affected_terms.end()), affected_terms.end());
+
+        for (TermId term : affected_terms)
+        {
+            std::vector<Posting> &list = postings[term];
+            list.erase(std::remove_if(list.begin(), list.end(), [&](const Posting &posting){return removed[posting.doc];}), list.end());
+        }
+
+        for (DocId id : ids)
+        {
+            Document &document = documents[id];
+            total_length -= document.length;
+            document_count--;
+            document_ids.erase(document.path);
+            document = {};
+            document.exists = false;
+            free_document_ids.push_back(id);
+        }
+    }
+
+    void SearchIndex::ThreadFunc()
+    {
+        LoadIndexFile();
+
+        while (1)
+        {
+            Scan();
+            Interface::Window::WakeUp();
+
+            std::unique_lock lock(mutex);
+            cond_var.wait(lock, [&]{return rescan_requested || stop_requested;});
+            if (stop_requested)
+                return;
+        }
+    }
+
+    void SearchIndex::Scan()
+    {
+        fs::path dir;
+        {
+            std::lock_guard lock(mutex);
+            rescan_requested = false;
+            dir = directory;
+            progress.scanning = true;
+            progress.files_found = 0;
+            progress.files_checked = 0;
+            progress.files_parsed = 0;
+        }
+
+        std::vector<ScannedFile> files;
+        bool ok = true;
+        Filesystem::TreeNode tree = Filesystem::GetObjectTree(dir.string(), Options::Search::max_depth, &ok);
+        if (ok)
+        {
+            Filesystem::ForEachObject(tree, [&](const Filesystem::TreeNode &node)
+            {
+                if (node.info.category != Filesystem::file)
+                    return;
+                fs::path extension = fs::path(node.name).extension();
+                bool is_template = extension == Options::template_extension;
+                if (is_template || extension == Options::report_extension)
+                    files.push_back({fs::path(node.path).lexically_relative(dir).generic_string(), is_template});
+            });
+        }
+
+        {
+            std::lock_guard lock(mutex);
+            progress.files_found = files.size();
+            for (Document &document : documents)
+                document.found_by_scan = false;
+        }
+
+        bool interrupted = false;
+        std::size_t unsaved_documents = 0;
+        std::vector<std::string> strings, words;
+        std::vector<std::pair<std::string, std::uint32_t>> word_counts;
+
+        for (const ScannedFile &file : files)
+        {
+            {
+                std::lock_guard lock(mutex);
+                progress.files_checked++;
+                if (stop_requested || rescan_requested)
+                {
+                    interrupted = true;
+                    break;
+                }
+            }
+
+            fs::path path = dir / file.path;
+            fs::path journal_path = Journal::PathForReport(path);
+
+            Document document;
+            document.path = file.path;
+            document.is_template = file.is_template;
+
+            std::error_code error;
+            document.modification_time = fs::last_write_time(path, error).time_since_epoch().count();
+            if (!error)
+                document.file_size = fs::file_size(path, error);
+            if (error)
+                continue; // The file was removed while we were scanning.
+            if (!file.is_template && fs::is_regular_file(journal_path, error))
+            {
+                document.journal_modification_time = fs::last_write_time(journal_path, error).time_since_epoch().count();
+                if (!error)
+                    document.journal_size = fs::file_size(journal_path, error);
+                if (error)
+                    continue;
+            }
+
+            // Skip the unchanged files.
+            {
+                std::lock_guard lock(mutex);
+                auto it = document_ids.find(file.path);
+                if (it != document_ids.end())
+                {
+                    Document &old_document = documents[it->second];
+                    if (old_document.modification_time == document.modification_time && old_document.file_size == document.file_size &&
+                        old_document.journal_modification_time == document.journal_modification_time && old_document.journal_size == document.journal_size)
+                    {
+                        old_document.found_by_scan = true;
+                        continue;
+                    }
+                }
+            }
+
+            try
+            {
+                Stream::ReadOnlyData data = Stream::ReadOnlyData::file(path.string());
+                Stream::ReadOnlyData journal;
+                if (document.journal_size > 0)
+                    journal = Stream::ReadOnlyData::file(journal_path.string());
+                document.content_hash = Hash::Compute(std::string_view(data.data_char(), data.size()), std::string_view(journal.data_char(), journal.size()));
+
+                // Skip the files that were touched but not changed.
+                {
+                    std::lock_guard lock(mutex);
+                    auto it = document_ids.find(file.path);
+                    if (it != document_ids.end() && documents[it->second].content_hash == document.content_hash)
+                    {
+                        Document &old_document = documents[it->second];
+                        old_document.modification_time = document.modification_time;
+                        old_document.file_size = document.file_size;
+                        old_document.journal_modification_time = document.journal_modification_time;
+                        old_document.journal_size = document.journal_size;
+                        old_document.found_by_scan = true;
+                        unsaved_documents++;
+                        continue;
+                    }
+                }
+
+                strings.clear();
+                words.clear();
+                word_counts.clear();
+
+                try
+                {
+                    Procedure proc = ProcedureFile::Read(data);
+                    if (!file.is_template)
+                        Journal::Replay(proc, path);
+
+                    document.name = proc.name;
+                    strings.push_back(std::move(proc.name));
+                    for (ProcedureStep &step : proc.steps)
+                    {
+                        strings.push_back(std::move(step.name));
+                        for (const Widgets::Widget &widget : step.widgets)
+                            widget->ListSearchableText(strings);
+                    }
+                }
+                catch (std::exception &)
+                {
+                    // The file is broken. We index it without any words, so that we don't parse it again until it changes.
+                }
+
+                for (const std::string &string : strings)
+                    Tokenize(string, words);
+
+                std::sort(words.begin(), words.end());
+                for (std::string &word : words)
+                {
+                    if (word_counts.size() > 0 && word_counts.back().first == word)
+                        word_counts.back().second++;
+                    else
+                        word_counts.emplace_back(std::move(word), 1);
+                }
+            }
+            catch (std::exception &)
+            {
+                continue; // The file can't be read. We'll try again during the next scan.
+            }
+
+            document.found_by_scan = true;
+
+            {
+                std::lock_guard lock(mutex);
+                auto it = document_ids.find(file.path);
+                if (it != document_ids.end())
+                    RemoveDocuments({it->second});
+                AddDocument(std::move(document), word_counts);
+                progress.files_parsed++;
+                generation++;
+            }
+
+            // Save the progress from time to time, in case the program is closed before the scan finishes.
+            if (++unsaved_documents >= Options::Search::save_interval)
+            {
+                unsaved_documents = 0;
+                SaveIndexFile();
+                Interface::Window::WakeUp();
+            }
+        }
+
+        {
+            std::lock_guard lock(mutex);
+
+            // Forget the removed files. If the scan was interrupted, we don't know which files were removed.
+            if (!interrupted)
+            {
+                std::vector<DocId> removed_ids;
+                for (DocId id = 0; id < documents.size(); id++)
+                {
+                    if (documents[id].exists && !documents[id].found_by_scan)
+                        removed_ids.push_back(id);
+                }
+
+                if (removed_ids.size() > 0)
+                {
+                    RemoveDocuments(removed_ids);
+                    unsaved_documents += removed_ids.size();
+                    generation++;
+                }
+            }
+
+            progress.scanning = false;
+            if (progress.files_parsed > 0)
+                unsaved_documents++;
+        }
+
+        if (unsaved_documents > 0)
+            SaveIndexFile();
+    }
+
+    std::vector<SearchIndex::Result> SearchIndex::Search(const std::string &query, std::size_t max_results)
+    {
+        std::vector<std::string> words;
+        Tokenize(query, words);
+        std::sort(words.begin(), words.end());
+        words.erase(std::unique(words.begin(), words.end()), words.end());
+
+        std::vector<Result> ret;
+        if (words.empty())
+            return ret;
+
+        std::lock_guard lock(mutex);
+        if (document_count == 0)
+            return ret;
+
+        scratch_scores.resize(documents.size());
+        scratch_matched_words.resize(documents.size());
+        scratch_touched.clear();
+
+        const float k1 = Options::Search::bm25_k1, b = Options::Search::bm25_b;
+        float average_length = total_length / float(document_count);
+
+        for (std::uint32_t word_index = 0; word_index < words.size(); word_index++)
+        {
+            const std::string &word = words[word_index];
+
+            // Visit all terms starting with this word.
+            for (auto it = term_ids.lower_bound(word); it != term_ids.end() && it->first.compare(0, word.size(), word) == 0; it++)
+            {
+                const std::vector<Posting> &list = postings[it->second];
+                if (list.empty())
+                    continue;
+
+                float weight = it->first.size() == word.size() ? 1 : Options::Search::prefix_match_weight;
+                float idf = std::log(1 + (document_count - list.size() + 0.5f) / (list.size() + 0.5f));
+
+                for (const Posting &posting : list)
+                {
+                    std::uint32_t &matched = scratch_matched_words[posting.doc];
+
+                    // Only the documents that matched all previous words can match.
+                    if (matched == word_index)
+                    {
+                        matched++;
+                        if (word_index == 0)
+                            scratch_touched.push_back(posting.doc);
+                    }
+                    else if (matched != word_index + 1)
+                    {
+                        continue;
+                    }
+
+                    float length_ratio = documents[posting.doc].length / average_length;
+                    scratch_scores[posting.doc] += weight * idf * posting.count * (k1 + 1) / (posting.count + k1 * (1 - b + b * length_ratio));
+                }
+            }
+        }
+
+        std::vector<std::pair<float, DocId>> found;
+        for (DocId id : scratch_touched)
+        {
+            if (scratch_matched_words[id] == words.size())
+                found.emplace_back(scratch_scores[id], id);
+            scratch_scores[id] = 0;
+            scratch_matched_words[id] = 0;
+        }
+
+        std::size_t result_count = std::min(found.size(), max_results);
+        std::partial_sort(found.begin(), found.begin() + result_count, found.end(), [&](const auto &a, const auto &b)
+        {
+            if (a.first != b.first)
+                return a.first > b.first;
+            return documents[a.second].path < documents[b.second].path;
+        });
+
+        ret.reserve(result_count);
+        for (std::size_t i = 0; i < result_count; i++)
+        {
+            const Document &document = documents[found[i].second];
+            ret.push_back({document.path, document.name, document.is_template, found[i].first});
+        }
+        return ret;
+    }
+
+    void SearchIndex::LoadIndexFile()
+    {
+        fs::path file_name;
+        {
+            std::lock_guard lock(mutex);
+            file_name = index_file;
+        }
+
+        std::error_code error;
+        if (!fs::is_regular_file(file_name, error))
+            return;
+
+        try
+        {
+            Stream::ReadOnlyData data = Stream::ReadOnlyData::file(file_name.string());
+            Stream::Input input(data);
+
+            char file_signature[sizeof signature];
+            input.ReadLittle<char>(file_signature, sizeof signature);
+            if (std::memcmp(file_signature, signature, sizeof signature) != 0 || input.ReadLittle<std::uint16_t>() != current_version)
+                return; // The index will be rebuilt from scratch.
+
+            std::vector<std::string> terms(ReadCount(input));
+            for (std::size_t i = 0; i < terms.size(); i++)
+            {
+                std::size_t prefix_size = ReadVarInt(input);
+                if (i == 0 ? prefix_size != 0 : prefix_size > terms[i-1].size())
+                    Program::Error(input.GetExceptionPrefix() + "Invalid term prefix.");
+                terms[i] = (i == 0 ? std::string() : terms[i-1].substr(0, prefix_size)) + ReadString(input);
+            }
+
+            std::vector<Document> new_documents(ReadCount(input));
+            for (Document &document : new_documents)
+            {
+                document.path = ReadString(input);
+                document.name = ReadString(input);
+                document.is_template = input.ReadLittle<std::uint8_t>() & flag_template;
+                document.modification_time = input.ReadLittle<std::int64_t>();
+                document.file_size = input.ReadLittle<std::uint64_t>();
+                document.journal_modification_time = input.ReadLittle<std::int64_t>();
+                document.journal_size = input.ReadLittle<std::uint64_t>();
+                document.content_hash = input.ReadLittle<std::uint64_t>();
+
+                document.terms.resize(ReadCount(input));
+                std::uint64_t term_index = 0;
+                for (auto &[term, count] : document.terms)
+                {
+                    term_index += ReadVarInt(input);
+                    if (term_index >= terms.size())
+                        Program::Error(input.GetExceptionPrefix() + "Term index is out of range.");
+                    term = term_index;
+                    count = ReadVarInt(input);
+                }
+            }
+            input.ExpectEnd();
+
+            std::lock_guard lock(mutex);
+            Clear();
+
+            // The dictionary is sorted, so the term ids are assigned in the same order.
+            for (const std::string &term : terms)
+                GetTermId(term);
+
+            std::vector<std::pair<std::string, std::uint32_t>> words;
+            for (Document &document : new_documents)
+            {
+                words.clear();
+                for (const auto &[term, count] : document.terms)
+                    words.emplace_back(terms[term], count);
+                AddDocument(std::move(document), words);
+            }
+
+            generation++;
+        }
+        catch (std::exception &)
+        {
+            std::lock_guard lock(mutex);
+            Clear(); // The index will be rebuilt from scratch.
+        }
+    }
+
+    void SearchIndex::SaveIndexFile()
+    {
+        // Copy what we need under the lock, and serialize it afterwards, so that searching isn't blocked while we write to the disk.
+        fs::path file_name;
+        std::vector<std::string> terms; // Only the terms that are still used are saved, sorted. They get new indices.
+        std::vector<Document> saved_documents; // Their `terms` use the new indices.
+        {
+            std::lock_guard lock(mutex);
+            file_name = index_file;
+
+            std::vector<std::uint32_t> new_term_indices(postings.size());
+            for (const auto &[term, id] : term_ids)
+            {
+                if (postings[id].size() > 0)
+                {
+                    new_term_indices[id] = terms.size();
+                    terms.push_back(term);
+                }
+            }
+
+            saved_documents.reserve(document_count);
+            for (const Document &document : documents)
+            {
+                if (!document.exists)
+                    continue;
+
+                Document &copy = saved_documents.emplace_back(document);
+                for (auto &[term, count] : copy.terms)
+                    term = new_term_indices[term];
+            }
+        }
+
+        // Since the index can always be rebuilt, the errors are ignored.
+        try
+        {
+            std::error_code error;
+            fs::create_directories(file_name.parent_path(), error);
+
+            Stream::ReplaceFile(file_name, [&](Stream::Output &output)
+            {
+                output.WriteBytes(signature, sizeof signature);
+                output.WriteLittle<std::uint16_t>(current_version);
+
+                WriteVarInt(output, terms.size());
+                for (std::size_t i = 0; i < terms.size(); i++)
+                {
+                    const std::string &term = terms[i];
+
+                    std::size_t prefix_size = 0;
+                    if (i > 0)
+                    {
+                        const std::string &prev_term = terms[i-1];
+                        std::size_t max_prefix_size = std::min(term.size(), prev_term.size());
+                        while (prefix_size < max_prefix_size && term[prefix_size] == prev_term[prefix_size])
+                            prefix_size++;
+                    }
+
+                    WriteVarInt(output, prefix_size);
+                    WriteString(output, std::string_view(term).substr(prefix_size));
+                }
+
+                WriteVarInt(output, saved_documents.size());
+                for (Document &document : saved_documents)
+                {
+                    WriteString(output, document.path);
+                    WriteString(output, document.name);
+                    output.WriteLittle<std::uint8_t>(document.is_template ? flag_template : 0);
+                    output.WriteLittle<std::int64_t>(document.modification_time);
+                    output.WriteLittle<std::uint64_t>(document.file_size);
+                    output.WriteLittle<std::int64_t>(document.journal_modification_time);
+                    output.WriteLittle<std::uint64_t>(document.journal_size);
+                    output.WriteLittle<std::uint64_t>(document.content_hash);
+
+                    std::sort(document.terms.begin(), document.terms.end());
+
+                    WriteVarInt(output, document.terms.size());
+                    std::uint32_t prev_index = 0;
+                    for (const auto &[index, count] : document.terms)
+                    {
+                        WriteVarInt(output, index - prev_index);
+                        WriteVarInt(output, count);
+                        prev_index = index;
+                    }
+                }
+            });
+        }
+        catch (std::exception &) {}
+    }
+}
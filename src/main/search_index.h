@@ -0,0 +1,131 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace Data
+{
+    // A full-text index of the reports and templates in a directory (recursively).
+    // The indexed text is: step names, `Text` widgets, `TextInput` labels and values, and checkbox labels (see `Widgets::BasicWidget::ListSearchableText()`).
+    // Report journals are replayed before indexing, so the values are current.
+    // The index is built on a background thread, and is saved to a file between runs (one file per directory).
+    // When rescanning, files with unchanged modification time and size are skipped. Files with unchanged content hash are not parsed again.
+    // Search results are ranked with BM25. All query words must match, either exactly or as a prefix of an indexed word.
+    // All member functions are thread-safe.
+    class SearchIndex
+    {
+      public:
+        struct Result
+        {
+            std::string path; // Relative to the directory.
+            std::string name; // The procedure name.
+            bool is_template = false;
+            float score = 0;
+        };
+
+        struct Progress
+        {
+            bool scanning = false;
+            std::size_t files_found = 0; // Files found by the current scan.
+            std::size_t files_checked = 0; // Files from `files_found` that were already checked.
+            std::size_t files_parsed = 0; // Files that had to be parsed again, during the current or the last scan.
+            std::size_t documents = 0; // Files in the index.
+        };
+
+      private:
+        using TermId = std::uint32_t;
+        using DocId = std::uint32_t;
+
+        struct Document
+        {
+            std::string path, name;
+            bool is_template = false;
+            std::int64_t modification_time = 0, journal_modification_time = 0;
+            std::uint64_t file_size = 0, journal_size = 0; // The journal fields are zero if there's no journal.
+            std::uint64_t content_hash = 0; // A hash of the file and the journal contents.
+            std::uint32_t length = 0; // The amount of words.
+            std::vector<std::pair<TermId, std::uint32_t>> terms; // Term ids and their counts.
+            bool exists = true; // If false, this slot is unused.
+            bool found_by_scan = false; // Used to find the removed files.
+        };
+
+        struct Posting
+        {
+            DocId doc = 0;
+            std::uint32_t count = 0;
+        };
+
+        std::mutex mutex;
+        std::condition_variable cond_var; // Notified when a rescan is requested, and when the thread should stop.
+
+        std::filesystem::path directory, index_file;
+        bool rescan_requested = false;
+        bool stop_requested = false;
+        Progress progress;
+        std::uint64_t generation = 0; // Incremented when the contents of the index change.
+
+        // Those are protected by the mutex.
+        std::vector<Document> documents; // Indexed by `DocId`.
+        std::vector<DocId> free_document_ids; // Unused slots in `documents`.
+        std::unordered_map<std::string, DocId> document_ids; // Maps `Document::path` to the ids.
+        std::map<std::string, TermId> term_ids; // This is ordered to allow searching by prefix.
+        std::vector<std::vector<Posting>> postings; // Indexed by `TermId`.
+        std::uint64_t total_length = 0; // Sum of `Document::length` for all existing documents.
+        std::size_t document_count = 0; // The amount of existing documents.
+
+        // Reused by `Search()`, to avoid allocations.
+        std::vector<float> scratch_scores;
+        std::vector<std::uint32_t> scratch_matched_words;
+        std::vector<DocId> scratch_touched;
+
+        std::thread thread; // Started by `SetDirectory()`, and restarted when the directory changes.
+
+        void ThreadFunc();
+        void Scan();
+
+        // Those expect the mutex to be locked.
+        void Clear();
+        TermId GetTermId(const std::string &term);
+        DocId AddDocument(Document document, const std::vector<std::pair<std::string, std::uint32_t>> &words);
+        void RemoveDocuments(const std::vector<DocId> &ids);
+
+        void LoadIndexFile(); // Locks the mutex by itself.
+        void SaveIndexFile(); // Same. Doesn't hold the mutex while writing.
+
+        void StopThread();
+
+      public:
+        SearchIndex() {}
+        SearchIndex(const SearchIndex &) = delete;
+        SearchIndex &operator=(const SearchIndex &) = delete;
+        ~SearchIndex();
+
+        // Starts indexing a different directory. `new_index_file` is where the index is saved between runs.
+        void SetDirectory(std::filesystem::path new_directory, std::filesystem::path new_index_file);
+        [[nodiscard]] std::filesystem::path Directory();
+
+        // Checks the directory for new, changed and removed files in the background.
+        void Rescan();
+
+        [[nodiscard]] Progress GetProgress();
+        // Changes every time the indexed documents change. Use it to avoid repeating the same search every frame.
+        [[nodiscard]] std::uint64_t Generation();
+
+        // Returns at most `max_results` best matching documents, best first.
+        [[nodiscard]] std::vector<Result> Search(const std::string &query, std::size_t max_results);
+
+        // Splits a text into lowercase words, and appends them to `words`.
+        static void Tokenize(const std::string &text, std::vector<std::string> &words);
+    };
+
+    inline SearchIndex search_index;
+}
@@ -0,0 +1,196 @@
+#include "search_panel.h"
+
+#include <exception>
+#include <system_error>
+
+#include "main/common.h"
+#include "main/file_dialogs.h"
+#include "main/gui_strings.h"
+#include "main/options.h"
+#include "stream/readonly_data.h"
+#include "stream/save_to_file.h"
+#include "utils/clock.h"
+#include "utils/hash.h"
+
+namespace fs = std::filesystem;
+
+fs::path GuiElements::SearchPanel::LastDirectoryFile() const
+{
+    return cache_dir / "last_directory";
+}
+
+void GuiElements::SearchPanel::SetDirectory(fs::path directory)
+{
+    std::error_code error;
+    fs::path canonical_directory = fs::weakly_canonical(directory, error);
+    if (!error)
+        directory = std::move(canonical_directory);
+
+    std::string directory_string = directory.string();
+    fs::path index_file = cache_dir / "{:016x}.index"_format(std::uint64_t(Hash::Compute(directory_string)));
+    Data::search_index.SetDirectory(directory, index_file);
+
+    // Remember the directory for the next run. It's not a problem if this fails.
+    try
+    {
+        fs::create_directories(cache_dir, error);
+        Stream::SaveFile(LastDirectoryFile().string(), directory_string.data(), directory_string.data() + directory_string.size());
+    }
+    catch (std::exception &) {}
+
+    generation = -1;
+    selected_path.clear();
+}
+
+void GuiElements::SearchPanel::Open(fs::path new_cache_dir)
+{
+    cache_dir = std::move(new_cache_dir);
+    open_requested = true;
+
+    if (Data::search_index.Directory().empty())
+    {
+        std::error_code error;
+        if (fs::is_regular_file(LastDirectoryFile(), error))
+        {
+            try
+            {
+                Stream::ReadOnlyData data = Stream::ReadOnlyData::file(LastDirectoryFile().string());
+                SetDirectory(std::string(data.data_char(), data.size()));
+            }
+            catch (std::exception &) {}
+        }
+    }
+    else
+    {
+        Data::search_index.Rescan(); // Pick up the files changed since the last time.
+    }
+}
+
+fs::path GuiElements::SearchPanel::Display()
+{
+    fs::path result;
+    showing_progress = false;
+
+    if (open_requested)
+    {
+        open_requested = false;
+        ImGui::OpenPopup(modal_name);
+    }
+
+    if (!ImGui::IsPopupOpen(modal_name))
+        return result;
+
+    ImGui::SetNextWindowPos(ivec2(Options::Visual::image_preview_outer_margin));
+    ImGui::SetNextWindowSize(ivec2(window.Size() - 2 * Options::Visual::image_preview_outer_margin));
+
+    if (!ImGui::BeginPopupModal(modal_name, 0, Options::Visual::modal_window_flags))
+        return result;
+
+    fs::path directory = Data::search_index.Directory();
+
+    { // Directory
+        if (ImGui::Button("Выбрать папку"))
+        {
+            if (auto new_directory = FileDialogs::SelectFolder("Папка для поиска", directory.string()))
+            {
+                SetDirectory(*new_directory);
+                directory = Data::search_index.Directory();
+            }
+        }
+        ImGui::SameLine();
+        if (directory.empty())
+            ImGui::TextDisabled("%s", "Папка не выбрана");
+        else
+            ImGui::TextUnformatted(directory.string().c_str());
+    }
+
+    Data::SearchIndex::Progress progress = Data::search_index.GetProgress();
+
+    { // Query
+        ImGui::PushItemWidth(round(ImGui::GetWindowContentRegionWidth() / 2));
+        if (ImGui::IsWindowAppearing())
+            ImGui::SetKeyboardFocusHere();
+        query_changed |= ImGui::InputText("Поиск###search_query", &query);
+        ImGui::PopItemWidth();
+
+        std::uint64_t new_generation = Data::search_index.Generation();
+        if (query_changed || new_generation != generation)
+        {
+            query_changed = false;
+            generation = new_generation;
+
+            uint64_t start = Clock::Time();
+            results = Data::search_index.Search(query, Options::Search::max_results);
+            search_duration = Clock::TicksToSeconds(Clock::Time() - start);
+        }
+
+        ImGui::SameLine();
+        showing_progress = progress.scanning;
+        if (progress.scanning)
+            ImGui::TextDisabled("%s", "Индексация: {} из {}..."_format(progress.files_checked, progress.files_found).c_str());
+        else
+            ImGui::TextDisabled("%s", "Файлов в индексе: {}"_format(progress.documents).c_str());
+    }
+
+    bool double_clicked = false;
+
+    ImGui::BeginChild("search_results", fvec2(0, -ImGui::GetFrameHeightWithSpacing() * 2), true);
+    ImGui::Columns(3, "search_result_columns");
+    ImGui::TextDisabled("%s", "Название");
+    ImGui::NextColumn();
+    ImGui::TextDisabled("%s", "Файл");
+    ImGui::NextColumn();
+    ImGui::TextDisabled("%s", "Релевантность");
+    ImGui::NextColumn();
+    ImGui::Separator();
+
+    int index = 0;
+    for (const Data::SearchIndex::Result &entry : results)
+    {
+        const char *label = Data::frame_scratch.Str(Data::EscapeStringForWidgetName(entry.name), entry.is_template ? " (шаблон)" : "", "###search_result:", index++);
+        if (ImGui::Selectable(label, selected_path == entry.path, ImGuiSelectableFlags_SpanAllColumns | ImGuiSelectableFlags_AllowDoubleClick))
+        {
+            selected_path = entry.path;
+            double_clicked = ImGui::IsMouseDoubleClicked(0);
+        }
+        ImGui::NextColumn();
+        ImGui::TextUnformatted(entry.path.c_str());
+        ImGui::NextColumn();
+        ImGui::TextUnformatted("{:.2f}"_format(entry.score).c_str());
+        ImGui::NextColumn();
+    }
+
+    ImGui::Columns(1);
+    ImGui::EndChild();
+
+    if (query.size() > 0)
+        ImGui::TextDisabled("%s", "Найдено: {}{} ({:.1f} мс)"_format(results.size(), results.size() >= Options::Search::max_results ? "+" : "", search_duration * 1000).c_str());
+    else
+        ImGui::TextDisabled("%s", "Введите слова для поиска. Ищутся названия шагов, тексты, текстовые поля и подписи галочек.");
+
+    bool have_selection = false;
+    for (const Data::SearchIndex::Result &entry : results)
+    {
+        if (entry.path == selected_path)
+        {
+            have_selection = true;
+            break;
+        }
+    }
+
+    if ((ImGui::Button("Открыть") || double_clicked) && have_selection)
+        result = directory / selected_path;
+    ImGui::SameLine();
+    if (ImGui::Button("Обновить индекс") && !directory.empty())
+        Data::search_index.Rescan();
+
+    ImGui::SameLine();
+    const std::string text_close = "Закрыть";
+    int close_button_width = ImGui::CalcTextSize(text_close.c_str()).x + ImGui::GetStyle().FramePadding.x * 2;
+    ImGui::SetCursorPosX(ImGui::GetCursorPos().x + ImGui::GetContentRegionAvail().x - close_button_width);
+    if (ImGui::Button(text_close.c_str()) || Input::Button(Input::escape).pressed() || !result.empty())
+        ImGui::CloseCurrentPopup();
+
+    ImGui::EndPopup();
+    return result;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "main/search_index.h"
+
+namespace GuiElements
+{
+    // Full-text search over the reports and templates in a directory, using `Data::search_index`.
+    // The directory is chosen by the user, and is remembered between runs.
+    class SearchPanel
+    {
+        static constexpr const char *modal_name = "search_panel_modal";
+        bool open_requested = false;
+        std::filesystem::path cache_dir; // Where the index files are stored.
+
+        std::string query;
+        bool query_changed = true;
+        std::uint64_t generation = -1; // The index generation `results` were computed at.
+        std::vector<Data::SearchIndex::Result> results;
+        double search_duration = 0; // In seconds.
+
+        std::string selected_path; // `Result::path` of the selected result, if any.
+
+        bool showing_progress = false; // If the panel is open and the index is being built.
+
+        [[nodiscard]] std::filesystem::path LastDirectoryFile() const;
+        void SetDirectory(std::filesystem::path directory);
+
+      public:
+        // `new_cache_dir` is where the index files are stored.
+        void Open(std::filesystem::path new_cache_dir);
+
+        // Returns the absolute path of the file the user wants to open, or an empty path.
+        [[nodiscard]] std::filesystem::path Display();
+
+        // Returns true if the indexing progress is displayed.
+        [[nodiscard]] bool WantsContinuousRedraw() const
+        {
+            return showing_progress;
+        }
+    };
+}
@@ -0,0 +1,171 @@
+#include "template_browser.h"
+
+#include "main/common.h"
+#include "main/gui_strings.h"
+#include "main/options.h"
+
+void GuiElements::TemplateBrowser::UpdateTemplates()
+{
+    std::uint64_t new_generation = Data::template_index.Generation();
+    if (new_generation != generation)
+    {
+        generation = new_generation;
+        templates = Data::template_index.Templates();
+
+        search_names.clear();
+        search_names.reserve(templates.size());
+        for (const Data::TemplateInfo &info : templates)
+            search_names.push_back(Data::LowercaseForSearch(info.name + '\n' + info.path));
+    }
+    else if (!filter_changed)
+    {
+        return;
+    }
+
+    filter_changed = false;
+
+    std::string lowercase_filter = Data::LowercaseForSearch(filter);
+    filtered_templates.clear();
+    for (std::size_t i = 0; i < search_names.size(); i++)
+    {
+        if (search_names[i].find(lowercase_filter) != std::string::npos)
+            filtered_templates.push_back(i);
+    }
+}
+
+GuiElements::TemplateBrowser::Result GuiElements::TemplateBrowser::Display()
+{
+    Result result;
+
+    if (open_requested)
+    {
+        open_requested = false;
+        filter.clear();
+        filter_changed = true;
+        ImGui::OpenPopup(modal_name);
+    }
+
+    if (!ImGui::IsPopupOpen(modal_name))
+        return result;
+
+    ImGui::SetNextWindowPos(ivec2(Options::Visual::image_preview_outer_margin));
+    ImGui::SetNextWindowSize(ivec2(window.Size() - 2 * Options::Visual::image_preview_outer_margin));
+
+    if (!ImGui::BeginPopupModal(modal_name, 0, Options::Visual::modal_window_flags))
+        return result;
+
+    UpdateTemplates();
+
+    ImGui::PushItemWidth(round(ImGui::GetWindowContentRegionWidth() / 2));
+    if (ImGui::IsWindowAppearing())
+        ImGui::SetKeyboardFocusHere();
+    filter_changed |= ImGui::InputText("Поиск###template_filter", &filter);
+    ImGui::PopItemWidth();
+
+    if (!Data::template_index.IsReady())
+    {
+        ImGui::SameLine();
+        ImGui::TextDisabled("%s", "Поиск шаблонов...");
+    }
+
+    bool double_clicked = false;
+
+    ImGui::BeginChild("template_list", fvec2(0, -ImGui::GetFrameHeightWithSpacing()), true);
+    ImGui::Columns(4, "template_columns");
+    ImGui::TextDisabled("%s", "Название");
+    ImGui::NextColumn();
+    ImGui::TextDisabled("%s", "Файл");
+    ImGui::NextColumn();
+    ImGui::TextDisabled("%s", "Шагов");
+    ImGui::NextColumn();
+    ImGui::TextDisabled("%s", "Изображений");
+    ImGui::NextColumn();
+    ImGui::Separator();
+
+    for (int index : filtered_templates)
+    {
+        const Data::TemplateInfo &info = templates[index];
+        bool has_error = info.error.size() > 0;
+
+        // The selectable has no label, and the name is drawn on top of it, so the name doesn't need escaping.
+        ImGui::PushID(index);
+        if (ImGui::Selectable("##template", selected_path == info.path, ImGuiSelectableFlags_SpanAllColumns | ImGuiSelectableFlags_AllowDoubleClick))
+        {
+            selected_path = info.path;
+            double_clicked = ImGui::IsMouseDoubleClicked(0);
+        }
+        ImGui::PopID();
+        bool hovered = ImGui::IsItemHovered();
+
+        ImGui::SameLine(0, 0);
+        if (has_error)
+            ImGui::PushStyleColor(ImGuiCol_Text, fvec4(0.8,0,0,1));
+        ImGui::TextUnformatted(has_error ? "(ошибка)" : info.name.c_str());
+        if (has_error)
+            ImGui::PopStyleColor();
+
+        if (hovered)
+        {
+            ImGui::BeginTooltip();
+            if (has_error)
+            {
+                ImGui::TextUnformatted("Не удалось прочитать шаблон:");
+                ImGui::TextUnformatted(info.error.c_str());
+            }
+            else
+            {
+                ImGui::TextUnformatted(Data::frame_scratch.Str("Библиотеки: ", info.libraries.empty() ? "нет" : ""));
+                for (const std::string &library : info.libraries)
+                    ImGui::BulletText("%s", library.c_str());
+                ImGui::TextUnformatted(Data::frame_scratch.Str("Изображения: ", info.images.empty() ? "нет" : ""));
+                for (const std::string &image : info.images)
+                    ImGui::BulletText("%s", image.c_str());
+            }
+            ImGui::EndTooltip();
+        }
+
+        ImGui::NextColumn();
+        ImGui::TextUnformatted(info.path.c_str());
+        ImGui::NextColumn();
+        if (!has_error)
+            ImGui::TextUnformatted(Data::frame_scratch.Str(info.step_count));
+        ImGui::NextColumn();
+        if (!has_error)
+            ImGui::TextUnformatted(Data::frame_scratch.Str(info.images.size()));
+        ImGui::NextColumn();
+    }
+
+    ImGui::Columns(1);
+    if (filtered_templates.empty() && Data::template_index.IsReady())
+        ImGui::TextDisabled("%s", templates.empty() ? "Шаблонов нет" : "Ничего не найдено");
+    ImGui::EndChild();
+
+    bool have_selection = false;
+    for (int index : filtered_templates)
+    {
+        if (templates[index].path == selected_path)
+        {
+            have_selection = true;
+            break;
+        }
+    }
+
+    if ((ImGui::Button("Открыть шаблон") || double_clicked) && have_selection)
+        result.action = Action::open_template;
+    ImGui::SameLine();
+    if (ImGui::Button("Новый отчет на основе шаблона") && have_selection)
+        result.action = Action::make_report;
+
+    ImGui::SameLine();
+    const std::string text_close = "Закрыть";
+    int close_button_width = ImGui::CalcTextSize(text_close.c_str()).x + ImGui::GetStyle().FramePadding.x * 2;
+    ImGui::SetCursorPosX(ImGui::GetCursorPos().x + ImGui::GetContentRegionAvail().x - close_button_width);
+    if (ImGui::Button(text_close.c_str()) || Input::Button(Input::escape).pressed() || result.action != Action::none)
+        ImGui::CloseCurrentPopup();
+
+    if (result.action != Action::none)
+        result.path = selected_path;
+
+    ImGui::EndPopup();
+    return result;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "main/template_index.h"
+
+namespace GuiElements
+{
+    // Lists the templates from `Data::template_index`, with a search field.
+    class TemplateBrowser
+    {
+      public:
+        enum class Action {none, open_template, make_report};
+
+        struct Result
+        {
+            Action action = Action::none;
+            std::filesystem::path path; // Relative to the template directory.
+        };
+
+      private:
+        static constexpr const char *modal_name = "template_browser_modal";
+        bool open_requested = false;
+
+        std::uint64_t generation = -1; // The index generation `templates` was copied at.
+        std::vector<Data::TemplateInfo> templates;
+        std::vector<std::string> search_names; // `name` and `path` of each template, converted with `LowercaseForSearch()`.
+
+        std::string filter;
+        bool filter_changed = true;
+        std::vector<int> filtered_templates; // Indices of the templates matching `filter`.
+
+        std::string selected_path; // `TemplateInfo::path` of the selected template, if any.
+
+        void UpdateTemplates();
+
+      public:
+        void Open()
+        {
+            open_requested = true;
+        }
+
+        // Returns the action chosen by the user, if any.
+        [[nodiscard]] Result Display();
+    };
+}
@@ -0,0 +1,421 @@
+#include "template_history.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+#include "main/options.h"
+#include "program/errors.h"
+
+namespace Data
+{
+    const TemplateHistory::Snapshot &TemplateHistory::Current() const
+    {
+        return pending ? *pending : entries[position];
+    }
+
+    TemplateHistory::Snapshot &TemplateHistory::Pending()
+    {
+        if (!pending)
+        {
+            pending = entries[position];
+            pending->bytes = 0;
+        }
+        return *pending;
+    }
+
+    TemplateHistory::StepNode &TemplateHistory::MutableStep(int step)
+    {
+        std::shared_ptr<StepNode> &node = Pending().steps[step];
+        // Only `pending` can own the node at this point, unless it's shared with the committed snapshots.
+        if (node.use_count() > 1)
+        {
+            node = std::make_shared<StepNode>(*node);
+            pending->bytes += sizeof(StepNode) + node->name.size();
+        }
+        return *node;
+    }
+
+    TemplateHistory::WidgetList &TemplateHistory::MutableWidgets(int step)
+    {
+        StepNode &node = MutableStep(step);
+        DebugAssert("The widget list must be captured before changing it.", node.widgets->captured);
+        if (node.widgets.use_count() > 1)
+        {
+            node.widgets = std::make_shared<WidgetList>(*node.widgets);
+            pending->bytes += sizeof(WidgetList) + node.widgets->widgets.size() * sizeof(node.widgets->widgets[0]);
+        }
+        return *node.widgets;
+    }
+
+    std::shared_ptr<const TemplateHistory::ProcedureInfo> TemplateHistory::MakeInfo(const Procedure &proc)
+    {
+        auto ret = std::make_shared<ProcedureInfo>();
+        ret->name = proc.name;
+        ret->confirm_exit = proc.confirm_exit;
+        ret->libraries = Refl::ToBinary<std::vector<unsigned char>>(proc.libraries);
+        return ret;
+    }
+
+    std::shared_ptr<const TemplateHistory::WidgetData> TemplateHistory::MakeWidgetData(const Widgets::Widget &widget)
+    {
+        return std::make_shared<const WidgetData>(Refl::ToBinary<WidgetData>(widget));
+    }
+
+    Widgets::Widget TemplateHistory::LoadWidget(const WidgetData &data)
+    {
+        return Refl::FromBinary<Widgets::Widget>(Stream::ReadOnlyData::mem_reference(data));
+    }
+
+    void TemplateHistory::Capture(const Procedure &proc, int step)
+    {
+        WidgetList &list = *Current().steps[step]->widgets;
+        if (list.captured)
+            return;
+
+        std::size_t bytes = 0;
+        list.widgets.reserve(proc.steps[step].widgets.size());
+        for (const Widgets::Widget &widget : proc.steps[step].widgets)
+        {
+            bytes += list.widgets.emplace_back(MakeWidgetData(widget))->size() + sizeof(WidgetData);
+        }
+        list.captured = true;
+        list.lazy.reset();
+
+        // The list is shared by several snapshots, so we don't know which one it should be attributed to. The current one is good enough.
+        entries[position].bytes += bytes;
+        total_bytes += bytes;
+    }
+
+    void TemplateHistory::Flush(const Procedure &proc)
+    {
+        if (dirty_info)
+        {
+            dirty_info = false;
+
+            std::shared_ptr<const ProcedureInfo> info = MakeInfo(proc);
+            const ProcedureInfo &old_info = *Current().info;
+            if (info->name != old_info.name || info->confirm_exit != old_info.confirm_exit || info->libraries != old_info.libraries)
+            {
+                Pending().info = std::move(info);
+                pending->bytes += sizeof(ProcedureInfo) + proc.name.size() + pending->info->libraries.size();
+                pending_changed = true;
+            }
+        }
+
+        for (int step : dirty_steps)
+        {
+            const ProcedureStep &proc_step = proc.steps[step];
+            const StepNode &node = *Current().steps[step];
+            if (proc_step.name == node.name && proc_step.confirm == node.confirm)
+                continue;
+
+            StepNode &new_node = MutableStep(step);
+            new_node.name = proc_step.name;
+            new_node.confirm = proc_step.confirm;
+            pending_changed = true;
+        }
+        dirty_steps.clear();
+
+        for (auto [step, widget] : dirty_widgets)
+        {
+            std::shared_ptr<const WidgetData> data = MakeWidgetData(proc.steps[step].widgets[widget]);
+            if (*data == *Current().steps[step]->widgets->widgets[widget])
+                continue; // The user has clicked something without changing it.
+
+            WidgetList &list = MutableWidgets(step);
+            pending->bytes += data->size() + sizeof(WidgetData);
+            list.widgets[widget] = std::move(data);
+            pending_changed = true;
+        }
+        dirty_widgets.clear();
+    }
+
+    void TemplateHistory::Restore(Procedure &proc, const Snapshot &from, const Snapshot &to)
+    {
+        if (to.info != from.info)
+        {
+            proc.name = to.info->name;
+            proc.confirm_exit = to.info->confirm_exit;
+            proc.libraries = Refl::FromBinary<std::vector<Library>>(Stream::ReadOnlyData::mem_reference(to.info->libraries));
+        }
+
+        std::unordered_map<std::uint64_t, int> from_indices;
+        for (std::size_t i = 0; i < from.steps.size(); i++)
+            from_indices.try_emplace(from.steps[i]->id, i);
+
+        std::vector<ProcedureStep> steps;
+        steps.reserve(to.steps.size());
+
+        for (const std::shared_ptr<StepNode> &node : to.steps)
+        {
+            const WidgetList &list = *node->widgets;
+
+            auto it = from_indices.find(node->id);
+            if (it == from_indices.end())
+            {
+                // The step was removed, so we have to make it again.
+                ProcedureStep &step = steps.emplace_back();
+                step.name = node->name;
+                step.confirm = node->confirm;
+
+                if (list.captured)
+                {
+                    step.widgets.reserve(list.widgets.size());
+                    for (const auto &data : list.widgets)
+                        step.widgets.push_back(LoadWidget(*data));
+                }
+                else
+                {
+                    // Removing a step captures it, unless it can be loaded again from the source.
+                    DebugAssert("An uncaptured removed step must be lazy.", bool(list.lazy));
+                    step.lazy = list.lazy;
+                    step.lazy->loaded = false;
+                    step.lazy->initialized = false;
+                    step.lazy->modified = false;
+                }
+                continue;
+            }
+
+            const StepNode &old_node = *from.steps[it->second];
+            ProcedureStep &step = steps.emplace_back(std::move(proc.steps[it->second]));
+            step.name = node->name;
+            step.confirm = node->confirm;
+
+            if (node->widgets == old_node.widgets)
+                continue;
+
+            // If the lists are different, both of them were captured before one of them was made.
+            const WidgetList &old_list = *old_node.widgets;
+            bool old_widgets_loaded = !step.lazy || step.lazy->loaded;
+
+            std::unordered_map<const WidgetData *, int> old_indices;
+            if (old_widgets_loaded)
+            {
+                for (std::size_t i = 0; i < old_list.widgets.size(); i++)
+                    old_indices.try_emplace(old_list.widgets[i].get(), i);
+            }
+
+            std::vector<Widgets::Widget> widgets;
+            widgets.reserve(list.widgets.size());
+            for (const auto &data : list.widgets)
+            {
+                if (auto old_it = old_indices.find(data.get()); old_it != old_indices.end())
+                    widgets.push_back(std::move(step.widgets[old_it->second]));
+                else
+                    widgets.push_back(LoadWidget(*data));
+            }
+            step.widgets = std::move(widgets);
+
+            if (step.lazy)
+            {
+                // The widgets no longer match the source, so they must stay loaded.
+                step.lazy->loaded = true;
+                step.lazy->initialized = false;
+                step.lazy->modified = true;
+            }
+        }
+
+        proc.steps = std::move(steps);
+    }
+
+    void TemplateHistory::Reset(const Procedure &proc)
+    {
+        entries.clear();
+        position = 0;
+        pending.reset();
+        pending_changed = false;
+        dirty_info = false;
+        dirty_steps.clear();
+        dirty_widgets.clear();
+
+        Snapshot &snapshot = entries.emplace_back();
+        snapshot.info = MakeInfo(proc);
+        snapshot.steps.reserve(proc.steps.size());
+        for (const ProcedureStep &step : proc.steps)
+        {
+            auto node = std::make_shared<StepNode>();
+            node->id = ++step_id_counter;
+            node->name = step.name;
+            node->confirm = step.confirm;
+            node->widgets = std::make_shared<WidgetList>();
+            node->widgets->lazy = step.lazy;
+            snapshot.steps.push_back(std::move(node));
+            snapshot.bytes += sizeof(StepNode) + sizeof(WidgetList) + step.name.size();
+        }
+        total_bytes = snapshot.bytes;
+    }
+
+    void TemplateHistory::BeginEditingStep(const Procedure &proc, int step)
+    {
+        Capture(proc, step);
+    }
+
+    void TemplateHistory::ProcedureChanged()
+    {
+        dirty_info = true;
+    }
+
+    void TemplateHistory::StepChanged(int step)
+    {
+        if (std::find(dirty_steps.begin(), dirty_steps.end(), step) == dirty_steps.end())
+            dirty_steps.push_back(step);
+    }
+
+    void TemplateHistory::WidgetChanged(int step, int widget)
+    {
+        if (std::find(dirty_widgets.begin(), dirty_widgets.end(), std::pair(step, widget)) == dirty_widgets.end())
+            dirty_widgets.emplace_back(step, widget);
+    }
+
+    void TemplateHistory::InsertStep(Procedure &proc, int step)
+    {
+        Flush(proc); // The dirty indices must be flushed before they're invalidated.
+
+        auto node = std::make_shared<StepNode>();
+        node->id = ++step_id_counter;
+        node->widgets = std::make_shared<WidgetList>();
+        node->widgets->captured = true;
+
+        Snapshot &snapshot = Pending();
+        snapshot.steps.insert(snapshot.steps.begin() + step, std::move(node));
+        snapshot.bytes += sizeof(StepNode) + sizeof(WidgetList);
+        pending_changed = true;
+
+        proc.steps.emplace(proc.steps.begin() + step);
+    }
+
+    void TemplateHistory::EraseStep(Procedure &proc, int step)
+    {
+        Flush(proc);
+
+        // Lazy steps that weren't edited can be loaded again from the source, so we don't need to copy them.
+        if (!Current().steps[step]->widgets->lazy)
+            Capture(proc, step);
+
+        Snapshot &snapshot = Pending();
+        snapshot.steps.erase(snapshot.steps.begin() + step);
+        pending_changed = true;
+
+        proc.steps.erase(proc.steps.begin() + step);
+    }
+
+    void TemplateHistory::SwapSteps(Procedure &proc, int step)
+    {
+        Flush(proc);
+
+        Snapshot &snapshot = Pending();
+        std::swap(snapshot.steps[step], snapshot.steps[step+1]);
+        pending_changed = true;
+
+        std::swap(proc.steps[step], proc.steps[step+1]);
+    }
+
+    void TemplateHistory::InsertWidget(Procedure &proc, int step, int widget, Widgets::Widget new_widget)
+    {
+        Flush(proc);
+        Capture(proc, step);
+
+        std::shared_ptr<const WidgetData> data = MakeWidgetData(new_widget);
+        WidgetList &list = MutableWidgets(step);
+        pending->bytes += data->size() + sizeof(WidgetData);
+        list.widgets.insert(list.widgets.begin() + widget, std::move(data));
+        pending_changed = true;
+
+        std::vector<Widgets::Widget> &widgets = proc.steps[step].widgets;
+        widgets.insert(widgets.begin() + widget, std::move(new_widget));
+    }
+
+    void TemplateHistory::EraseWidget(Procedure &proc, int step, int widget)
+    {
+        Flush(proc);
+        Capture(proc, step);
+
+        WidgetList &list = MutableWidgets(step);
+        list.widgets.erase(list.widgets.begin() + widget);
+        pending_changed = true;
+
+        std::vector<Widgets::Widget> &widgets = proc.steps[step].widgets;
+        widgets.erase(widgets.begin() + widget);
+    }
+
+    void TemplateHistory::SwapWidgets(Procedure &proc, int step, int widget)
+    {
+        Flush(proc);
+        Capture(proc, step);
+
+        WidgetList &list = MutableWidgets(step);
+        std::swap(list.widgets[widget], list.widgets[widget+1]);
+        pending_changed = true;
+
+        std::vector<Widgets::Widget> &widgets = proc.steps[step].widgets;
+        std::swap(widgets[widget], widgets[widget+1]);
+    }
+
+    void TemplateHistory::Commit(const Procedure &proc, int visible_step)
+    {
+        Flush(proc);
+
+        if (!pending_changed)
+        {
+            pending.reset();
+            return;
+        }
+
+        // A new change makes the undone changes unreachable.
+        while (entries.size() > position + 1)
+        {
+            total_bytes -= entries.back().bytes;
+            entries.pop_back();
+        }
+
+        pending->visible_step = visible_step;
+        pending->bytes += sizeof(Snapshot) + pending->steps.size() * sizeof(pending->steps[0]);
+        total_bytes += pending->bytes;
+        entries.push_back(std::move(*pending));
+        position++;
+        pending.reset();
+        pending_changed = false;
+
+        // Forget the oldest entries. The nodes they share with the newer entries are kept alive by those.
+        while (position > 0 && (entries.size() > Options::UndoHistory::max_entries || total_bytes > Options::UndoHistory::max_bytes))
+        {
+            total_bytes -= entries.front().bytes;
+            entries.pop_front();
+            position--;
+        }
+    }
+
+    bool TemplateHistory::CanUndo() const
+    {
+        return position > 0 || pending_changed || dirty_info || dirty_steps.size() > 0 || dirty_widgets.size() > 0;
+    }
+
+    bool TemplateHistory::CanRedo() const
+    {
+        return position + 1 < entries.size();
+    }
+
+    bool TemplateHistory::Undo(Procedure &proc, int &visible_step)
+    {
+        Commit(proc, visible_step);
+        if (position == 0)
+            return false;
+
+        Restore(proc, entries[position], entries[position-1]);
+        visible_step = entries[position].visible_step;
+        position--;
+        return true;
+    }
+
+    bool TemplateHistory::Redo(Procedure &proc, int &visible_step)
+    {
+        Commit(proc, visible_step);
+        if (position + 1 >= entries.size())
+            return false;
+
+        position++;
+        Restore(proc, entries[position-1], entries[position]);
+        visible_step = entries[position].visible_step;
+        return true;
+    }
+}
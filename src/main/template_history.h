@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "main/procedure_data.h"
+#include "main/widgets.h"
+
+namespace Data
+{
+    // Undo/redo history for the template editor.
+    // Snapshots share structure: a snapshot is a list of pointers to immutable steps, and each step points to an immutable list of
+    // immutable widgets (stored in the binary form). An edit copies only the changed widgets and the nodes leading to them, plus one pointer per step,
+    // and undoing it deserializes only those widgets. Unchanged widgets are moved between the procedure and the restored steps.
+    // The widgets of a step are copied into the history once, when the step is opened in the editor (see `BeginEditingStep()`).
+    // The oldest entries are forgotten when the history exceeds `Options::UndoHistory` limits.
+    //
+    // The editor reports the changes with `...Changed()`, performs structural changes (adding, removing, moving steps and widgets) through this class,
+    // and calls `Commit()` when the user is done with the change (e.g. when a text field loses focus). All changes between two commits are undone at once.
+    class TemplateHistory
+    {
+        using WidgetData = std::vector<unsigned char>; // A widget serialized with `Refl::ToBinary()`.
+
+        struct WidgetList
+        {
+            // If false, `widgets` is empty, and the real widgets are in the procedure. This is fine as long as they weren't changed.
+            // Uncaptured lists are captured in place before the first change, which is the only time a list is modified after it's created.
+            bool captured = false;
+            std::vector<std::shared_ptr<const WidgetData>> widgets;
+            std::optional<LazyStepState> lazy; // For uncaptured lazily loaded steps, this allows loading the step again after it was removed.
+        };
+
+        struct StepNode
+        {
+            std::uint64_t id = 0; // Persists through renames and edits, to match the restored steps with the existing ones.
+            std::string name;
+            bool confirm = false;
+            std::shared_ptr<WidgetList> widgets;
+        };
+
+        struct ProcedureInfo
+        {
+            std::string name;
+            bool confirm_exit = false;
+            std::vector<unsigned char> libraries; // Serialized with `Refl::ToBinary()`, which also makes them easy to compare.
+        };
+
+        struct Snapshot
+        {
+            std::shared_ptr<const ProcedureInfo> info;
+            std::vector<std::shared_ptr<StepNode>> steps; // Same order as in the procedure. The nodes are only modified while they belong to `pending` alone.
+            int visible_step = 0; // Where the change was made, to show it after undoing or redoing it.
+            std::size_t bytes = 0; // Approximately how much memory was allocated for this snapshot.
+        };
+
+        std::deque<Snapshot> entries; // `entries[position]` is the current state, the following entries can be redone.
+        std::size_t position = 0;
+        std::size_t total_bytes = 0;
+        std::uint64_t step_id_counter = 0;
+
+        std::optional<Snapshot> pending; // Uncommitted changes, starts as a copy of `entries[position]`.
+        bool pending_changed = false; // If `pending` differs from `entries[position]`.
+        bool dirty_info = false; // If the procedure name, flags or libraries could've changed.
+        std::vector<int> dirty_steps; // Steps whose names or flags could've changed.
+        std::vector<std::pair<int, int>> dirty_widgets; // Step and widget indices of the widgets that could've changed.
+
+        [[nodiscard]] const Snapshot &Current() const;
+        Snapshot &Pending();
+        StepNode &MutableStep(int step);
+        WidgetList &MutableWidgets(int step);
+
+        [[nodiscard]] static std::shared_ptr<const ProcedureInfo> MakeInfo(const Procedure &proc);
+        [[nodiscard]] static std::shared_ptr<const WidgetData> MakeWidgetData(const Widgets::Widget &widget);
+        [[nodiscard]] static Widgets::Widget LoadWidget(const WidgetData &data);
+
+        // Copies the widgets of a step into the history, if they weren't copied yet.
+        void Capture(const Procedure &proc, int step);
+        // Moves the dirty objects into `pending`, if they have actually changed.
+        void Flush(const Procedure &proc);
+        // Changes `proc` from state `from` to state `to`.
+        static void Restore(Procedure &proc, const Snapshot &from, const Snapshot &to);
+
+      public:
+        // Starts a new history for the procedure. Call this after loading it.
+        void Reset(const Procedure &proc);
+
+        // Call this before showing the editor for a step, so that its current widgets can be restored later.
+        void BeginEditingStep(const Procedure &proc, int step);
+
+        // Notify the history about changes.
+        void ProcedureChanged(); // The procedure name, flags or libraries.
+        void StepChanged(int step); // The step name or flags.
+        void WidgetChanged(int step, int widget); // Anything inside a widget.
+
+        // Those change the procedure and record the change. The indices must be valid.
+        void InsertStep(Procedure &proc, int step);
+        void EraseStep(Procedure &proc, int step);
+        void SwapSteps(Procedure &proc, int step); // Swaps `step` and `step+1`.
+        void InsertWidget(Procedure &proc, int step, int widget, Widgets::Widget new_widget);
+        void EraseWidget(Procedure &proc, int step, int widget);
+        void SwapWidgets(Procedure &proc, int step, int widget); // Swaps `widget` and `widget+1`.
+
+        // Makes a history entry from the changes made since the last commit, if any.
+        void Commit(const Procedure &proc, int visible_step);
+
+        [[nodiscard]] bool CanUndo() const;
+        [[nodiscard]] bool CanRedo() const;
+
+        // Those commit the pending changes first. Return false if there's nothing to undo or redo.
+        // On success, `visible_step` is set to the step that was changed. It's not necessarily a valid index.
+        bool Undo(Procedure &proc, int &visible_step);
+        bool Redo(Procedure &proc, int &visible_step);
+    };
+}
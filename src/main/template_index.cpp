@@ -0,0 +1,532 @@
+#include "program/platform.h"
+
+#include "template_index.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <optional>
+#include <set>
+#include <system_error>
+#include <utility>
+
+#if PLATFORM_IS(linux)
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include "interface/window.h"
+#include "main/options.h"
+#include "main/procedure_data.h"
+#include "main/procedure_file.h"
+#include "program/errors.h"
+#include "stream/input.h"
+#include "stream/output.h"
+#include "stream/readonly_data.h"
+#include "stream/replace_file.h"
+#include "utils/filesystem.h"
+
+namespace fs = std::filesystem;
+
+namespace Data
+{
+    namespace
+    {
+        // The index file starts with the signature and a little-endian `uint16_t` version,
+        // followed by `std::vector<TemplateInfo>` serialized with `Refl::ToBinary()`.
+        constexpr char signature[] = {'M','F','T','I','N','D','E','X'};
+        constexpr std::uint16_t current_version = 1;
+
+        std::string JoinPath(const std::string &dir, const std::string &name)
+        {
+            return dir.empty() ? name : dir + '/' + name;
+        }
+
+        // Returns true if `path` is `dir` itself or is located inside of it.
+        bool IsInDirectory(const std::string &path, const std::string &dir)
+        {
+            if (dir.empty())
+                return true;
+            return path.compare(0, dir.size(), dir) == 0 && (path.size() == dir.size() || path[dir.size()] == '/');
+        }
+
+        bool IsTemplateFileName(const std::string &name)
+        {
+            return fs::path(name).extension() == Options::template_extension;
+        }
+
+        // Parses a template. Returns null if the file doesn't exist. If the file can't be parsed, sets `TemplateInfo::error`.
+        // If `old_info` is not null and the file hasn't changed since it was made, returns it without parsing the file.
+        std::optional<TemplateInfo> ReadTemplate(const fs::path &directory, const std::string &relative_path, const TemplateInfo *old_info)
+        {
+            fs::path path = directory / relative_path;
+
+            std::error_code error;
+            if (!fs::is_regular_file(path, error))
+                return {};
+
+            TemplateInfo info;
+            info.path = relative_path;
+            info.modification_time = fs::last_write_time(path, error).time_since_epoch().count();
+            if (!error)
+                info.file_size = fs::file_size(path, error);
+            if (error)
+                return {};
+
+            if (old_info && old_info->modification_time == info.modification_time && old_info->file_size == info.file_size)
+                return *old_info;
+
+            try
+            {
+                Procedure proc = ProcedureFile::Read(Stream::ReadOnlyData::file(path.string()));
+                if (!proc.IsTemplate())
+                    Program::Error("This is a report, not a template.");
+
+                info.name = std::move(proc.name);
+                info.step_count = proc.steps.size();
+
+                for (const Library &lib : proc.libraries)
+                    info.libraries.push_back(lib.file);
+
+                for (const ProcedureStep &step : proc.steps)
+                {
+                    for (const Widgets::Widget &widget : step.widgets)
+                        widget->ListImageFiles(info.images);
+                }
+
+                // The same image is often used by several steps.
+                std::sort(info.images.begin(), info.images.end());
+                info.images.erase(std::unique(info.images.begin(), info.images.end()), info.images.end());
+            }
+            catch (std::exception &e)
+            {
+                info.name.clear();
+                info.step_count = 0;
+                info.images.clear();
+                info.libraries.clear();
+                info.error = e.what();
+            }
+
+            return info;
+        }
+    }
+
+    TemplateIndex::~TemplateIndex()
+    {
+        if (!thread.joinable())
+            return;
+
+        {
+            std::lock_guard lock(mutex);
+            stop_requested = true;
+        }
+        cond_var.notify_all();
+
+        #if PLATFORM_IS(linux)
+        char byte = 0;
+        (void)!write(stop_pipe[1], &byte, 1);
+        #endif
+
+        thread.join();
+
+        #if PLATFORM_IS(linux)
+        close(stop_pipe[0]);
+        close(stop_pipe[1]);
+        #endif
+    }
+
+    void TemplateIndex::Open(fs::path new_directory, fs::path new_index_file)
+    {
+        if (thread.joinable())
+            Program::Error("The template index is already open.");
+
+        directory = std::move(new_directory);
+        index_file = std::move(new_index_file);
+
+        #if PLATFORM_IS(linux)
+        if (pipe2(stop_pipe, O_CLOEXEC))
+            Program::Error("Unable to create a pipe for the template index.");
+        #endif
+
+        thread = std::thread([this]{ThreadFunc();});
+    }
+
+    std::uint64_t TemplateIndex::Generation()
+    {
+        std::lock_guard lock(mutex);
+        return generation;
+    }
+
+    bool TemplateIndex::IsReady()
+    {
+        std::lock_guard lock(mutex);
+        return ready;
+    }
+
+    std::vector<TemplateInfo> TemplateIndex::Templates()
+    {
+        std::lock_guard lock(mutex);
+        std::vector<TemplateInfo> ret;
+        ret.reserve(templates.size());
+        for (const auto &[path, info] : templates)
+            ret.push_back(info);
+        return ret;
+    }
+
+    fs::path TemplateIndex::DirectoryPath(const std::string &dir) const
+    {
+        // Appending an empty path would add a trailing slash, which confuses `lexically_relative()`.
+        return dir.empty() ? directory : directory / dir;
+    }
+
+    bool TemplateIndex::StopRequested()
+    {
+        std::lock_guard lock(mutex);
+        return stop_requested;
+    }
+
+    void TemplateIndex::UpdateTemplate(const std::string &path)
+    {
+        // Only this thread modifies `templates`, so we can read it without locking.
+        auto it = templates.find(path);
+        const TemplateInfo *old_info = it == templates.end() ? nullptr : &it->second;
+
+        std::optional<TemplateInfo> info = ReadTemplate(directory, path, old_info);
+        if (!info && !old_info)
+            return;
+        if (info && old_info && info->modification_time == old_info->modification_time && info->file_size == old_info->file_size)
+            return; // Unchanged.
+
+        {
+            std::lock_guard lock(mutex);
+            if (info)
+                templates[path] = std::move(*info);
+            else
+                templates.erase(path);
+            generation++;
+        }
+
+        unsaved_changes = true;
+    }
+
+    bool TemplateIndex::ScanDirectory(const std::string &dir, std::vector<std::string> *subdirectories)
+    {
+        bool ok = true;
+        Filesystem::TreeNode tree = Filesystem::GetObjectTree(DirectoryPath(dir).string(), Options::TemplateIndex::max_depth, &ok);
+        if (!ok || tree.info.category != Filesystem::directory)
+        {
+            ForgetDirectory(dir);
+            return false;
+        }
+
+        std::set<std::string> found;
+
+        Filesystem::ForEachObject(tree, [&](const Filesystem::TreeNode &node)
+        {
+            std::string path = fs::path(node.path).lexically_relative(directory).generic_string();
+            if (path == ".")
+                path.clear();
+
+            if (node.info.category == Filesystem::directory)
+            {
+                if (subdirectories)
+                    subdirectories->push_back(path);
+            }
+            else if (node.info.category == Filesystem::file && IsTemplateFileName(node.name))
+            {
+                found.insert(path);
+            }
+        });
+
+        // Forget the templates that were removed.
+        std::vector<std::string> removed;
+        for (const auto &[path, info] : templates)
+        {
+            if (IsInDirectory(path, dir) && found.count(path) == 0)
+                removed.push_back(path);
+        }
+        for (const std::string &path : removed)
+            UpdateTemplate(path);
+
+        for (const std::string &path : found)
+        {
+            if (StopRequested())
+                break;
+            UpdateTemplate(path);
+        }
+
+        return true;
+    }
+
+    void TemplateIndex::ForgetDirectory(const std::string &dir)
+    {
+        std::lock_guard lock(mutex);
+        for (auto it = templates.begin(); it != templates.end();)
+        {
+            if (IsInDirectory(it->first, dir))
+            {
+                it = templates.erase(it);
+                generation++;
+                unsaved_changes = true;
+            }
+            else
+            {
+                it++;
+            }
+        }
+    }
+
+    void TemplateIndex::LoadIndexFile()
+    {
+        std::error_code error;
+        if (!fs::is_regular_file(index_file, error))
+            return;
+
+        std::vector<TemplateInfo> list;
+        try
+        {
+            Stream::ReadOnlyData data = Stream::ReadOnlyData::file(index_file.string());
+            Stream::Input input(data);
+
+            char file_signature[sizeof signature];
+            input.ReadLittle<char>(file_signature, sizeof signature);
+            if (std::memcmp(file_signature, signature, sizeof signature) != 0 || input.ReadLittle<std::uint16_t>() != current_version)
+                return; // The index will be rebuilt from scratch.
+
+            Refl::FromBinary(list, input);
+        }
+        catch (std::exception &)
+        {
+            return; // Same.
+        }
+
+        std::lock_guard lock(mutex);
+        for (TemplateInfo &info : list)
+        {
+            std::string path = info.path;
+            templates.try_emplace(std::move(path), std::move(info));
+        }
+        generation++;
+    }
+
+    void TemplateIndex::SaveIndexFile()
+    {
+        if (!unsaved_changes)
+            return;
+        unsaved_changes = false;
+
+        std::vector<TemplateInfo> list;
+        list.reserve(templates.size());
+        for (const auto &[path, info] : templates)
+            list.push_back(info);
+
+        // Since the index can always be rebuilt, the errors are ignored.
+        try
+        {
+            std::error_code error;
+            fs::create_directories(index_file.parent_path(), error);
+
+            Stream::ReplaceFile(index_file, [&](Stream::Output &output)
+            {
+                output.WriteBytes(signature, sizeof signature);
+                output.WriteLittle<std::uint16_t>(current_version);
+                Refl::ToBinary(list, output);
+            });
+        }
+        catch (std::exception &) {}
+    }
+
+    void TemplateIndex::ThreadFunc()
+    {
+        LoadIndexFile();
+        Interface::Window::WakeUp();
+
+        #if PLATFORM_IS(linux)
+        constexpr std::uint32_t watch_mask = IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR;
+
+        int inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        FINALLY( if (inotify_fd != -1) close(inotify_fd); )
+
+        std::map<int, std::string> watched_dirs; // Maps watch descriptors to the directories.
+
+        auto Watch = [&](const std::string &dir)
+        {
+            int wd = inotify_add_watch(inotify_fd, DirectoryPath(dir).c_str(), watch_mask);
+            if (wd == -1)
+                return false;
+            watched_dirs[wd] = dir;
+            return true;
+        };
+
+        auto Unwatch = [&](const std::string &dir)
+        {
+            for (auto it = watched_dirs.begin(); it != watched_dirs.end();)
+            {
+                if (IsInDirectory(it->second, dir))
+                {
+                    inotify_rm_watch(inotify_fd, it->first);
+                    it = watched_dirs.erase(it);
+                }
+                else
+                {
+                    it++;
+                }
+            }
+        };
+
+        // Watches a directory and its subdirectories, and indexes their contents.
+        // We start watching before scanning, so that the changes made during the scan aren't lost.
+        // Returns false if some of the directories can't be watched.
+        auto WatchAndScan = [&](const std::string &dir)
+        {
+            bool ok = Watch(dir);
+            std::vector<std::string> subdirectories;
+            if (!ScanDirectory(dir, &subdirectories))
+                return false;
+            for (const std::string &subdirectory : subdirectories)
+            {
+                if (subdirectory != dir)
+                    ok &= Watch(subdirectory);
+            }
+            return ok;
+        };
+
+        alignas(inotify_event) char buffer[4096];
+        std::set<std::string> changed_templates;
+
+        bool need_full_scan = true;
+        bool watching = false; // If false, we rescan periodically.
+
+        while (1)
+        {
+            if (need_full_scan)
+            {
+                need_full_scan = false;
+                Unwatch("");
+                if (inotify_fd != -1)
+                {
+                    watching = WatchAndScan("");
+                }
+                else
+                {
+                    ScanDirectory("", nullptr);
+                    watching = false;
+                }
+
+                SaveIndexFile();
+                if (StopRequested())
+                    return; // The scan could be interrupted.
+                {
+                    std::lock_guard lock(mutex);
+                    ready = true;
+                    generation++;
+                }
+                Interface::Window::WakeUp();
+            }
+
+            pollfd fds[2] = {{stop_pipe[0], POLLIN, 0}, {inotify_fd, POLLIN, 0}};
+            int poll_result = poll(fds, inotify_fd != -1 ? 2 : 1, watching ? -1 : int(Options::TemplateIndex::rescan_interval * 1000));
+            if (StopRequested())
+                return;
+            if (poll_result == 0)
+            {
+                need_full_scan = true;
+                continue;
+            }
+            if (poll_result < 0 || !(fds[1].revents & POLLIN))
+                continue;
+
+            // Read all pending events, coalescing the repeated changes of the same files.
+            while (1)
+            {
+                ssize_t bytes = read(inotify_fd, buffer, sizeof buffer);
+                if (bytes <= 0)
+                    break;
+
+                for (char *ptr = buffer; ptr < buffer + bytes;)
+                {
+                    const inotify_event &event = *reinterpret_cast<const inotify_event *>(ptr);
+                    ptr += sizeof(inotify_event) + event.len;
+
+                    if (event.mask & IN_Q_OVERFLOW)
+                    {
+                        need_full_scan = true; // We lost some events.
+                        continue;
+                    }
+
+                    auto dir_it = watched_dirs.find(event.wd);
+                    if (dir_it == watched_dirs.end())
+                        continue;
+
+                    if (event.mask & IN_IGNORED)
+                    {
+                        // The directory was removed. If it's the root one, we can't watch it anymore.
+                        if (dir_it->second.empty())
+                            need_full_scan = true;
+                        watched_dirs.erase(dir_it);
+                        continue;
+                    }
+
+                    if (event.len == 0)
+                        continue;
+
+                    std::string path = JoinPath(dir_it->second, event.name);
+
+                    if (event.mask & IN_ISDIR)
+                    {
+                        if (event.mask & (IN_DELETE | IN_MOVED_FROM))
+                        {
+                            Unwatch(path);
+                            ForgetDirectory(path);
+                        }
+                        else if (event.mask & (IN_CREATE | IN_MOVED_TO))
+                        {
+                            if (!WatchAndScan(path))
+                                need_full_scan = true;
+                        }
+                    }
+                    else if (IsTemplateFileName(event.name) && (event.mask & (IN_CLOSE_WRITE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO)))
+                    {
+                        changed_templates.insert(std::move(path));
+                    }
+                }
+            }
+
+            for (const std::string &path : changed_templates)
+                UpdateTemplate(path);
+            changed_templates.clear();
+
+            if (unsaved_changes)
+            {
+                SaveIndexFile();
+                Interface::Window::WakeUp();
+            }
+        }
+
+        #else
+        while (1)
+        {
+            ScanDirectory("", nullptr);
+
+            bool changed = unsaved_changes;
+            SaveIndexFile();
+            if (StopRequested())
+                return; // The scan could be interrupted.
+            {
+                std::lock_guard lock(mutex);
+                changed |= !ready;
+                ready = true;
+            }
+            if (changed)
+                Interface::Window::WakeUp();
+
+            std::unique_lock lock(mutex);
+            if (cond_var.wait_for(lock, std::chrono::duration<double>(Options::TemplateIndex::rescan_interval), [&]{return stop_requested;}))
+                return;
+        }
+        #endif
+    }
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "reflection/full.h"
+#include "reflection/short_macros.h"
+
+namespace Data
+{
+    // A summary of a single template, see `TemplateIndex`.
+    SIMPLE_STRUCT( TemplateInfo
+        DECL(std::string) path // Relative to the template directory, with forward slashes.
+        DECL(std::string) name
+        DECL(int INIT=0) step_count
+        DECL(std::vector<std::string>) images, libraries // File names, relative to the template directory. Libraries are listed without extensions.
+        DECL(std::int64_t INIT=0) modification_time
+        DECL(std::uint64_t INIT=0) file_size
+        DECL(std::string) error // If the template couldn't be parsed, this is set, and `name`, `step_count`, `images` and `libraries` are empty.
+    )
+
+    // Keeps a summary of every template in a directory (recursively), for the template browser.
+    // The index is built on a background thread, and is saved to a file between runs, so that only the changed templates are parsed again.
+    // On Linux it's kept up to date using inotify. On other platforms the directory is rescanned every `Options::TemplateIndex::rescan_interval` seconds.
+    // If the directory can't be watched (e.g. it doesn't exist yet), it's rescanned with the same interval until it can.
+    // All member functions are thread-safe.
+    class TemplateIndex
+    {
+        std::mutex mutex;
+        std::condition_variable cond_var; // Notified when the index is being destroyed.
+        std::filesystem::path directory, index_file;
+        std::map<std::string, TemplateInfo> templates; // The keys are `TemplateInfo::path`.
+        std::uint64_t generation = 0; // Incremented on every change of `templates`.
+        bool ready = false; // Set after the first full scan.
+        bool stop_requested = false;
+        int stop_pipe[2] = {-1, -1}; // Only used with inotify. Writing to it makes the thread stop waiting for events.
+
+        bool unsaved_changes = false; // Only touched by the thread.
+
+        std::thread thread; // Started by `Open()`.
+
+        void ThreadFunc();
+        [[nodiscard]] bool StopRequested();
+        [[nodiscard]] std::filesystem::path DirectoryPath(const std::string &dir) const;
+
+        // Those are only called by the thread. Paths are relative to `directory`, with forward slashes.
+        // Parses the template again if it has changed, or removes it from the index if it no longer exists.
+        void UpdateTemplate(const std::string &path);
+        // Indexes all templates in a directory, and removes the ones that no longer exist. An empty string means the whole `directory`.
+        // Returns false if the directory can't be accessed. Appends the subdirectories (including `dir` itself) to `subdirectories`, if it's not null.
+        bool ScanDirectory(const std::string &dir, std::vector<std::string> *subdirectories);
+        // Removes all templates in a directory from the index.
+        void ForgetDirectory(const std::string &dir);
+        // Loads the index saved by the previous run, if any.
+        void LoadIndexFile();
+        // Saves the index if it has changed since the last time.
+        void SaveIndexFile();
+
+      public:
+        TemplateIndex() {}
+        TemplateIndex(const TemplateIndex &) = delete;
+        TemplateIndex &operator=(const TemplateIndex &) = delete;
+        ~TemplateIndex();
+
+        // Starts indexing `new_directory` in the background. `new_index_file` is where the index is saved between runs.
+        // Must be called at most once.
+        void Open(std::filesystem::path new_directory, std::filesystem::path new_index_file);
+
+        // Changes every time the list of templates changes. Use it to avoid copying the list every frame.
+        [[nodiscard]] std::uint64_t Generation();
+        // Returns false until the first scan of the directory finishes. Until then, the list can be incomplete or outdated.
+        [[nodiscard]] bool IsReady();
+        // Returns all templates, sorted by path.
+        [[nodiscard]] std::vector<TemplateInfo> Templates();
+    };
+
+    inline TemplateIndex template_index;
+}
@@ -0,0 +1,234 @@
+#include "thumbnail_disk_cache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "main/images.h"
+#include "main/options.h"
+#include "stream/input.h"
+#include "stream/output.h"
+#include "stream/readonly_data.h"
+#include "stream/replace_file.h"
+#include "utils/archive.h"
+#include "utils/hash.h"
+
+namespace fs = std::filesystem;
+
+namespace Data
+{
+    namespace
+    {
+        constexpr char signature[] = {'M','F','T','H','U','M','B','\n'};
+        constexpr std::uint16_t current_version = 2;
+        const std::string file_extension = ".thumb";
+
+        // The file starts with the signature and a little-endian `uint16_t` version.
+        // Then follow (all little-endian) `uint64_t` content hash, `int64_t` source modification time, `uint64_t` source size,
+        // `uint32_t` source path length and the path itself (to detect hash collisions), `uint32_t` width and height, `uint8_t` channel count.
+        // Then follow the pixels, compressed with `Archive::Compress()`.
+
+        void RemoveFiles(const std::vector<fs::path> &files)
+        {
+            std::error_code ignored;
+            for (const fs::path &file : files)
+                fs::remove(file, ignored);
+        }
+    }
+
+    fs::path ThumbnailDiskCache::FilePath(const std::string &source_path, std::int64_t modification_time, std::uintmax_t file_size) const
+    {
+        std::size_t hash = Hash::Compute(source_path, modification_time, file_size, Options::Images::thumbnail_max_size);
+        return directory / "{:016x}{}"_format(std::uint64_t(hash), file_extension);
+    }
+
+    void ThumbnailDiskCache::Open(fs::path new_directory)
+    {
+        std::vector<fs::path> files_to_remove;
+
+        {
+            std::lock_guard lock(mutex);
+
+            std::error_code error;
+            fs::create_directories(new_directory, error);
+            if (error)
+                return; // The cache stays disabled.
+
+            directory = std::move(new_directory);
+            total_size = 0;
+            for (const fs::directory_entry &entry : fs::directory_iterator(directory, error))
+            {
+                std::error_code ignored;
+                if (!entry.is_regular_file(ignored))
+                    continue;
+                if (entry.path().extension() == file_extension)
+                    total_size += entry.file_size(ignored);
+                else if (entry.path().extension() == ".tmp")
+                    files_to_remove.push_back(entry.path()); // Left over if we crashed while writing.
+            }
+
+            if (total_size > Options::Images::disk_cache_max_size)
+            {
+                std::vector<fs::path> pruned = PickFilesToPrune();
+                files_to_remove.insert(files_to_remove.end(), pruned.begin(), pruned.end());
+            }
+        }
+
+        RemoveFiles(files_to_remove);
+    }
+
+    std::optional<ThumbnailDiskCache::Entry> ThumbnailDiskCache::Find(const std::string &source_path, std::int64_t modification_time, std::uintmax_t file_size)
+    {
+        fs::path path;
+        {
+            std::lock_guard lock(mutex);
+            if (directory.empty())
+                return {};
+            path = FilePath(source_path, modification_time, file_size);
+        }
+
+        std::error_code error;
+        if (!fs::is_regular_file(path, error))
+            return {};
+
+        try
+        {
+            Stream::ReadOnlyData data(path.string());
+            Stream::Input input(data);
+
+            char file_signature[sizeof signature];
+            input.ReadLittle<char>(file_signature, sizeof signature);
+            if (std::memcmp(file_signature, signature, sizeof signature) != 0 || input.ReadLittle<std::uint16_t>() != current_version)
+                Program::Error("Not a thumbnail file, or an unsupported version.");
+
+            Entry entry;
+            entry.content_hash = input.ReadLittle<std::uint64_t>();
+            if (input.ReadLittle<std::int64_t>() != modification_time || input.ReadLittle<std::uint64_t>() != file_size)
+                return {}; // A hash collision.
+
+            std::string file_source_path(input.ReadLittle<std::uint32_t>(), '\0');
+            input.ReadLittle<char>(file_source_path.data(), file_source_path.size());
+            if (file_source_path != source_path)
+                return {}; // A hash collision.
+
+            ivec2 size;
+            size.x = input.ReadLittle<std::uint32_t>();
+            size.y = input.ReadLittle<std::uint32_t>();
+            int channels = input.ReadLittle<std::uint8_t>();
+            if ((size <= 0).any() || size.max() > Options::Images::thumbnail_max_size || channels < 1 || channels > 4)
+                Program::Error("Invalid thumbnail size or format.");
+
+            Stream::ReadOnlyData pixels = Stream::ReadOnlyData::mem_reference(data.begin() + input.Position(), data.end()).uncompress();
+            if (pixels.size() != Image::Level::BytesForSize(size, channels))
+                Program::Error("Wrong amount of pixel data.");
+            entry.pixels = Graphics::Image(size, channels, pixels.data());
+
+            // Mark the file as recently used.
+            fs::last_write_time(path, fs::file_time_type::clock::now(), error);
+
+            return entry;
+        }
+        catch (std::exception &)
+        {
+            // The file is corrupted, remove it so that it's written again.
+            fs::remove(path, error);
+            return {};
+        }
+    }
+
+    void ThumbnailDiskCache::Store(const std::string &source_path, std::int64_t modification_time, std::uintmax_t file_size, std::size_t content_hash, const Graphics::Image &pixels)
+    {
+        fs::path path;
+        {
+            std::lock_guard lock(mutex);
+            if (directory.empty())
+                return;
+            path = FilePath(source_path, modification_time, file_size);
+        }
+
+        try
+        {
+            const std::uint8_t *begin = pixels.Data(), *end = begin + pixels.ByteSize();
+            std::vector<std::uint8_t> buffer(Archive::MaxCompressedSize(begin, end));
+            std::uint8_t *buffer_end = Archive::Compress(begin, end, buffer.data(), buffer.data() + buffer.size());
+
+            // Several threads can store the same thumbnail at the same time, so the temporary files need unique names.
+            Stream::ReplaceFile(path, [&](Stream::Output &output)
+            {
+                output.WriteBytes(signature, sizeof signature);
+                output.WriteLittle<std::uint16_t>(current_version);
+                output.WriteLittle<std::uint64_t>(content_hash);
+                output.WriteLittle<std::int64_t>(modification_time);
+                output.WriteLittle<std::uint64_t>(file_size);
+                output.WriteLittle<std::uint32_t>(source_path.size());
+                output.WriteBytes(source_path.data(), source_path.size());
+                output.WriteLittle<std::uint32_t>(pixels.Size().x);
+                output.WriteLittle<std::uint32_t>(pixels.Size().y);
+                output.WriteLittle<std::uint8_t>(pixels.Channels());
+                output.WriteBytes(buffer.data(), buffer_end - buffer.data());
+            }, ".{:x}.tmp"_format(std::uint64_t(Hash::Compute(std::this_thread::get_id()))));
+        }
+        catch (std::exception &)
+        {
+            return;
+        }
+
+        std::error_code error;
+        std::uintmax_t new_file_size = fs::file_size(path, error);
+        if (error)
+            new_file_size = 0; // The next pruning will count it properly.
+
+        std::vector<fs::path> files_to_remove;
+        {
+            std::lock_guard lock(mutex);
+            total_size += new_file_size;
+            if (total_size > Options::Images::disk_cache_max_size)
+                files_to_remove = PickFilesToPrune();
+        }
+        RemoveFiles(files_to_remove);
+    }
+
+    std::vector<fs::path> ThumbnailDiskCache::PickFilesToPrune()
+    {
+        struct File
+        {
+            fs::path path;
+            fs::file_time_type last_use;
+            std::uintmax_t size = 0;
+        };
+
+        std::vector<File> files;
+        total_size = 0;
+
+        std::error_code error;
+        for (const fs::directory_entry &entry : fs::directory_iterator(directory, error))
+        {
+            std::error_code file_error;
+            if (!entry.is_regular_file(file_error) || entry.path().extension() != file_extension)
+                continue;
+
+            File &file = files.emplace_back();
+            file.path = entry.path();
+            file.last_use = entry.last_write_time(file_error);
+            file.size = entry.file_size(file_error);
+            total_size += file.size;
+        }
+
+        std::sort(files.begin(), files.end(), [](const File &a, const File &b){return a.last_use < b.last_use;});
+
+        // Remove more than necessary, so that we don't have to prune again after every new file.
+        std::uintmax_t target_size = Options::Images::disk_cache_max_size * Options::Images::disk_cache_size_after_pruning;
+        std::vector<fs::path> ret;
+        for (File &file : files)
+        {
+            if (total_size <= target_size)
+                break;
+            ret.push_back(std::move(file.path));
+            total_size -= file.size;
+        }
+        return ret;
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "graphics/image.h"
+
+namespace Data
+{
+    // Keeps the decoded and downscaled thumbnails on disk, so that reopening the same images doesn't decode them again.
+    // Each thumbnail is a separate file, named after a hash of the source path, its modification time and size, and the thumbnail size limit.
+    // The files also store the hash of the source contents, so that the textures can still be shared between identical images (see `ImageCache`).
+    // The pixels are compressed with `Archive::Compress()`.
+    // When the total size exceeds `Options::Images::disk_cache_max_size`, the least recently used files are removed.
+    // Reading a file updates its modification time, which is what "least recently used" refers to.
+    // All member functions are thread-safe. Since the cache is only an optimization, the errors are silently ignored.
+    class ThumbnailDiskCache
+    {
+      public:
+        struct Entry
+        {
+            std::size_t content_hash = 0;
+            Graphics::Image pixels;
+        };
+
+      private:
+        std::mutex mutex;
+        std::filesystem::path directory; // If empty, the cache is disabled.
+        std::uintmax_t total_size = 0; // Approximate, since we don't notice the files being changed by someone else.
+
+        [[nodiscard]] std::filesystem::path FilePath(const std::string &source_path, std::int64_t modification_time, std::uintmax_t file_size) const;
+
+        // Returns the least recently used files, removing which puts us well under the limit. The mutex must be locked.
+        // Updates `total_size` as if they were already removed. The caller removes them after unlocking the mutex, since that can be slow.
+        [[nodiscard]] std::vector<std::filesystem::path> PickFilesToPrune();
+
+      public:
+        ThumbnailDiskCache() {}
+        ThumbnailDiskCache(const ThumbnailDiskCache &) = delete;
+        ThumbnailDiskCache &operator=(const ThumbnailDiskCache &) = delete;
+
+        // Enables the cache, creating the directory if necessary. Should be called before any images are loaded.
+        void Open(std::filesystem::path new_directory);
+
+        // Returns the thumbnail of the specified file, if we have one.
+        [[nodiscard]] std::optional<Entry> Find(const std::string &source_path, std::int64_t modification_time, std::uintmax_t file_size);
+
+        // Saves a thumbnail for the specified file.
+        void Store(const std::string &source_path, std::int64_t modification_time, std::uintmax_t file_size, std::size_t content_hash, const Graphics::Image &pixels);
+    };
+
+    inline ThumbnailDiskCache thumbnail_disk_cache;
+}
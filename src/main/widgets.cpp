@@ -3,9 +3,10 @@
 
 #include <imgui.h>
 
-#include "interface/messagebox.h"
 #include "program/errors.h"
 
+#include "main/function_runner.h"
+#include "main/image_cache.h"
 #include "main/images.h"
 #include "main/gui_strings.h"
 #include "main/options.h"
@@ -38,19 +39,21 @@ namespace Widgets
 {
     void InitializeWidgets(Data::Procedure &proc)
     {
-        proc.image_cache.Reset();
-
         try
         {
+            proc.function_table.clear();
+
             for (Data::Library &lib : proc.libraries)
             {
                 constexpr const char *lib_ext = (PLATFORM_IS(windows) ? ".dll" : ".so");
 
-                lib.library = SharedLibrary((proc.resource_dir / (lib.file + lib_ext)).string());
+                // If another tab uses the same library, this doesn't load it again, and the functions are not looked up again.
+                lib.loaded = Data::LoadSharedLibrary(proc.resource_dir / (lib.file + lib_ext));
 
                 for (Data::LibraryFunc &func : lib.functions)
                 {
-                    func.ptr = reinterpret_cast<Data::external_func_ptr_t>(lib.library.GetFunction(func.name));
+                    func.loaded = lib.loaded->GetFunction(func.name);
+                    proc.function_table.try_emplace({lib.id, func.id}, func.loaded); // If the ids are duplicated, the first function wins.
                 }
             }
         }
@@ -59,36 +62,68 @@ namespace Widgets
             Program::Error("While processing shared libraries:\n", e.what());
         }
 
-        int step_index = 0;
-        for (Data::ProcedureStep &step : proc.steps)
+        for (std::size_t i = 0; i < proc.steps.size(); i++)
         {
-            step_index++;
+            Data::ProcedureStep &step = proc.steps[i];
+
+            // Steps that weren't parsed yet will be initialized when they're loaded.
+            if (step.lazy && !step.lazy->loaded)
+                continue;
+
+            InitializeStepWidgets(proc, step, i);
+
+            if (step.lazy)
+                step.lazy->initialized = true;
+        }
+
+        proc.widgets_initialized = true;
+    }
 
-            try
+    void InitializeStepWidgets(const Data::Procedure &proc, Data::ProcedureStep &step, int step_index)
+    {
+        try
+        {
+            int widget_index = 0;
+            for (Widget &w : step.widgets)
             {
-                int widget_index = 0;
-                for (Widget &w : step.widgets)
-                {
-                    widget_index++;
+                widget_index++;
 
-                    try
-                    {
-                        w->Init(proc);
-                    }
-                    catch (std::exception &e)
-                    {
-                        Program::Error("When initializing widget {} `{}`:\n{}"_format(widget_index, Refl::Polymorphic::Name(w), e.what()));
-                    }
+                try
+                {
+                    w->Init(proc);
+                }
+                catch (std::exception &e)
+                {
+                    Program::Error("When initializing widget {} `{}`:\n{}"_format(widget_index, Refl::Polymorphic::Name(w), e.what()));
                 }
-            }
-            catch (std::exception &e)
-            {
-                Program::Error("In step {} `{}`:\n{}"_format(step_index, step.name, e.what()));
             }
         }
+        catch (std::exception &e)
+        {
+            Program::Error("In step {} `{}`:\n{}"_format(step_index + 1, step.name, e.what()));
+        }
     }
 
 
+    // Draws a spinner over the last item, and a progress bar if `progress` is not negative.
+    static void DrawRunningIndicator(float progress)
+    {
+        ImDrawList &draw_list = *ImGui::GetWindowDrawList();
+        fvec2 item_min = ImGui::GetItemRectMin(), item_max = ImGui::GetItemRectMax();
+
+        if (progress >= 0)
+        {
+            fvec2 bar_max(item_min.x + (item_max.x - item_min.x) * progress, item_max.y);
+            draw_list.AddRectFilled(item_min, bar_max, ImGui::GetColorU32(ImGuiCol_PlotHistogram, 0.35), ImGui::GetStyle().FrameRounding);
+        }
+
+        float radius = (item_max.y - item_min.y) * 0.3;
+        fvec2 center(item_max.x - radius - ImGui::GetStyle().FramePadding.x, (item_min.y + item_max.y) / 2);
+        float angle = ImGui::GetTime() * 6;
+        draw_list.PathArcTo(center, radius, angle, angle + f_pi * 1.5, 12);
+        draw_list.PathStroke(ImGui::GetColorU32(ImGuiCol_Text), false, 2);
+    }
+
     class InteractionGuard
     {
       public:
@@ -118,19 +153,25 @@ namespace Widgets
 
         std::string PrettyName() const override {return "Текст";}
 
-        void Display(int index, bool allow_modification) override
+        bool Display(int index, bool allow_modification) override
         {
             (void)index;
             (void)allow_modification;
             ImGui::PushTextWrapPos(); // Enable word wrapping.
             ImGui::TextUnformatted(text.c_str());
             ImGui::PopTextWrapPos();
+            return false;
         }
 
         void DisplayEditor(Data::Procedure &, int index) override
         {
             ImGui::InputTextMultiline("###edit_text:{}"_format(index).c_str(), &text, ivec2(ImGui::GetContentRegionAvail().x, ImGui::GetFrameHeightWithSpacing() * 4), ImGuiInputTextFlags_AllowTabInput);
         }
+
+        void ListSearchableText(std::vector<std::string> &strings) const override
+        {
+            strings.push_back(text);
+        }
     };
 
     STRUCT( Spacing EXTENDS Widgets::BasicWidget )
@@ -139,12 +180,13 @@ namespace Widgets
 
         std::string PrettyName() const override {return "Отступ";}
 
-        void Display(int index, bool allow_modification) override
+        bool Display(int index, bool allow_modification) override
         {
             (void)index;
             (void)allow_modification;
             for (int i = 0; i < 4; i++)
                 ImGui::Spacing();
+            return false;
         }
 
         void DisplayEditor(Data::Procedure &, int) override {}
@@ -157,11 +199,12 @@ namespace Widgets
 
         std::string PrettyName() const override {return "Разделитель";}
 
-        void Display(int index, bool allow_modification) override
+        bool Display(int index, bool allow_modification) override
         {
             (void)index;
             (void)allow_modification;
             ImGui::Separator();
+            return false;
         }
 
         void DisplayEditor(Data::Procedure &, int) override {}
@@ -176,9 +219,7 @@ namespace Widgets
                 DECL(std::string) library_id, func_id
             )
 
-            Data::external_func_ptr_t ptr;
-
-            Function() : ptr(nullptr) {}
+            Data::ExternalFunction loaded; // Set in `Init()`.
         };
 
         SIMPLE_STRUCT( Button
@@ -186,15 +227,7 @@ namespace Widgets
             DECL(std::string ATTR Refl::Optional) tooltip
             DECL(std::optional<Function> ATTR Refl::Optional) function
             VERBATIM
-            void SimulatePress() const
-            {
-                if (!function)
-                    return;
-
-                const char *error_message = function->ptr();
-                if (error_message)
-                    Interface::MessageBox(Interface::MessageBoxType::warning, "Function error", error_message);
-            }
+            Data::EscapedLabel escaped_label;
         )
 
         MEMBERS(
@@ -216,22 +249,24 @@ namespace Widgets
                 if (!button.function)
                     continue;
 
-                auto lib_it = std::find_if(proc.libraries.begin(), proc.libraries.end(), [&](const Data::Library &lib){return lib.id == button.function->library_id;});
-                if (lib_it == proc.libraries.end())
-                    Program::Error("Shared library with id `", button.function->library_id, "` not found in the list of shared libraries.");
-
-                auto func_it = std::find_if(lib_it->functions.begin(), lib_it->functions.end(), [&](const Data::LibraryFunc &func){return func.id == button.function->func_id;});
-                if (func_it == lib_it->functions.end())
-                    Program::Error("Function with id `", button.function->func_id, "` not found in shared library `", button.function->library_id, "`.");
+                auto func_it = proc.function_table.find({button.function->library_id, button.function->func_id});
+                if (func_it == proc.function_table.end())
+                {
+                    // Scanning the list is slow, but we only do it to produce a better error message.
+                    if (std::none_of(proc.libraries.begin(), proc.libraries.end(), [&](const Data::Library &lib){return lib.id == button.function->library_id;}))
+                        Program::Error("Shared library with id `", button.function->library_id, "` not found in the list of shared libraries.");
+                    else
+                        Program::Error("Function with id `", button.function->func_id, "` not found in shared library `", button.function->library_id, "`.");
+                }
 
-                button.function->ptr = func_it->ptr;
+                button.function->loaded = func_it->second;
             }
 
             // We can't calculate proper width here, as fonts don't seem to be loaded this early.
             size_x = packed ? -1 : 0;
         }
 
-        void Display(int index, bool allow_modification) override
+        bool Display(int index, bool allow_modification) override
         {
             if (size_x == -1)
             {
@@ -258,22 +293,42 @@ namespace Widgets
                     if (elem_index >= int(buttons.size()))
                         break; // I don't think we want to terminate the outer loop early. We want to use all columns no matter what.
 
-                    const auto &button = buttons[elem_index];
+                    auto &button = buttons[elem_index];
 
-                    bool has_function = bool(button.function && button.function->ptr);
+                    bool has_function = button.function && button.function->loaded;
+                    bool running = has_function && Data::function_runner.IsRunning(button.function->loaded);
+                    bool can_cancel = running && Data::FunctionRunner::CanCancel(button.function->loaded);
 
                     { // Display button.
-                        InteractionGuard interaction_guard(allow_modification && has_function);
-
-                        if (ImGui::Button(Str(Data::EscapeStringForWidgetName(button.label), "###", index, ":", elem_index).c_str(), fvec2(size_x,0)) && allow_modification && has_function)
-                            button.SimulatePress();
+                        // While the function is running, pressing the button again cancels it, if the function supports that.
+                        InteractionGuard interaction_guard(allow_modification && has_function && (!running || can_cancel));
+
+                        ImGui::PushID(index);
+                        ImGui::PushID(elem_index);
+                        bool pressed = ImGui::Button(button.escaped_label.Get(button.label), fvec2(size_x,0));
+                        ImGui::PopID();
+                        ImGui::PopID();
+
+                        if (running)
+                            DrawRunningIndicator(Data::function_runner.Progress(button.function->loaded));
+
+                        if (pressed && allow_modification && has_function)
+                        {
+                            if (running)
+                                Data::function_runner.Cancel(button.function->loaded);
+                            else
+                                Data::function_runner.Start(button.function->loaded);
+                        }
                     }
 
-                    if (button.tooltip.size() > 0 && ImGui::IsItemHovered())
+                    if ((button.tooltip.size() > 0 || running) && ImGui::IsItemHovered())
                     {
                         ImGui::PushStyleVar(ImGuiStyleVar_WindowPadding, fvec2(Options::Visual::tooltip_padding));
                         ImGui::BeginTooltip();
-                        ImGui::TextUnformatted(button.tooltip.c_str());
+                        if (button.tooltip.size() > 0)
+                            ImGui::TextUnformatted(button.tooltip.c_str());
+                        if (running)
+                            ImGui::TextDisabled("%s", can_cancel ? "Выполняется. Нажмите, чтобы отменить." : "Выполняется...");
                         ImGui::EndTooltip();
                         ImGui::PopStyleVar();
                     }
@@ -285,6 +340,8 @@ namespace Widgets
                 if (i != columns-1)
                     ImGui::SetCursorPosY(cur_y);
             }
+
+            return false;
         }
 
         void DisplayEditor(Data::Procedure &, int index) override
@@ -342,6 +399,8 @@ namespace Widgets
             DECL(std::string) label
             DECL(bool INIT=false) state
             DECL(std::string ATTR Refl::Optional) tooltip
+            VERBATIM
+            Data::EscapedLabel escaped_label;
         )
 
         MEMBERS(
@@ -362,7 +421,7 @@ namespace Widgets
             size_x = packed ? -1 : 0;
         }
 
-        void Display(int index, bool allow_modification) override
+        bool Display(int index, bool allow_modification) override
         {
             if (size_x == -1)
             {
@@ -382,6 +441,8 @@ namespace Widgets
 
             InteractionGuard interaction_guard(allow_modification);
 
+            bool changed = false;
+
             int elem_index = 0;
             for (int i = 0; i < columns; i++)
             {
@@ -393,9 +454,16 @@ namespace Widgets
                     auto &checkbox = checkboxes[elem_index];
 
                     bool new_state = checkbox.state;
-                    if (ImGui::Checkbox(Str(Data::EscapeStringForWidgetName(checkbox.label), "###", index, ":", elem_index).c_str(), &new_state) && allow_modification)
+                    ImGui::PushID(index);
+                    ImGui::PushID(elem_index);
+                    bool clicked = ImGui::Checkbox(checkbox.escaped_label.Get(checkbox.label), &new_state);
+                    ImGui::PopID();
+                    ImGui::PopID();
+
+                    if (clicked && allow_modification)
                     {
                         checkbox.state = new_state;
+                        changed = true;
                     }
 
                     if (checkbox.tooltip.size() > 0 && ImGui::IsItemHovered())
@@ -414,6 +482,8 @@ namespace Widgets
                 if (i != columns-1)
                     ImGui::SetCursorPosY(cur_y);
             }
+
+            return changed;
         }
 
         void DisplayEditor(Data::Procedure &, int index) override
@@ -445,6 +515,37 @@ namespace Widgets
                     checkboxes.pop_back();
             }
         }
+
+        void ListSearchableText(std::vector<std::string> &strings) const override
+        {
+            for (const CheckBox &checkbox : checkboxes)
+                strings.push_back(checkbox.label);
+        }
+
+        void ListExportedValues(std::vector<std::pair<std::string, std::string>> &values) const override
+        {
+            for (const CheckBox &checkbox : checkboxes)
+                values.emplace_back(checkbox.label, checkbox.state ? "1" : "0");
+        }
+
+        // One `0` or `1` per checkbox.
+        std::string StateToString() const override
+        {
+            std::string ret;
+            for (const CheckBox &checkbox : checkboxes)
+                ret += checkbox.state ? '1' : '0';
+            return ret;
+        }
+
+        void StateFromString(std::string_view state) override
+        {
+            if (state.size() != checkboxes.size())
+                Program::Error("The number of checkboxes doesn't match the report.");
+            if (state.find_first_not_of("01") != std::string_view::npos)
+                Program::Error("Invalid checkbox state.");
+            for (std::size_t i = 0; i < state.size(); i++)
+                checkboxes[i].state = state[i] == '1';
+        }
     };
 
     STRUCT( RadioButtonList EXTENDS Widgets::BasicWidget )
@@ -452,6 +553,8 @@ namespace Widgets
         SIMPLE_STRUCT( RadioButton
             DECL(std::string) label
             DECL(std::string ATTR Refl::Optional) tooltip
+            VERBATIM
+            Data::EscapedLabel escaped_label;
         )
 
         MEMBERS(
@@ -476,7 +579,7 @@ namespace Widgets
             size_x = packed ? -1 : 0;
         }
 
-        void Display(int index, bool allow_modification) override
+        bool Display(int index, bool allow_modification) override
         {
             if (size_x == -1)
             {
@@ -496,6 +599,8 @@ namespace Widgets
 
             InteractionGuard interaction_guard(allow_modification);
 
+            bool changed = false;
+
             int elem_index = 0;
             for (int i = 0; i < columns; i++)
             {
@@ -504,15 +609,22 @@ namespace Widgets
                     if (elem_index >= int(radiobuttons.size()))
                         break; // I don't think we want to terminate the outer loop early. We want to use all columns no matter what.
 
-                    const auto &radiobutton = radiobuttons[elem_index];
+                    auto &radiobutton = radiobuttons[elem_index];
 
                     int new_selected = selected;
-                    if (ImGui::RadioButton(Str(Data::EscapeStringForWidgetName(radiobutton.label), "###", index, ":", elem_index).c_str(), &new_selected, elem_index+1) && allow_modification)
+                    ImGui::PushID(index);
+                    ImGui::PushID(elem_index);
+                    bool clicked = ImGui::RadioButton(radiobutton.escaped_label.Get(radiobutton.label), &new_selected, elem_index+1);
+                    ImGui::PopID();
+                    ImGui::PopID();
+
+                    if (clicked && allow_modification)
                     {
                         if (selected != new_selected)
                             selected = new_selected;
                         else
                             selected = 0;
+                        changed = true;
                     }
 
                     if (radiobutton.tooltip.size() > 0 && ImGui::IsItemHovered())
@@ -531,6 +643,8 @@ namespace Widgets
                 if (i != columns-1)
                     ImGui::SetCursorPosY(cur_y);
             }
+
+            return changed;
         }
 
         void DisplayEditor(Data::Procedure &, int index) override
@@ -573,6 +687,32 @@ namespace Widgets
             if (selected < 0 || selected > int(radiobuttons.size()))
                 selected = 0;
         }
+
+        void ListExportedValues(std::vector<std::pair<std::string, std::string>> &values) const override
+        {
+            // The buttons have no common label, so the column is named after all of them.
+            std::string name;
+            for (const RadioButton &radiobutton : radiobuttons)
+            {
+                if (name.size() > 0)
+                    name += " / ";
+                name += radiobutton.label;
+            }
+            values.emplace_back(std::move(name), selected > 0 && selected <= int(radiobuttons.size()) ? radiobuttons[selected-1].label : "");
+        }
+
+        std::string StateToString() const override
+        {
+            return Refl::ToString(selected);
+        }
+
+        void StateFromString(std::string_view state) override
+        {
+            auto new_selected = Refl::FromString<int>(state);
+            if (new_selected < 0 || new_selected > int(radiobuttons.size())) // Sic, 0 means nothing is selected.
+                Program::Error("Index of a selected radio button is out of range.");
+            selected = new_selected;
+        }
     };
 
     STRUCT( TextInput EXTENDS Widgets::BasicWidget )
@@ -584,21 +724,28 @@ namespace Widgets
             DECL(bool INIT=true ATTR Refl::Optional) inline_label
         )
 
+        Data::EscapedLabel escaped_label;
+
         std::string PrettyName() const override {return "Текстовое поле";}
 
-        void Display(int index, bool allow_modification) override
+        bool Display(int index, bool allow_modification) override
         {
             InteractionGuard interaction_guard(allow_modification, InteractionGuard::visuals_only);
 
             if (!inline_label)
                 ImGui::TextUnformatted(label.c_str());
 
-            std::string inline_label_text = Str(inline_label ? Data::EscapeStringForWidgetName(label) : "", "###", index);
+            const char *inline_label_text = inline_label ? escaped_label.Get(label) : "";
 
+            ImGui::PushID(index);
             if (hint.size() > 0)
-                ImGui::InputTextWithHint(inline_label_text.c_str(), hint.c_str(), &value, !allow_modification * ImGuiInputTextFlags_ReadOnly);
+                ImGui::InputTextWithHint(inline_label_text, hint.c_str(), &value, !allow_modification * ImGuiInputTextFlags_ReadOnly);
             else
-                ImGui::InputText(inline_label_text.c_str(), &value, !allow_modification * ImGuiInputTextFlags_ReadOnly);
+                ImGui::InputText(inline_label_text, &value, !allow_modification * ImGuiInputTextFlags_ReadOnly);
+            ImGui::PopID();
+
+            // We only report the change once the user is done editing, rather than on every keystroke.
+            return allow_modification && ImGui::IsItemDeactivatedAfterEdit();
         }
 
         void DisplayEditor(Data::Procedure &, int index) override
@@ -611,6 +758,27 @@ namespace Widgets
             ImGui::TextUnformatted("Подсказка (отображается, если никакой текст не введен; не обязательна)");
             ImGui::InputText("###edit_textinput_hint:{}"_format(index).c_str(), &hint);
         }
+
+        void ListSearchableText(std::vector<std::string> &strings) const override
+        {
+            strings.push_back(label);
+            strings.push_back(value);
+        }
+
+        void ListExportedValues(std::vector<std::pair<std::string, std::string>> &values) const override
+        {
+            values.emplace_back(label, value);
+        }
+
+        std::string StateToString() const override
+        {
+            return Refl::ToString(value);
+        }
+
+        void StateFromString(std::string_view state) override
+        {
+            value = Refl::FromString<std::string>(state);
+        }
     };
 
     STRUCT( ImageList EXTENDS Widgets::BasicWidget )
@@ -640,10 +808,16 @@ namespace Widgets
                 Program::Error("An image list must contain at least one image.");
 
             for (auto &image : images)
-                image.data = proc.image_cache.Load((proc.resource_dir / image.file_name).string());
+                image.data = Data::image_cache.Load(proc.resource_dir / image.file_name);
         }
 
-        void Display(int index, bool allow_modification) override
+        void ListImageFiles(std::vector<std::string> &files) const override
+        {
+            for (const auto &image : images)
+                files.push_back(image.file_name);
+        }
+
+        bool Display(int index, bool allow_modification) override
         {
             (void)allow_modification;
 
@@ -674,31 +848,50 @@ namespace Widgets
 
                     const auto &image = images[elem_index];
 
-                    if (!image.data->texture)
-                        Program::Error("Internal error: Image handle is null.");
-
-                    fvec2 image_size_relative_to_button = image.current_screen_size / fvec2(max_size);
-                    fvec2 coord_a = (1 / image_size_relative_to_button - 1) / -2;
-                    fvec2 coord_b = 1 - coord_a;
+                    bool button_pressed = false;
 
-                    ImGui::PushID(index); // We push this here rather than outside of the loop because we don't want it to affect modal window if we're going to open it.
-                    ImGui::PushID(elem_index);
-                    bool button_pressed = ImGui::ImageButton(image.data->TextureHandle(), max_size, coord_a, coord_b, padding);
-                    ImGui::PopID();
-                    ImGui::PopID();
+                    if (image.data->Use())
+                    {
+                        fvec2 image_size_relative_to_button = image.current_screen_size / fvec2(max_size);
+                        fvec2 coord_a = (1 / image_size_relative_to_button - 1) / -2;
+                        fvec2 coord_b = 1 - coord_a;
+
+                        ImGui::PushID(index); // We push this here rather than outside of the loop because we don't want it to affect modal window if we're going to open it.
+                        ImGui::PushID(elem_index);
+                        button_pressed = ImGui::ImageButton(image.data->thumbnail.Handle(), max_size, coord_a, coord_b, padding);
+                        ImGui::PopID();
+                        ImGui::PopID();
+                    }
+                    else
+                    {
+                        // The image is still loading (or failed to load), draw a placeholder of the same size.
+                        fvec2 corner_a = fvec2(ImGui::GetCursorScreenPos()) + padding + (max_size - image.current_screen_size) / 2;
+                        fvec2 corner_b = corner_a + image.current_screen_size;
+                        ImGui::Dummy(max_size + padding * 2);
+                        ImGui::GetWindowDrawList()->AddRectFilled(corner_a, corner_b, ImGui::GetColorU32(ImGuiCol_FrameBg));
+                        if (image.data->thumbnail.error.size() > 0)
+                            ImGui::GetWindowDrawList()->AddRect(corner_a, corner_b, ImGui::GetColorU32(fvec4(0.8,0,0,1)));
+                    }
 
-                    if (image.tooltip.size() > 0 && ImGui::IsItemHovered())
+                    bool show_error = image.data->thumbnail.error.size() > 0;
+                    if ((image.tooltip.size() > 0 || show_error) && ImGui::IsItemHovered())
                     {
                         ImGui::PushStyleVar(ImGuiStyleVar_WindowPadding, fvec2(Options::Visual::tooltip_padding));
                         ImGui::BeginTooltip();
-                        ImGui::TextUnformatted(image.tooltip.c_str());
+                        if (show_error)
+                        {
+                            ImGui::TextColored(fvec4(0.8,0,0,1), "Не удалось загрузить изображение:");
+                            ImGui::TextUnformatted(image.data->thumbnail.error.c_str());
+                        }
+                        if (image.tooltip.size() > 0)
+                            ImGui::TextUnformatted(image.tooltip.c_str());
                         ImGui::EndTooltip();
                         ImGui::PopStyleVar();
                     }
 
                     if (button_pressed)
                     {
-                        Data::clicked_image = &*image.data;
+                        Data::clicked_image = image.data;
                     }
 
                     elem_index++;
@@ -708,6 +901,8 @@ namespace Widgets
                 if (i != columns-1)
                     ImGui::SetCursorPosY(cur_y);
             }
+
+            return false;
         }
 
         void DisplayEditor(Data::Procedure &, int index) override
@@ -2,6 +2,9 @@
 
 #include <filesystem>
 #include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
 
 namespace fs = std::filesystem;
 
@@ -16,6 +19,7 @@ namespace fs = std::filesystem;
 namespace Data
 {
     struct Procedure;
+    struct ProcedureStep;
 }
 
 namespace Widgets
@@ -26,13 +30,24 @@ namespace Widgets
 
         virtual std::string PrettyName() const = 0;
         virtual void Init(const Data::Procedure &) {}
-        virtual void Display(int index, bool allow_modification) = 0;
+        virtual bool Display(int index, bool allow_modification) = 0; // Returns `true` if the user changed the widget state.
         virtual void DisplayEditor(Data::Procedure &, int index) = 0;
 
         virtual bool IsEditable() const {return true;}
+        virtual void ListImageFiles(std::vector<std::string> &) const {} // Appends the images this widget displays, relative to the resource directory.
+        virtual void ListSearchableText(std::vector<std::string> &) const {} // Appends the strings that should be indexed for the full-text search.
+        virtual void ListExportedValues(std::vector<std::pair<std::string, std::string>> &) const {} // Appends the names and values of the state filled by the user, for the report export.
+
+        // The state filled by the user, serialized for the report journal. Everything else comes from the template and doesn't change in reports.
+        // Widgets with state must override both. `StateFromString()` throws if the state doesn't fit the widget, and leaves it unchanged in that case.
+        virtual std::string StateToString() const {return "";}
+        virtual void StateFromString(std::string_view state) {(void)state;}
     };
 
     using Widget = Refl::PolyStorage<BasicWidget>;
 
+    // Loads the libraries and initializes the widgets of all loaded steps.
     void InitializeWidgets(Data::Procedure &proc);
+    // Initializes the widgets of a single step. `step_index` is only used in error messages.
+    void InitializeStepWidgets(const Data::Procedure &proc, Data::ProcedureStep &step, int step_index);
 }
@@ -19,3 +19,15 @@
 // |                                          |
 // | Polymorphic class support.               |
 // '------------------------------------------'
+//
+// .- visitor.h -------------------------------------------.
+// |                                                       |
+// | Reading serialized objects without constructing them. |
+// | Includes `full.h`.                                    |
+// '-------------------------------------------------------'
+//
+// .- inline.h ------------------------------------------.
+// |                                                     |
+// | Faster (de)serialization without virtual functions. |
+// | Includes `full.h`.                                  |
+// '-----------------------------------------------------'
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include "macros/check.h"
+#include "reflection/full.h"
+#include "stream/input.h"
+#include "stream/output.h"
+
+// An alternative to `Refl::{To|From}{String|Binary}()` that doesn't use virtual functions.
+// The regular functions process each nested object through the virtual functions of `Interface<T>()`, which prevents the compiler from inlining anything.
+// Here the same implementations are instantiated with `impl::InlineDispatch`, which calls them directly. The result is exactly the same.
+// Only writing gets faster: reading is dominated by the parsing itself, so it gains nothing (see `benchmarks/serialization.cpp`).
+// The downside is larger code and longer compilation, so this should only be used for writing large objects that are serialized often.
+// Polymorphic objects still go through their function pointers, since we can't know their types at compile-time.
+
+namespace Refl
+{
+    namespace impl
+    {
+        // Calls the implementations of the interfaces directly, instead of going through their virtual functions.
+        // `Derived` processes the nested objects. Derive from this to customize how some types are processed, otherwise use `InlineDispatch` below.
+        // The derived class can store any state it needs, since the same object is passed down to all nested objects.
+        template <typename Derived>
+        struct BasicInlineDispatch
+        {
+          private:
+            template <typename T> using interface_t = decltype(Interface<T>());
+
+            enum class Category
+            {
+                other, // The interface functions are called non-virtually.
+                composite, // Structs, optionals, and variants. Use the `...Impl()` functions of the interface, which process the nested objects with `Derived`.
+                container, // Same, but the `...Impl()` functions also need the interface object.
+            };
+
+            template <typename T> static constexpr Category category = []{
+                using I = interface_t<T>;
+                if constexpr (std::is_same_v<I, Interface_Struct<T>> || std::is_same_v<I, Interface_StdOptional<T>> || std::is_same_v<I, Interface_StdVariant<T>>)
+                    return Category::composite;
+                else if constexpr (std::is_base_of_v<Interface_BasicContainer<T>, I>)
+                    return Category::container;
+                else
+                    return Category::other;
+            }();
+
+            template <typename I, I ...Seq, typename F> static void WithIndexLow(I i, F &func, std::integer_sequence<I, Seq...>)
+            {
+                // Unlike `Meta::with_cexpr_value()`, this doesn't use function pointers, so the calls can be inlined.
+                (void)i; // Unused if the pack is empty.
+                (void)((i == Seq ? (func(std::integral_constant<I, Seq>{}), true) : false) || ...);
+            }
+
+            const Derived &self() const
+            {
+                return static_cast<const Derived &>(*this);
+            }
+
+          public:
+            template <typename T> void ToString(const T &object, Stream::Output &output, const ToStringOptions &options, ToStringState state) const
+            {
+                using I = interface_t<T>;
+                if constexpr (category<T> == Category::composite)
+                    I::ToStringImpl(self(), object, output, options, state);
+                else if constexpr (category<T> == Category::container)
+                    I::ToStringImpl(self(), I{}, object, output, options, state);
+                else
+                    I{}.I::ToString(object, output, options, state);
+            }
+
+            template <typename T> void FromString(T &object, Stream::Input &input, const FromStringOptions &options, FromStringState state) const
+            {
+                using I = interface_t<T>;
+                if constexpr (category<T> == Category::composite)
+                    I::FromStringImpl(self(), object, input, options, state);
+                else if constexpr (category<T> == Category::container)
+                    I::FromStringImpl(self(), I{}, object, input, options, state);
+                else
+                    I{}.I::FromString(object, input, options, state);
+            }
+
+            template <typename T> void ToBinary(const T &object, Stream::Output &output, const ToBinaryOptions &options, ToBinaryState state) const
+            {
+                using I = interface_t<T>;
+                if constexpr (category<T> == Category::composite)
+                    I::ToBinaryImpl(self(), object, output, options, state);
+                else if constexpr (category<T> == Category::container)
+                    I::ToBinaryImpl(self(), I{}, object, output, options, state);
+                else
+                    I{}.I::ToBinary(object, output, options, state);
+            }
+
+            template <typename T> void FromBinary(T &object, Stream::Input &input, const FromBinaryOptions &options, FromBinaryState state) const
+            {
+                using I = interface_t<T>;
+                if constexpr (category<T> == Category::composite)
+                    I::FromBinaryImpl(self(), object, input, options, state);
+                else if constexpr (category<T> == Category::container)
+                    I::FromBinaryImpl(self(), I{}, object, input, options, state);
+                else
+                    I{}.I::FromBinary(object, input, options, state);
+            }
+
+            // Calls `func` with `std::integral_constant<decltype(N), i>`. Unlike `VirtualDispatch::WithIndex()`, ignores the return value.
+            template <auto N, typename F> static void WithIndex(decltype(N) i, F &&func)
+            {
+                WithIndexLow(i, func, std::make_integer_sequence<decltype(N), N>{});
+            }
+        };
+
+        struct InlineDispatch : BasicInlineDispatch<InlineDispatch> {};
+    }
+
+    // Those mirror the functions in `reflection/interface_basic.h`.
+    namespace Inline
+    {
+        template <typename T, CHECK_EXPR(Interface<T>())>
+        void ToString(const T &object, Stream::Output &output, const ToStringOptions &options = {})
+        {
+            impl::InlineDispatch{}.ToString(object, output, options, initial_state);
+        }
+        template <typename T, CHECK_EXPR(Interface<T>())>
+        [[nodiscard]] std::string ToString(const T &object, const ToStringOptions &options = {})
+        {
+            std::string ret;
+            Stream::Output output = Stream::Output::Container(ret);
+            Inline::ToString(object, output, options); // A qualified call prevents unwanted ADL.
+            return ret;
+        }
+
+        // Skips any leading and trailing whitespace and comments. Expects `input` to have no junk at the end.
+        template <typename T, CHECK_EXPR(Interface<T>())>
+        void FromString(T &object, InputStreamWrapper input, const FromStringOptions &options = {})
+        {
+            input.stream.WantLocationStyle(Stream::text_position);
+            Utils::SkipWhitespaceAndComments(input.stream);
+            impl::InlineDispatch{}.FromString(object, input.stream, options, initial_state);
+            Utils::SkipWhitespaceAndComments(input.stream);
+            input.stream.ExpectEnd();
+        }
+        template <typename T, CHECK_EXPR(void(Interface<T>()), T{})>
+        [[nodiscard]] T FromString(InputStreamWrapper input, const FromStringOptions &options = {})
+        {
+            T ret{};
+            Inline::FromString(ret, std::move(input), options); // A qualified call prevents unwanted ADL.
+            return ret;
+        }
+
+        template <typename T, CHECK_EXPR(Interface<T>())>
+        void ToBinary(const T &object, Stream::Output &output, const ToBinaryOptions &options = {})
+        {
+            impl::InlineDispatch{}.ToBinary(object, output, options, initial_state);
+        }
+        template <typename C, typename T, CHECK_EXPR(void(Interface<T>()), Stream::Output::Container(std::declval<C &>()))>
+        [[nodiscard]] C ToBinary(const T &object, const ToBinaryOptions &options = {})
+        {
+            C ret;
+            auto output = Stream::Output::Container(ret);
+            Inline::ToBinary(object, output, options); // A qualified call prevents unwanted ADL.
+            output.Flush();
+            return ret;
+        }
+
+        // Expects `input_data` to have no junk at the end.
+        template <typename T, CHECK_EXPR(Interface<T>())>
+        void FromBinary(T &object, InputStreamWrapper input, const FromBinaryOptions &options = {})
+        {
+            input.stream.WantLocationStyle(Stream::byte_offset);
+            impl::InlineDispatch{}.FromBinary(object, input.stream, options, initial_state);
+            input.stream.ExpectEnd();
+        }
+        template <typename T, CHECK_EXPR(void(Interface<T>()), T{})>
+        [[nodiscard]] T FromBinary(InputStreamWrapper input, const FromBinaryOptions &options = {})
+        {
+            T ret{};
+            Inline::FromBinary(ret, std::move(input), options); // A qualified call prevents unwanted ADL.
+            return ret;
+        }
+    }
+}
@@ -12,6 +12,7 @@
 #include "reflection/utils.h"
 #include "stream/input.h"
 #include "stream/output.h"
+#include "utils/thread_pool.h"
 
 namespace Refl
 {
@@ -34,6 +35,12 @@ namespace Refl
     {
         // When parsing a struct, don't complain if any fields are missing.
         bool ignore_missing_fields = false;
+
+        // If set, lists larger than `parallel_min_size` bytes have their elements parsed on the threads of this pool, and on the current thread.
+        // Only works when the input is in memory. Nested lists are always parsed on a single thread.
+        // The result and the error messages are the same as when parsing on a single thread.
+        ThreadPool *thread_pool = nullptr;
+        std::size_t parallel_min_size = 256 * 1024;
     };
 
     struct ToBinaryOptions {};
@@ -220,6 +227,42 @@ namespace Refl
     }
 
 
+    namespace impl
+    {
+        // The interfaces of structs, containers, optionals and variants are implemented in terms of a `child` parameter,
+        // which determines how the nested objects are processed. It's passed by reference, so it can carry state.
+        // This one goes through the virtual functions of `Interface<T>()`. The alternative is `impl::InlineDispatch` from `reflection/inline.h`.
+        struct VirtualDispatch
+        {
+            template <typename T> static void ToString(const T &object, Stream::Output &output, const ToStringOptions &options, ToStringState state)
+            {
+                Interface<T>().ToString(object, output, options, state);
+            }
+
+            template <typename T> static void FromString(T &object, Stream::Input &input, const FromStringOptions &options, FromStringState state)
+            {
+                Interface<T>().FromString(object, input, options, state);
+            }
+
+            template <typename T> static void ToBinary(const T &object, Stream::Output &output, const ToBinaryOptions &options, ToBinaryState state)
+            {
+                Interface<T>().ToBinary(object, output, options, state);
+            }
+
+            template <typename T> static void FromBinary(T &object, Stream::Input &input, const FromBinaryOptions &options, FromBinaryState state)
+            {
+                Interface<T>().FromBinary(object, input, options, state);
+            }
+
+            // Calls `func` with `std::integral_constant<decltype(N), i>`. See `Meta::with_cexpr_value()`.
+            template <auto N, typename F> static decltype(auto) WithIndex(decltype(N) i, F &&func)
+            {
+                return Meta::with_cexpr_value<N>(i, std::forward<F>(func));
+            }
+        };
+    }
+
+
     inline namespace Shorthands
     {
         // Functions below use this wrapper for safery and convenience.
@@ -1,11 +1,17 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
 #include <cstddef>
 #include <exception>
 #include <functional>
+#include <memory>
+#include <optional>
+#include <string_view>
 #include <tuple>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 #include "meta/misc.h"
 #include "program/errors.h"
@@ -69,8 +75,38 @@ namespace Refl
         // Iterates over the container.
         virtual void ForEach(const T &object, std::function<void(const elem_t &elem)> func) const = 0;
 
+        // Same as `ForEach()`. Derived classes can hide this with a version that doesn't use `std::function`, see `ToStringImpl()` below.
+        template <typename F> void ForEachInline(const T &object, F &&func) const
+        {
+            ForEach(object, func);
+        }
+
 
         void ToString(const T &object, Stream::Output &output, const ToStringOptions &options, impl::ToStringState state) const override
+        {
+            ToStringImpl(impl::VirtualDispatch{}, *this, object, output, options, state);
+        }
+
+        void FromString(T &object, Stream::Input &input, const FromStringOptions &options, impl::FromStringState state) const override
+        {
+            FromStringImpl(impl::VirtualDispatch{}, *this, object, input, options, state);
+        }
+
+        void ToBinary(const T &object, Stream::Output &output, const ToBinaryOptions &options, impl::ToBinaryState state) const override
+        {
+            ToBinaryImpl(impl::VirtualDispatch{}, *this, object, output, options, state);
+        }
+
+        void FromBinary(T &object, Stream::Input &input, const FromBinaryOptions &options, impl::FromBinaryState state) const override
+        {
+            FromBinaryImpl(impl::VirtualDispatch{}, *this, object, input, options, state);
+        }
+
+        // The implementations of the functions above. `child` determines how the elements are processed, see `impl::VirtualDispatch`.
+        // The container is accessed through `self`. If it's a final class, the calls to its virtual functions are resolved at compile-time.
+
+        template <typename Child, typename Self>
+        static void ToStringImpl(const Child &child, const Self &self, const T &object, Stream::Output &output, const ToStringOptions &options, impl::ToStringState state)
         {
             constexpr bool force_single_line = impl::HasShortStringRepresentation<elem_t>::value;
 
@@ -78,13 +114,13 @@ namespace Refl
 
             auto next_state = state.MemberOrElem(options);
 
-            std::size_t index = 0, size = Size(object);
-            ForEach(object, [&](const elem_t &elem)
+            std::size_t index = 0, size = self.Size(object);
+            self.ForEachInline(object, [&](const elem_t &elem)
             {
                 if (options.pretty && !force_single_line)
                     output.WriteChar('\n').WriteChar(' ', state.CurIndent() + options.indent);
 
-                Interface<mutable_elem_t>().ToString(elem, output, options, next_state);
+                child.template ToString<mutable_elem_t>(elem, output, options, next_state);
 
                 if (index != size-1 || (options.pretty && !force_single_line))
                 {
@@ -102,14 +138,36 @@ namespace Refl
             output.WriteChar(']');
         }
 
-        void FromString(T &object, Stream::Input &input, const FromStringOptions &options, impl::FromStringState state) const override
+        template <typename Child, typename Self>
+        static void FromStringImpl(const Child &child, const Self &self, T &object, Stream::Input &input, const FromStringOptions &options, impl::FromStringState state)
         {
-            Clear(object);
+            self.Clear(object);
+
+            // Nested lists are always parsed on a single thread: either this list is parsed in parallel, or it's too small, and so are they.
+            std::optional<FromStringOptions> single_thread_options;
+            bool try_parallel = false;
+            if (options.thread_pool)
+            {
+                single_thread_options = options;
+                single_thread_options->thread_pool = nullptr;
+
+                // Check the size of the list itself, not of the remaining input. This looks at most at `parallel_min_size` bytes:
+                // if the list ends before that, it's too small. Otherwise it's either large enough or malformed, which `FromStringParallel()` sorts out.
+                std::string_view memory = input.RemainingMemory();
+                try_parallel = memory.size() >= options.parallel_min_size && Utils::impl::ValueLengthInMemory(memory.substr(0, options.parallel_min_size)) == 0;
+            }
+            const FromStringOptions &elem_options = single_thread_options ? *single_thread_options : options;
 
             input.Discard('[');
 
             auto next_state = state.MemberOrElem(options);
 
+            if (try_parallel)
+            {
+                if (FromStringParallel(child, self, object, input, options, next_state))
+                    return;
+            }
+
             while (true)
             {
                 Utils::SkipWhitespaceAndComments(input);
@@ -117,11 +175,11 @@ namespace Refl
                     break;
 
                 mutable_elem_t elem{};
-                Interface<mutable_elem_t>().FromString(elem, input, options, next_state);
+                child.FromString(elem, input, elem_options, next_state);
 
                 try
                 {
-                    PushBack(object, std::move(elem));
+                    self.PushBack(object, std::move(elem));
                 }
                 catch (std::exception &e)
                 {
@@ -138,7 +196,82 @@ namespace Refl
             }
         }
 
-        void ToBinary(const T &object, Stream::Output &output, const ToBinaryOptions &options, impl::ToBinaryState state) const override
+        // Parses the list elements on several threads, see `FromStringOptions::thread_pool`. `input` must point right after the opening `[`.
+        // Returns false if some elements have to be parsed normally. Then `input` points to the first of them, and the preceding ones are already added to `object`.
+        // Any errors are handled by returning false, so that the normal parsing can report them with the correct location.
+        template <typename Child, typename Self>
+        static bool FromStringParallel(const Child &child, const Self &self, T &object, Stream::Input &input, const FromStringOptions &options, impl::FromStringState next_state)
+        {
+            std::string_view memory = input.RemainingMemory();
+
+            // Find the element boundaries. This is much faster than parsing the elements.
+            std::vector<std::pair<std::size_t, std::size_t>> elements;
+            std::size_t list_len = Utils::impl::ListElementsInMemory(memory, elements);
+            if (list_len == 0 || list_len < options.parallel_min_size || elements.size() < 2)
+                return false; // Either the list is malformed, or it's too small to bother.
+
+            auto slots = std::make_unique<mutable_elem_t[]>(elements.size()); // Not `std::vector`, since `std::vector<bool>` can't be written from several threads.
+            std::vector<char> parsed(elements.size()); // Same.
+            std::atomic_size_t next_index = 0;
+            std::atomic_bool failed = false;
+
+            FromStringOptions elem_options = options;
+            elem_options.thread_pool = nullptr;
+
+            auto Work = [&]
+            {
+                while (!failed.load(std::memory_order_relaxed))
+                {
+                    std::size_t i = next_index++;
+                    if (i >= elements.size())
+                        break;
+
+                    try
+                    {
+                        Stream::Input elem_input(Stream::ReadOnlyData::mem_reference(memory.data() + elements[i].first, memory.data() + elements[i].second));
+                        child.FromString(slots[i], elem_input, elem_options, next_state);
+                        elem_input.ExpectEnd();
+                        parsed[i] = true;
+                    }
+                    catch (std::exception &)
+                    {
+                        // Stop early. Everything starting from the first failed element will be parsed again on the current thread.
+                        failed = true;
+                    }
+                }
+            };
+
+            // The current thread is counted as one of the workers, hence the `- 1`.
+            options.thread_pool->RunAndWait(int(std::min(std::size_t(options.thread_pool->ThreadCount()), elements.size() - 1)), Work);
+
+            std::size_t parsed_count = std::find(parsed.begin(), parsed.end(), false) - parsed.begin();
+
+            self.Reserve(object, elements.size());
+            for (std::size_t i = 0; i < parsed_count; i++)
+            {
+                try
+                {
+                    self.PushBack(object, std::move(slots[i]));
+                }
+                catch (std::exception &e)
+                {
+                    input.Skip(elements[i].second); // Report the error after the element, same as the normal parsing.
+                    Program::Error(input.GetExceptionPrefix() + e.what());
+                }
+            }
+
+            if (parsed_count < elements.size())
+            {
+                input.Skip(elements[parsed_count].first);
+                return false;
+            }
+
+            input.Skip(list_len);
+            return true;
+        }
+
+        template <typename Child, typename Self>
+        static void ToBinaryImpl(const Child &child, const Self &self, const T &object, Stream::Output &output, const ToBinaryOptions &options, impl::ToBinaryState state)
         {
             impl::container_length_binary_t len;
             if (Robust::conversion_fails(object.size(), len))
@@ -147,13 +280,14 @@ namespace Refl
 
             auto next_state = state.MemberOrElem(options);
 
-            ForEach(object, [&](const elem_t &elem)
+            self.ForEachInline(object, [&](const elem_t &elem)
             {
-                Interface<mutable_elem_t>().ToBinary(elem, output, options, next_state);
+                child.template ToBinary<mutable_elem_t>(elem, output, options, next_state);
             });
         }
 
-        void FromBinary(T &object, Stream::Input &input, const FromBinaryOptions &options, impl::FromBinaryState state) const override
+        template <typename Child, typename Self>
+        static void FromBinaryImpl(const Child &child, const Self &self, T &object, Stream::Input &input, const FromBinaryOptions &options, impl::FromBinaryState state)
         {
             std::size_t len;
             if (Robust::conversion_fails(input.ReadWithByteOrder<impl::container_length_binary_t>(impl::container_length_byte_order), len))
@@ -161,19 +295,19 @@ namespace Refl
 
             std::size_t max_reserved_elems = options.max_reserved_size / sizeof(elem_t);
 
-            Clear(object);
-            Reserve(object, len < max_reserved_elems ? len : max_reserved_elems);
+            self.Clear(object);
+            self.Reserve(object, len < max_reserved_elems ? len : max_reserved_elems);
 
             auto next_state = state.MemberOrElem(options);
 
             while (len-- > 0)
             {
                 mutable_elem_t elem{};
-                Interface<mutable_elem_t>().FromBinary(elem, input, options, next_state);
+                child.FromBinary(elem, input, options, next_state);
 
                 try
                 {
-                    PushBack(object, std::move(elem));
+                    self.PushBack(object, std::move(elem));
                 }
                 catch (std::exception &e)
                 {
@@ -247,6 +381,11 @@ namespace Refl
         }
 
         virtual void ForEach(const T &object, std::function<void(const elem_t &elem)> func) const override
+        {
+            ForEachInline(object, func);
+        }
+
+        template <typename F> void ForEachInline(const T &object, F &&func) const
         {
             for (auto it = object.begin(); it != object.end(); it++)
                 func(*it);
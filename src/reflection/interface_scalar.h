@@ -1,6 +1,8 @@
 #pragma once
 
 #include <exception>
+#include <string>
+#include <string_view>
 #include <type_traits>
 
 #include "program/errors.h"
@@ -43,7 +45,8 @@ namespace Refl
                 return ok;
             });
 
-            std::string str = input.Extract(category);
+            std::string storage;
+            std::string_view str = input.ExtractView(category, storage);
             try
             {
                 object = Strings::FromString<T>(str);
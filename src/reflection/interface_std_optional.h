@@ -16,6 +16,29 @@ namespace Refl
         using elem_t = typename T::value_type;
       public:
         void ToString(const T &object, Stream::Output &output, const ToStringOptions &options, impl::ToStringState state) const override
+        {
+            ToStringImpl(impl::VirtualDispatch{}, object, output, options, state);
+        }
+
+        void FromString(T &object, Stream::Input &input, const FromStringOptions &options, impl::FromStringState state) const override
+        {
+            FromStringImpl(impl::VirtualDispatch{}, object, input, options, state);
+        }
+
+        void ToBinary(const T &object, Stream::Output &output, const ToBinaryOptions &options, impl::ToBinaryState state) const override
+        {
+            ToBinaryImpl(impl::VirtualDispatch{}, object, output, options, state);
+        }
+
+        void FromBinary(T &object, Stream::Input &input, const FromBinaryOptions &options, impl::FromBinaryState state) const override
+        {
+            FromBinaryImpl(impl::VirtualDispatch{}, object, input, options, state);
+        }
+
+        // The implementations of the functions above. `child` determines how the contained value is processed, see `impl::VirtualDispatch`.
+
+        template <typename Child>
+        static void ToStringImpl(const Child &child, const T &object, Stream::Output &output, const ToStringOptions &options, impl::ToStringState state)
         {
             if (!object)
             {
@@ -24,11 +47,12 @@ namespace Refl
             else
             {
                 output.WriteChar(':');
-                Interface<elem_t>().ToString(*object, output, options, state.PartOfRepresentation(options));
+                child.template ToString<elem_t>(*object, output, options, state.PartOfRepresentation(options));
             }
         }
 
-        void FromString(T &object, Stream::Input &input, const FromStringOptions &options, impl::FromStringState state) const override
+        template <typename Child>
+        static void FromStringImpl(const Child &child, T &object, Stream::Input &input, const FromStringOptions &options, impl::FromStringState state)
         {
             if (input.Discard<Stream::if_present>('?'))
             {
@@ -48,25 +72,27 @@ namespace Refl
                 Program::Error(input.GetExceptionPrefix() + e.what());
             }
 
-            Interface<elem_t>().FromString(*object, input, options, state.PartOfRepresentation(options));
+            child.template FromString<elem_t>(*object, input, options, state.PartOfRepresentation(options));
         }
 
-        void ToBinary(const T &object, Stream::Output &output, const ToBinaryOptions &options, impl::ToBinaryState state) const override
+        template <typename Child>
+        static void ToBinaryImpl(const Child &child, const T &object, Stream::Output &output, const ToBinaryOptions &options, impl::ToBinaryState state)
         {
             auto next_state = state.PartOfRepresentation(options);
 
             bool exists = object.has_value();
-            Interface<bool>().ToBinary(exists, output, options, next_state);
+            child.template ToBinary<bool>(exists, output, options, next_state);
             if (exists)
-                Interface<elem_t>().ToBinary(*object, output, options, next_state);
+                child.template ToBinary<elem_t>(*object, output, options, next_state);
         }
 
-        void FromBinary(T &object, Stream::Input &input, const FromBinaryOptions &options, impl::FromBinaryState state) const override
+        template <typename Child>
+        static void FromBinaryImpl(const Child &child, T &object, Stream::Input &input, const FromBinaryOptions &options, impl::FromBinaryState state)
         {
             auto next_state = state.PartOfRepresentation(options);
 
             bool exists = 0;
-            Interface<bool>().FromBinary(exists, input, options, next_state);
+            child.template FromBinary<bool>(exists, input, options, next_state);
             if (!exists)
             {
                 object = {};
@@ -82,7 +108,7 @@ namespace Refl
                 Program::Error(input.GetExceptionPrefix() + e.what());
             }
 
-            Interface<elem_t>().FromBinary(*object, input, options, next_state);
+            child.template FromBinary<elem_t>(*object, input, options, next_state);
         }
     };
 
@@ -3,7 +3,9 @@
 #include <cstddef>
 #include <cstdint>
 #include <exception>
+#include <iterator>
 #include <string>
+#include <string_view>
 #include <type_traits>
 
 #include "program/errors.h"
@@ -36,6 +38,33 @@ namespace Refl
             (void)state;
 
             input.Discard('"');
+
+            // If the input is in memory, unescape the string directly from it.
+            if (std::string_view memory = input.RemainingMemory(); memory.size() > 0)
+            {
+                std::size_t len = 0;
+                while (len < memory.size() && memory[len] != '"')
+                    len += memory[len] == '\\' ? 2 : 1;
+
+                // If the string is unterminated, the loop below reports it.
+                if (len < memory.size())
+                {
+                    input.Skip(len + 1);
+
+                    object.clear();
+                    object.reserve(len); // Unescaping never makes the string longer.
+                    try
+                    {
+                        Strings::Unescape(memory.substr(0, len), std::back_inserter(object));
+                    }
+                    catch (std::exception &e)
+                    {
+                        Program::Error(input.GetExceptionPrefix() + e.what());
+                    }
+                    return;
+                }
+            }
+
             std::string temp_str;
             while (true)
             {
@@ -79,10 +108,16 @@ namespace Refl
             if (Robust::conversion_fails(input.ReadWithByteOrder<impl::container_length_binary_t>(impl::container_length_byte_order), len))
                 Program::Error(input.GetExceptionPrefix() + "The string is too long.");
 
+            // The string is read in chunks, to not allocate too much memory if the length is malformed.
             object = {};
-            object.reserve(len < options.max_reserved_size ? len : options.max_reserved_size);
-            while (len-- > 0)
-                object += input.ReadChar();
+            while (len > 0)
+            {
+                std::size_t chunk = len < options.max_reserved_size ? len : options.max_reserved_size;
+                std::size_t old_size = object.size();
+                object.resize(old_size + chunk);
+                input.Read(object.data() + old_size, chunk);
+                len -= chunk;
+            }
         }
     };
 
@@ -4,6 +4,8 @@
 #include <cstdint>
 #include <exception>
 #include <limits>
+#include <string>
+#include <string_view>
 #include <type_traits>
 #include <variant>
 
@@ -44,11 +46,34 @@ namespace Refl
 
       public:
         void ToString(const T &object, Stream::Output &output, const ToStringOptions &options, impl::ToStringState state) const override
+        {
+            ToStringImpl(impl::VirtualDispatch{}, object, output, options, state);
+        }
+
+        void FromString(T &object, Stream::Input &input, const FromStringOptions &options, impl::FromStringState state) const override
+        {
+            FromStringImpl(impl::VirtualDispatch{}, object, input, options, state);
+        }
+
+        void ToBinary(const T &object, Stream::Output &output, const ToBinaryOptions &options, impl::ToBinaryState state) const override
+        {
+            ToBinaryImpl(impl::VirtualDispatch{}, object, output, options, state);
+        }
+
+        void FromBinary(T &object, Stream::Input &input, const FromBinaryOptions &options, impl::FromBinaryState state) const override
+        {
+            FromBinaryImpl(impl::VirtualDispatch{}, object, input, options, state);
+        }
+
+        // The implementations of the functions above. `child` determines how the alternatives are processed, see `impl::VirtualDispatch`.
+
+        template <typename Child>
+        static void ToStringImpl(const Child &child, const T &object, Stream::Output &output, const ToStringOptions &options, impl::ToStringState state)
         {
             if (object.valueless_by_exception())
                 Program::Error(output.GetExceptionPrefix() + "Unable to serialize variant: Valueless by exception.");
 
-            Meta::with_cexpr_value<std::variant_size_v<T>>(object.index(), [&](auto index)
+            child.template WithIndex<std::variant_size_v<T>>(object.index(), [&](auto index)
             {
                 constexpr auto i = index.value;
                 using this_type = std::variant_alternative_t<i, T>;
@@ -56,20 +81,22 @@ namespace Refl
                 output.WriteString(Class::name<this_type>);
                 if (options.pretty)
                     output.WriteChar(' ');
-                Interface<this_type>().ToString(std::get<i>(object), output, options, state.PartOfRepresentation(options));
+                child.template ToString<this_type>(std::get<i>(object), output, options, state.PartOfRepresentation(options));
             });
         }
 
-        void FromString(T &object, Stream::Input &input, const FromStringOptions &options, impl::FromStringState state) const override
+        template <typename Child>
+        static void FromStringImpl(const Child &child, T &object, Stream::Input &input, const FromStringOptions &options, impl::FromStringState state)
         {
-            std::string name = input.Extract(Stream::Char::SeqIdentifier{});
-            std::size_t index = Utils::GetStringIndex<ElemNames>(name.c_str());
+            std::string name_storage;
+            std::string_view name = input.ExtractView(Stream::Char::SeqIdentifier{}, name_storage);
+            std::size_t index = Utils::GetStringIndex<ElemNames>(name);
             if (index == std::size_t(-1))
-                Program::Error(input.GetExceptionPrefix() + "Unknown variant alternative name: `" + name + "`.");
+                Program::Error(input.GetExceptionPrefix() + "Unknown variant alternative name: `" + std::string(name) + "`.");
 
             Utils::SkipWhitespaceAndComments(input);
 
-            Meta::with_cexpr_value<std::variant_size_v<T>>(index, [&](auto index)
+            child.template WithIndex<std::variant_size_v<T>>(index, [&](auto index)
             {
                 constexpr auto i = index.value;
                 using this_type = std::variant_alternative_t<i, T>;
@@ -84,11 +111,12 @@ namespace Refl
                     Program::Error(input.GetExceptionPrefix() + e.what());
                 }
 
-                Interface<this_type>().FromString(*ptr, input, options, state.PartOfRepresentation(options));
+                child.template FromString<this_type>(*ptr, input, options, state.PartOfRepresentation(options));
             });
         }
 
-        void ToBinary(const T &object, Stream::Output &output, const ToBinaryOptions &options, impl::ToBinaryState state) const override
+        template <typename Child>
+        static void ToBinaryImpl(const Child &child, const T &object, Stream::Output &output, const ToBinaryOptions &options, impl::ToBinaryState state)
         {
             if (object.valueless_by_exception())
                 Program::Error(output.GetExceptionPrefix() + "Unable to serialize variant: Valueless by exception.");
@@ -96,21 +124,22 @@ namespace Refl
             impl::variant_index_binary_t index = object.index(); // No range validation is necessary, since we have a static_assert.
             output.WriteWithByteOrder<impl::variant_index_binary_t>(impl::variant_index_byte_order, index);
 
-            Meta::with_cexpr_value<std::variant_size_v<T>>(index, [&](auto index)
+            child.template WithIndex<std::variant_size_v<T>>(index, [&](auto index)
             {
                 constexpr auto i = index.value;
                 using this_type = std::variant_alternative_t<i, T>;
-                Interface<this_type>().ToBinary(std::get<i>(object), output, options, state.PartOfRepresentation(options));
+                child.template ToBinary<this_type>(std::get<i>(object), output, options, state.PartOfRepresentation(options));
             });
         }
 
-        void FromBinary(T &object, Stream::Input &input, const FromBinaryOptions &options, impl::FromBinaryState state) const override
+        template <typename Child>
+        static void FromBinaryImpl(const Child &child, T &object, Stream::Input &input, const FromBinaryOptions &options, impl::FromBinaryState state)
         {
             auto index = input.ReadWithByteOrder<impl::variant_index_binary_t>(impl::variant_index_byte_order);
             if (Robust::greater_eq(index, std::variant_size_v<T>))
                 Program::Error(input.GetExceptionPrefix() + "Variant alternative index is too large.");
 
-            Meta::with_cexpr_value<std::variant_size_v<T>>(index, [&](auto index)
+            child.template WithIndex<std::variant_size_v<T>>(index, [&](auto index)
             {
                 constexpr auto i = index.value;
                 using this_type = std::variant_alternative_t<i, T>;
@@ -125,7 +154,7 @@ namespace Refl
                     Program::Error(input.GetExceptionPrefix() + e.what());
                 }
 
-                Interface<this_type>().FromBinary(*ptr, input, options, state.PartOfRepresentation(options));
+                child.template FromBinary<this_type>(*ptr, input, options, state.PartOfRepresentation(options));
             });
         }
     };
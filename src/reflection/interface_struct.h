@@ -5,6 +5,7 @@
 #include <cctype>
 #include <cstddef>
 #include <exception>
+#include <string>
 #include <string_view>
 #include <type_traits>
 #include <utility>
@@ -64,6 +65,29 @@ namespace Refl
     {
       public:
         void ToString(const T &object, Stream::Output &output, const ToStringOptions &options, impl::ToStringState state) const override
+        {
+            ToStringImpl(impl::VirtualDispatch{}, object, output, options, state);
+        }
+
+        void FromString(T &object, Stream::Input &input, const FromStringOptions &options, impl::FromStringState state) const override
+        {
+            FromStringImpl(impl::VirtualDispatch{}, object, input, options, state);
+        }
+
+        void ToBinary(const T &object, Stream::Output &output, const ToBinaryOptions &options, impl::ToBinaryState state) const override
+        {
+            ToBinaryImpl(impl::VirtualDispatch{}, object, output, options, state);
+        }
+
+        void FromBinary(T &object, Stream::Input &input, const FromBinaryOptions &options, impl::FromBinaryState state) const override
+        {
+            FromBinaryImpl(impl::VirtualDispatch{}, object, input, options, state);
+        }
+
+        // The implementations of the functions above. `child` determines how the bases and the members are processed, see `impl::VirtualDispatch`.
+
+        template <typename Child>
+        static void ToStringImpl(const Child &child, const T &object, Stream::Output &output, const ToStringOptions &options, impl::ToStringState state)
         {
             static_assert(Class::members_known<T>, "Can't convert T to string: its members are not reflected.");
 
@@ -138,7 +162,7 @@ namespace Refl
 
                     // We use a pointer cast instead of a reference one to catch cases where the derived class doesn't actually inherit from this base, but merely overloads the conversion operator.
                     const base_type &base_ref = *static_cast<const base_type *>(&object);
-                    Refl::Interface(base_ref).ToString(base_ref, output, options, next_base_state); // A qualified call prevents unwanted ADL.
+                    child.ToString(base_ref, output, options, next_base_state);
                 }
             };
 
@@ -181,7 +205,7 @@ namespace Refl
                             output.WriteChar('=');
                     }
 
-                    Refl::Interface(ref).ToString(ref, output, options, next_member_state); // A qualified call prevents unwanted ADL.
+                    child.ToString(ref, output, options, next_member_state);
                 }
             });
 
@@ -192,7 +216,8 @@ namespace Refl
             output.WriteChar(")}"[named_members]);
         }
 
-        void FromString(T &object, Stream::Input &input, const FromStringOptions &options, impl::FromStringState state) const override
+        template <typename Child>
+        static void FromStringImpl(const Child &child, T &object, Stream::Input &input, const FromStringOptions &options, impl::FromStringState state)
         {
             static_assert(Class::members_known<T>, "Can't convert string to T: its members are not reflected.");
 
@@ -223,8 +248,9 @@ namespace Refl
                     if (input.Discard<Stream::if_present>('}'))
                         break;
 
-                    // Get member or base name.
-                    std::string name = input.Extract(Stream::Char::SeqIdentifier{});
+                    // Get member or base name. If possible, this is a view into the input, to avoid copying it.
+                    std::string name_storage;
+                    std::string_view name = input.ExtractView(Stream::Char::SeqIdentifier{}, name_storage);
                     Utils::SkipWhitespaceAndComments(input);
 
                     char first_char = input.PeekChar();
@@ -235,28 +261,28 @@ namespace Refl
                         // We got a base class.
                         std::size_t base_index = Class::CombinedBaseIndex<T>(name);
                         if (base_index == std::size_t(-1))
-                            Program::Error(input.GetExceptionPrefix() + "Unknown base class: `" + name + "`.");
+                            Program::Error(input.GetExceptionPrefix() + "Unknown base class: `" + std::string(name) + "`.");
 
-                        Meta::with_cexpr_value<combined_base_count>(base_index, [&](auto index)
+                        child.template WithIndex<combined_base_count>(base_index, [&](auto index)
                         {
                             constexpr auto i = index.value;
                             if (!state.NeedVirtualBases() && i >= Meta::list_size<Class::bases<T>>)
-                                Program::Error(input.GetExceptionPrefix() + "Virtual base class `" + name + "` must be mentioned in the most derived class, not here.");
+                                Program::Error(input.GetExceptionPrefix() + "Virtual base class `" + std::string(name) + "` must be mentioned in the most derived class, not here.");
 
                             if (obtained_bases[i])
-                                Program::Error(input.GetExceptionPrefix() + "Base class mentioned more than once: `" + name + "`.");
+                                Program::Error(input.GetExceptionPrefix() + "Base class mentioned more than once: `" + std::string(name) + "`.");
 
                             using this_base = Meta::list_type_at<combined_bases, i>;
 
                             if constexpr (impl::Class::skip_base<this_base>)
                             {
-                                Program::Error(input.GetExceptionPrefix() + "Empty base class is mentioned: `" + name + "`.");
+                                Program::Error(input.GetExceptionPrefix() + "Empty base class is mentioned: `" + std::string(name) + "`.");
                             }
                             else
                             {
                                 // We use a pointer cast instead of a reference one to catch cases where the derived class doesn't actually inherit from this base, but merely overloads the conversion operator.
                                 auto &base_ref = *static_cast<this_base *>(&object);
-                                Interface<this_base>().FromString(base_ref, input, options, next_base_state);
+                                child.FromString(base_ref, input, options, next_base_state);
 
                                 obtained_bases[i] = true;
                             }
@@ -270,22 +296,22 @@ namespace Refl
 
                         std::size_t member_index = Class::MemberIndex<T>(name);
                         if (member_index == std::size_t(-1))
-                            Program::Error(input.GetExceptionPrefix() + "Unknown field: `" + name + "`.");
+                            Program::Error(input.GetExceptionPrefix() + "Unknown field: `" + std::string(name) + "`.");
 
-                        Meta::with_cexpr_value<Class::member_count<T>>(member_index, [&](auto index)
+                        child.template WithIndex<Class::member_count<T>>(member_index, [&](auto index)
                         {
                             constexpr auto i = index.value;
                             if (obtained_members[i])
-                                Program::Error(input.GetExceptionPrefix() + "Field mentioned more than once: `" + name + "`.");
+                                Program::Error(input.GetExceptionPrefix() + "Field mentioned more than once: `" + std::string(name) + "`.");
 
                             if constexpr (impl::Class::skip_member<Class::member_type<T, i>>)
                             {
-                                Program::Error(input.GetExceptionPrefix() + "Empty field is mentioned: `" + name + "`.");
+                                Program::Error(input.GetExceptionPrefix() + "Empty field is mentioned: `" + std::string(name) + "`.");
                             }
                             else
                             {
                                 auto &member_ref = Class::Member<i>(object);
-                                Refl::Interface(member_ref).FromString(member_ref, input, options, next_member_state); // A qualified call prevents unwanted ADL.
+                                child.FromString(member_ref, input, options, next_member_state);
 
                                 obtained_members[i] = true;
                             }
@@ -354,7 +380,7 @@ namespace Refl
                         Utils::SkipWhitespaceAndComments(input);
                     }
 
-                    Refl::Interface(ref).FromString(ref, input, options, next_state); // A qualified call prevents unwanted ADL.
+                    child.FromString(ref, input, options, next_state);
                 };
 
                 // Read virtual bases.
@@ -396,14 +422,15 @@ namespace Refl
             }
         }
 
-        void ToBinary(const T &object, Stream::Output &output, const ToBinaryOptions &options, impl::ToBinaryState state) const override
+        template <typename Child>
+        static void ToBinaryImpl(const Child &child, const T &object, Stream::Output &output, const ToBinaryOptions &options, impl::ToBinaryState state)
         {
             auto next_member_state = state.MemberOrElem(options);
             auto next_base_state = state.BaseClass(options);
 
             auto WriteEntry = [&](auto &ref, decltype(next_member_state) next_state)
             {
-                Refl::Interface(ref).ToBinary(ref, output, options, next_state); // A qualified call prevents unwanted ADL.
+                child.ToBinary(ref, output, options, next_state);
             };
 
             // Write virtual bases.
@@ -439,14 +466,15 @@ namespace Refl
             });
         }
 
-        void FromBinary(T &object, Stream::Input &input, const FromBinaryOptions &options, impl::FromBinaryState state) const override
+        template <typename Child>
+        static void FromBinaryImpl(const Child &child, T &object, Stream::Input &input, const FromBinaryOptions &options, impl::FromBinaryState state)
         {
             auto next_member_state = state.MemberOrElem(options);
             auto next_base_state = state.BaseClass(options);
 
             auto ReadEntry = [&](auto &ref, decltype(next_member_state) next_state)
             {
-                Refl::Interface(ref).FromBinary(ref, input, options, next_state); // A qualified call prevents unwanted ADL.
+                child.FromBinary(ref, input, options, next_state);
             };
 
             // Write virtual bases.
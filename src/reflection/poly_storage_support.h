@@ -1,9 +1,11 @@
 #pragma once
 
 #include <limits>
+#include <string_view>
 
 #include "meta/type_info.h"
 #include "reflection/full.h"
+#include "reflection/inline.h"
 #include "utils/poly_storage.h"
 
 namespace Refl
@@ -104,24 +106,26 @@ namespace Refl
 
                             zrefl_Name = Class::name<Derived>;
 
+                            // Those are the only type-erased calls needed for the derived classes. Everything below them is dispatched at compile-time.
+
                             zrefl_ToString = [](const PolyStorage &object, Stream::Output &output, const ToStringOptions &options, Refl::impl::ToStringState state)
                             {
-                                Interface<Derived>().ToString(object.template derived<Derived>(), output, options, state.PartOfRepresentation(options));
+                                Refl::impl::InlineDispatch{}.ToString(object.template derived<Derived>(), output, options, state.PartOfRepresentation(options));
                             };
 
                             zrefl_FromString = [](PolyStorage &object, Stream::Input &output, const FromStringOptions &options, Refl::impl::FromStringState state)
                             {
-                                Interface<Derived>().FromString(object.template derived<Derived>(), output, options, state.PartOfRepresentation(options));
+                                Refl::impl::InlineDispatch{}.FromString(object.template derived<Derived>(), output, options, state.PartOfRepresentation(options));
                             };
 
                             zrefl_ToBinary = [](const PolyStorage &object, Stream::Output &output, const ToBinaryOptions &options, Refl::impl::ToBinaryState state)
                             {
-                                Interface<Derived>().ToBinary(object.template derived<Derived>(), output, options, state.PartOfRepresentation(options));
+                                Refl::impl::InlineDispatch{}.ToBinary(object.template derived<Derived>(), output, options, state.PartOfRepresentation(options));
                             };
 
                             zrefl_FromBinary = [](PolyStorage &object, Stream::Input &output, const FromBinaryOptions &options, Refl::impl::FromBinaryState state)
                             {
-                                Interface<Derived>().FromBinary(object.template derived<Derived>(), output, options, state.PartOfRepresentation(options));
+                                Refl::impl::InlineDispatch{}.FromBinary(object.template derived<Derived>(), output, options, state.PartOfRepresentation(options));
                             };
                         }
                     };
@@ -168,6 +172,10 @@ namespace Refl
                     // Once the list is finalized, these contain indices of the derived classes.
                     template <typename Derived> inline static std::size_t derived_class_index = -1;
 
+                    // Once the list is finalized, this maps the class names to their indices.
+                    // This isn't wrapped in a function like the list, since it's constant-initialized and is only used after the finalization.
+                    inline static Utils::DynamicStringTable name_table;
+
 
                     // Register this base class.
                     static void RegisterThisBaseIfNeeded()
@@ -191,6 +199,13 @@ namespace Refl
                             Program::HardError("Duplicate derived class `", dupe_it->name, "` registered for base `", Meta::TypeName<Base>(), "`.");
                         for (std::size_t i = 0; i < list.size(); i++)
                             *list[i].index_location = i;
+
+                        std::vector<const char *> names;
+                        names.reserve(list.size());
+                        for (const NameToFunc &elem : list)
+                            names.push_back(elem.name);
+                        if (!name_table.Assign(names))
+                            Program::HardError("Unable to build the class name table for polymorphic base `", Meta::TypeName<Base>(), "`.");
                     }
 
 
@@ -224,19 +239,15 @@ namespace Refl
                     // Converts a class name to its index.
                     // This assumes the list is already finalized.
                     // If the name is invalid, returns -1.
-                    static std::size_t ClassNameToIndexIfValid(const char *name)
+                    static std::size_t ClassNameToIndexIfValid(std::string_view name)
                     {
-                        auto &list = NameToFuncList();
-                        auto it = std::lower_bound(list.begin(), list.end(), name);
-                        if (it == list.end() || *it != name)
-                            return -1;
-                        return it - list.begin();
+                        return name_table.Find(name);
                     }
 
                     // Converts a class name to its index.
                     // This assumes the list is already finalized.
                     // Throws if the name is invalid.
-                    static std::size_t ClassNameToIndex(const char *name)
+                    static std::size_t ClassNameToIndex(std::string_view name)
                     {
                         std::size_t ret = ClassNameToIndexIfValid(name);
                         if (ret == std::size_t(-1))
@@ -298,14 +309,14 @@ namespace Refl
 
                 // Returns the index of the class named `name`, derived from `Base`.
                 // Throws of failure.
-                template <typename Base> static std::size_t NameToIndex(const char *name)
+                template <typename Base> static std::size_t NameToIndex(std::string_view name)
                 {
                     return BaseData<Base>::ClassNameToIndex(name);
                 }
 
                 // Returns the index of the class named `name`, derived from `Base`.
                 // Returns -1 on failure.
-                template <typename Base> static std::size_t NameToIndexIfValid(const char *name)
+                template <typename Base> static std::size_t NameToIndexIfValid(std::string_view name)
                 {
                     return BaseData<Base>::ClassNameToIndexIfValid(name);
                 }
@@ -380,37 +391,25 @@ namespace Refl
 
         // Returns the index of the class named `name`, derived from `T`.
         // Throws on failure.
-        template <typename T> [[nodiscard]] std::size_t NameToIndex(const char *name)
+        template <typename T> [[nodiscard]] std::size_t NameToIndex(std::string_view name)
         {
             impl::Data::FinalizeIfNeeded();
             return impl::Data::NameToIndex<T>(name);
         }
-        template <typename T> [[nodiscard]] std::size_t NameToIndex(const std::string &name)
-        {
-            return NameToIndex<T>(name.c_str());
-        }
 
         // Returns the index of the class named `name`, derived from `T`.
         // Returns `-1` if the name is invalid.
-        template <typename T> [[nodiscard]] std::size_t NameToIndexIfValid(const char *name)
+        template <typename T> [[nodiscard]] std::size_t NameToIndexIfValid(std::string_view name)
         {
             impl::Data::FinalizeIfNeeded();
             return impl::Data::NameToIndexIfValid<T>(name);
         }
-        template <typename T> [[nodiscard]] std::size_t NameToIndexIfValid(const std::string &name)
-        {
-            return NameToIndexIfValid<T>(name.c_str());
-        }
 
         // Checks if there's a reflected class named `name`, derived from `T`.
-        template <typename T> [[nodiscard]] bool NameIsValid(const char *name)
+        template <typename T> [[nodiscard]] bool NameIsValid(std::string_view name)
         {
             return NameToIndexIfValid<T>(name) != std::size_t(-1);
         }
-        template <typename T> [[nodiscard]] bool NameIsValid(const std::string &name)
-        {
-            return NameIsValid<T>(name);
-        }
 
         // Constructs an object given its index.
         // Throws if the index is invalid or if the constructor throws.
@@ -426,13 +425,15 @@ namespace Refl
         // Constructs an object given its name.
         // Throws if the name is invalid or if the constructor throws.
         // Passing a null pointer as the name causes a null object to be returned.
-        template <typename T> [[nodiscard]] PolyStorage<T> ConstructFromName(const char *name)
+        template <typename T> [[nodiscard]] PolyStorage<T> ConstructFromName(std::string_view name)
         {
             return ConstructFromIndex<T>(NameToIndex<T>(name));
         }
-        template <typename T> [[nodiscard]] PolyStorage<T> ConstructFromName(const std::string &name)
+        template <typename T> [[nodiscard]] PolyStorage<T> ConstructFromName(const char *name)
         {
-            return ConstructFromName<T>(name.c_str());
+            if (!name)
+                return nullptr;
+            return ConstructFromName<T>(std::string_view(name));
         }
     }
 
@@ -463,11 +464,12 @@ namespace Refl
 
         void FromString(T &object, Stream::Input &input, const FromStringOptions &options, impl::FromStringState state) const override
         {
-            std::string name = input.Extract(Stream::Char::Is("class name", [](char ch)
+            std::string name_storage;
+            std::string_view name = input.ExtractView(Stream::Char::Is("class name", [](char ch)
             {
                 // We would use `Stream::Char::SeqIdentifier{}`, but it rejects `0`.
                 return Stream::Char::IsAlphaOrDigit{}(ch) || ch == '_';
-            }));
+            }), name_storage);
 
             if (name == "0")
             {
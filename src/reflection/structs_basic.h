@@ -4,6 +4,7 @@
 #include <array>
 #include <cstring>
 #include <string>
+#include <string_view>
 #include <tuple>
 #include <type_traits>
 #include <utility>
@@ -413,31 +414,26 @@ namespace Refl
 
         // Those convert {member|base|virtual base} name to its index.
         // If there is no such entry, -1 is returned.
-        // If a class has several entries with the same name, using corresponding function will cause an assertion at program startup.
-        // (When we get C++20 constexpr algorithms, we can move that assertion to compile-time).
-        template <typename T> [[nodiscard]] std::size_t MemberIndex(const char *name)
+        // The lookup tables are built at compile-time (see `Utils::GetStringIndex`). If a class has several entries with the same name,
+        // using corresponding function causes a compile-time error.
+        template <typename T> [[nodiscard]] std::size_t MemberIndex(std::string_view name)
         {
             // Note that `remove_const_t` is necessary here, but not in the other three functions.
             return Utils::GetStringIndex<impl::StringList_Members<std::remove_const_t<T>>>(name);
         }
-        template <typename T> [[nodiscard]] std::size_t BaseIndex(const char *name)
+        template <typename T> [[nodiscard]] std::size_t BaseIndex(std::string_view name)
         {
             return Utils::GetStringIndex<impl::StringList_Classes<bases<T>>>(name);
         }
-        template <typename T> [[nodiscard]] std::size_t VirtualBaseIndex(const char *name)
+        template <typename T> [[nodiscard]] std::size_t VirtualBaseIndex(std::string_view name)
         {
             return Utils::GetStringIndex<impl::StringList_Classes<virtual_bases<T>>>(name);
         }
-        template <typename T> [[nodiscard]] std::size_t CombinedBaseIndex(const char *name)
+        template <typename T> [[nodiscard]] std::size_t CombinedBaseIndex(std::string_view name)
         {
             // Concatenates `bases<T>` and `virtual_bases<T>` and returns the index in the combined list.
             return Utils::GetStringIndex<impl::StringList_Classes<Meta::list_cat<bases<T>, virtual_bases<T>>>>(name);
         }
-
-        template <typename T> [[nodiscard]] std::size_t MemberIndex      (const std::string &name) {return MemberIndex      <T>(name.c_str());}
-        template <typename T> [[nodiscard]] std::size_t BaseIndex        (const std::string &name) {return BaseIndex        <T>(name.c_str());}
-        template <typename T> [[nodiscard]] std::size_t VirtualBaseIndex (const std::string &name) {return VirtualBaseIndex <T>(name.c_str());}
-        template <typename T> [[nodiscard]] std::size_t CombinedBaseIndex(const std::string &name) {return CombinedBaseIndex<T>(name.c_str());}
     }
 
     namespace Polymorphic::impl
@@ -3,7 +3,12 @@
 #include <algorithm>
 #include <array>
 #include <cstddef>
+#include <cstdint>
+#include <memory>
 #include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
 
 #include "program/errors.h"
 #include "stream/input.h"
@@ -89,6 +94,265 @@ namespace Refl::Utils
         return !first;
     }
 
+    namespace impl
+    {
+        // Advances `cur` past any whitespace and comments, same as `SkipWhitespaceAndComments()`.
+        // Returns false if there is an unterminated `/*` comment.
+        [[nodiscard]] inline bool SkipWhitespaceAndCommentsInMemory(const char *&cur, const char *end)
+        {
+            while (cur != end)
+            {
+                char ch = *cur;
+                if (ch == ' ' || ch == '\n' || ch == '\r' || ch == '\t' || ch == '\v' || ch == '\f')
+                {
+                    cur++;
+                }
+                else if (ch == '/' && end - cur >= 2 && cur[1] == '/')
+                {
+                    while (cur != end && *cur != '\r' && *cur != '\n')
+                        cur++;
+                }
+                else if (ch == '/' && end - cur >= 2 && cur[1] == '*')
+                {
+                    std::string_view rest(cur + 2, end - cur - 2);
+                    std::size_t comment_end = rest.find("*/");
+                    if (comment_end == std::string_view::npos)
+                        return false;
+                    cur += 2 + comment_end + 2;
+                }
+                else
+                {
+                    break;
+                }
+            }
+            return true;
+        }
+
+        // The characters that `ValueLengthInMemory()` can skip in bulk: everything except whitespace, brackets, quotes, commas, and slashes.
+        inline constexpr std::array<bool, 256> plain_value_chars = []{
+            std::array<bool, 256> ret{};
+            for (bool &x : ret)
+                x = true;
+            for (unsigned char ch : std::string_view(" \n\r\t\v\f{}[]()\",/"))
+                ret[ch] = false;
+            return ret;
+        }();
+
+        // Returns the length of the value at the beginning of `str`, following the same rules as `SkipValue()`.
+        // Returns 0 if the value is malformed, then `SkipValue()` has to be used to get a proper error message.
+        // This works directly on the memory, which is much faster than going through `Stream::Input`.
+        [[nodiscard]] inline std::size_t ValueLengthInMemory(std::string_view str)
+        {
+            const char *cur = str.data(), *end = str.data() + str.size();
+
+            std::string brackets; // Closing brackets we expect to see, innermost last.
+            bool empty = true;
+
+            while (1)
+            {
+                // Remember where the value ends, to not consume trailing whitespace.
+                const char *value_end = cur;
+
+                if (!SkipWhitespaceAndCommentsInMemory(cur, end))
+                    return 0;
+
+                if (cur == end)
+                {
+                    if (brackets.size() > 0)
+                        return 0;
+                    cur = value_end;
+                    break;
+                }
+
+                char ch = *cur;
+
+                if (ch == ',' && brackets.empty())
+                {
+                    cur = value_end;
+                    break;
+                }
+
+                if (ch == '}' || ch == ']' || ch == ')')
+                {
+                    if (brackets.empty())
+                    {
+                        cur = value_end;
+                        break;
+                    }
+                    if (ch != brackets.back())
+                        return 0;
+
+                    cur++;
+                    brackets.pop_back();
+                    if (brackets.empty())
+                        break;
+                    continue;
+                }
+
+                empty = false;
+                cur++;
+
+                switch (ch)
+                {
+                  case '{':
+                    brackets += '}';
+                    break;
+                  case '[':
+                    brackets += ']';
+                    break;
+                  case '(':
+                    brackets += ')';
+                    break;
+                  case '"':
+                    while (1)
+                    {
+                        if (cur == end)
+                            return 0;
+                        char str_ch = *cur++;
+                        if (str_ch == '"')
+                            break;
+                        if (str_ch == '\\')
+                        {
+                            if (cur == end)
+                                return 0;
+                            cur++;
+                        }
+                    }
+                    break;
+                  default:
+                    // Skip the rest of the token at once. The loop would do the same, but slower.
+                    while (cur != end && plain_value_chars[(unsigned char)*cur])
+                        cur++;
+                    break;
+                }
+            }
+
+            if (empty)
+                return 0;
+            return cur - str.data();
+        }
+
+        // Finds the elements of a list in the text format. `str` should start right after the opening `[`.
+        // The elements are skipped with `ValueLengthInMemory()`, the rest follows the same rules as `Interface_BasicContainer::FromString()`.
+        // Appends the element boundaries (relative to `str`) to `elements`. Returns the offset right after the closing `]`, or 0 if the list is malformed.
+        [[nodiscard]] inline std::size_t ListElementsInMemory(std::string_view str, std::vector<std::pair<std::size_t, std::size_t>> &elements)
+        {
+            const char *begin = str.data(), *cur = begin, *end = begin + str.size();
+
+            while (1)
+            {
+                if (!SkipWhitespaceAndCommentsInMemory(cur, end) || cur == end)
+                    return 0;
+                if (*cur == ']')
+                    return cur + 1 - begin;
+
+                std::size_t len = ValueLengthInMemory(std::string_view(cur, end - cur));
+                if (len == 0)
+                    return 0;
+                elements.push_back({std::size_t(cur - begin), std::size_t(cur - begin + len)});
+                cur += len;
+
+                if (!SkipWhitespaceAndCommentsInMemory(cur, end) || cur == end)
+                    return 0;
+                if (*cur == ']')
+                    return cur + 1 - begin;
+                if (*cur != ',')
+                    return 0;
+                cur++;
+            }
+        }
+    }
+
+    // Skips a single value in the text format without parsing it.
+    // Only checks that the brackets are balanced and that the strings are terminated. Doesn't skip trailing whitespace.
+    // Stops before a comma or an unmatched closing bracket, or after the bracket that closes the value.
+    inline void SkipValue(Stream::Input &input)
+    {
+        // If the input is in memory, try the fast path first.
+        if (std::size_t len = impl::ValueLengthInMemory(input.RemainingMemory()))
+        {
+            input.Skip(len);
+            return;
+        }
+
+        auto start_pos = input.Position();
+
+        std::string brackets; // Closing brackets we expect to see, innermost last.
+        bool empty = true;
+
+        while (1)
+        {
+            // Remember where the value ends, to not consume trailing whitespace.
+            auto end_pos = input.Position();
+            Utils::SkipWhitespaceAndComments(input);
+
+            if (!input.MoreData())
+            {
+                if (brackets.size() > 0)
+                    Program::Error(input.GetExceptionPrefix() + "Expected `" + brackets.back() + "`.");
+                input.Seek(end_pos, Stream::absolute);
+                break;
+            }
+
+            char ch = input.PeekChar();
+
+            if (ch == ',' && brackets.empty())
+            {
+                input.Seek(end_pos, Stream::absolute);
+                break;
+            }
+
+            if (ch == '}' || ch == ']' || ch == ')')
+            {
+                if (brackets.empty())
+                {
+                    input.Seek(end_pos, Stream::absolute);
+                    break;
+                }
+                if (ch != brackets.back())
+                    Program::Error(input.GetExceptionPrefix() + "Expected `" + brackets.back() + "`.");
+
+                input.SkipOne();
+                brackets.pop_back();
+                if (brackets.empty())
+                    break;
+                continue;
+            }
+
+            empty = false;
+            input.SkipOne();
+
+            switch (ch)
+            {
+              case '{':
+                brackets += '}';
+                break;
+              case '[':
+                brackets += ']';
+                break;
+              case '(':
+                brackets += ')';
+                break;
+              case '"':
+                while (1)
+                {
+                    char str_ch = input.ReadChar();
+                    if (str_ch == '"')
+                        break;
+                    if (str_ch == '\\')
+                        input.SkipOne();
+                }
+                break;
+            }
+        }
+
+        if (empty)
+        {
+            input.Seek(start_pos, Stream::absolute);
+            Program::Error(input.GetExceptionPrefix() + "Expected a value.");
+        }
+    }
+
 
     // Constexpr alternative to `std::strcmp`.
     constexpr int cexpr_strcmp(const char *a, const char *b)
@@ -103,52 +367,229 @@ namespace Refl::Utils
         return (unsigned char)*a - (unsigned char)*b;
     }
 
-    struct NameIndexPair
+    // A constexpr string hash (64-bit FNV-1a). Use `cexpr_hash_mix()` to get the hashes for `PerfectHash` from it.
+    constexpr std::uint64_t cexpr_string_hash(std::string_view str)
+    {
+        std::uint64_t hash = 14695981039346656037u;
+        for (char ch : str)
+        {
+            hash ^= (unsigned char)ch;
+            hash *= 1099511628211u;
+        }
+        return hash;
+    }
+
+    // Makes a hash from `cexpr_string_hash()` result. `seed` selects a hash function from a family.
+    // This is necessary since we only use the low bits, and the low bits of FNV-1a depend only on the low bits of the characters.
+    constexpr std::uint32_t cexpr_hash_mix(std::uint64_t hash, std::uint32_t seed)
+    {
+        // The MurmurHash3 64-bit finalizer.
+        hash ^= seed * 0x9e3779b97f4a7c15u;
+        hash ^= hash >> 33;
+        hash *= 0xff51afd7ed558ccdu;
+        hash ^= hash >> 33;
+        hash *= 0xc4ceb9fe1a85ec53u;
+        hash ^= hash >> 33;
+        return std::uint32_t(hash);
+    }
+
+    // Perfect hashing of string lists, using the "hash and displace" scheme.
+    // A name goes into one of the buckets, according to its hash with seed 0. Each bucket has its own seed, chosen in a way that
+    // the hashes of the names in all buckets, with their respective seeds, don't collide.
+    // Looking up a name costs one pass over the name to hash it, two cheap mixing steps, and one comparison.
+    // `names` is an array-like list of strings (anything convertible to `std::string_view`). `seeds` and `slots` are array-like lists of `std::uint32_t`, of the same power-of-two size,
+    // not less than the amount of names. After building, `slots` contains the index of the name in each slot, or -1 for unused slots.
+    namespace PerfectHash
+    {
+        inline constexpr std::uint32_t max_seed = 1 << 16; // If we can't place a bucket using a seed less than this, we give up.
+
+        // Returns a table size for `count` names. Keeping the table at most half full makes finding the seeds fast.
+        constexpr std::size_t TableSize(std::size_t count)
+        {
+            std::size_t ret = 1;
+            while (ret < count * 2)
+                ret *= 2;
+            return ret;
+        }
+
+        // Returns false if the names contain duplicates, or if we failed to find the seeds (this shouldn't happen). Then `slots` is left in an unspecified state.
+        // `order` and `bucket_starts` are temporary storage, of sizes `names.size()` and `seeds.size() + 1` respectively.
+        template <typename A, typename B, typename C, typename D, typename E>
+        constexpr bool Build(const A &names, B &seeds, C &slots, D &order, E &bucket_starts)
+        {
+            std::size_t count = names.size();
+            std::size_t size = seeds.size();
+            std::uint32_t mask = std::uint32_t(size - 1);
+
+            for (std::size_t i = 0; i < count; i++)
+            {
+                for (std::size_t j = 0; j < i; j++)
+                {
+                    if (std::string_view(names[i]) == std::string_view(names[j]))
+                        return false;
+                }
+            }
+
+            // Sort the names by bucket (counting sort).
+            for (std::size_t i = 0; i <= size; i++)
+                bucket_starts[i] = 0;
+            for (std::size_t i = 0; i < count; i++)
+                bucket_starts[(cexpr_hash_mix(cexpr_string_hash(names[i]), 0) & mask) + 1]++;
+            for (std::size_t i = 0; i < size; i++)
+                bucket_starts[i+1] += bucket_starts[i];
+            for (std::size_t i = 0; i < count; i++)
+                order[bucket_starts[cexpr_hash_mix(cexpr_string_hash(names[i]), 0) & mask]++] = i;
+            for (std::size_t i = size; i > 0; i--) // Restore the starting positions, which were shifted by the previous loop.
+                bucket_starts[i] = bucket_starts[i-1];
+            bucket_starts[0] = 0;
+
+            for (std::size_t i = 0; i < size; i++)
+            {
+                seeds[i] = 0;
+                slots[i] = std::uint32_t(-1);
+            }
+
+            // Place the larger buckets first, while there's more free space.
+            for (std::size_t bucket_size = count; bucket_size > 0; bucket_size--)
+            {
+                for (std::size_t bucket = 0; bucket < size; bucket++)
+                {
+                    std::size_t begin = bucket_starts[bucket], end = bucket_starts[bucket+1];
+                    if (end - begin != bucket_size)
+                        continue;
+
+                    for (std::uint32_t seed = 1;; seed++)
+                    {
+                        if (seed >= max_seed)
+                            return false;
+
+                        std::size_t placed = begin;
+                        while (placed < end)
+                        {
+                            std::uint32_t &slot = slots[cexpr_hash_mix(cexpr_string_hash(names[order[placed]]), seed) & mask];
+                            if (slot != std::uint32_t(-1))
+                                break;
+                            slot = std::uint32_t(order[placed]);
+                            placed++;
+                        }
+
+                        if (placed == end)
+                        {
+                            seeds[bucket] = seed;
+                            break;
+                        }
+
+                        // Undo the partial placement.
+                        while (placed-- > begin)
+                            slots[cexpr_hash_mix(cexpr_string_hash(names[order[placed]]), seed) & mask] = std::uint32_t(-1);
+                    }
+                }
+            }
+
+            return true;
+        }
+
+        // Returns the index of `name` in `names`, or -1 if it's not there.
+        template <typename A, typename B, typename C>
+        constexpr std::size_t Find(std::string_view name, const A &names, const B &seeds, const C &slots)
+        {
+            std::uint32_t mask = std::uint32_t(seeds.size() - 1);
+            std::uint64_t hash = cexpr_string_hash(name);
+            std::uint32_t index = slots[cexpr_hash_mix(hash, seeds[cexpr_hash_mix(hash, 0) & mask]) & mask];
+            if (index == std::uint32_t(-1) || name != names[index])
+                return -1;
+            return index;
+        }
+    }
+
+    // A perfect hash table for a list of strings known at compile-time.
+    template <std::size_t N> struct StaticStringTable
     {
-        const char *name = nullptr;
-        std::size_t index = 0;
+        static constexpr std::size_t size = PerfectHash::TableSize(N);
 
-        constexpr NameIndexPair() {}
-        constexpr NameIndexPair(const char *name) : name(name) {}
+        std::array<std::string_view, N> names{}; // Storing the lengths makes the comparison faster.
+        std::array<std::uint32_t, size> seeds{};
+        std::array<std::uint32_t, size> slots{};
+        bool valid = false; // False if the names contain duplicates, or if `PerfectHash::Build()` failed to find the seeds.
 
-        constexpr bool operator==(const NameIndexPair &other) const
+        constexpr StaticStringTable(const std::array<const char *, N> &new_names)
         {
-            return cexpr_strcmp(name, other.name) == 0;
+            for (std::size_t i = 0; i < N; i++)
+                names[i] = new_names[i];
+
+            std::array<std::size_t, N> order{};
+            std::array<std::size_t, size + 1> bucket_starts{};
+            valid = PerfectHash::Build(names, seeds, slots, order, bucket_starts);
         }
-        constexpr bool operator!=(const NameIndexPair &other) const
+
+        // Returns the index of `name`, or -1 if it's not in the list.
+        [[nodiscard]] constexpr std::size_t Find(std::string_view name) const
+        {
+            return PerfectHash::Find(name, names, seeds, slots);
+        }
+    };
+
+    // A perfect hash table for a list of strings known at runtime. The strings are not copied.
+    // The default constructor is constexpr, so a static instance doesn't need dynamic initialization.
+    class DynamicStringTable
+    {
+        template <typename T> struct Array
+        {
+            std::unique_ptr<T[]> data;
+            std::size_t count = 0;
+
+            constexpr Array() {}
+            explicit Array(std::size_t count) : data(std::make_unique<T[]>(count)), count(count) {}
+
+            [[nodiscard]] std::size_t size() const {return count;}
+            [[nodiscard]] T &operator[](std::size_t i) {return data[i];}
+            [[nodiscard]] const T &operator[](std::size_t i) const {return data[i];}
+        };
+
+        Array<std::string_view> names;
+        Array<std::uint32_t> seeds, slots;
+
+      public:
+        constexpr DynamicStringTable() {}
+
+        // Returns false if the names contain duplicates, then the table is left unchanged.
+        [[nodiscard]] bool Assign(const std::vector<const char *> &new_names)
         {
-            return !(*this == other);
+            std::size_t size = PerfectHash::TableSize(new_names.size());
+            DynamicStringTable ret;
+            ret.names = Array<std::string_view>(new_names.size());
+            std::copy(new_names.begin(), new_names.end(), ret.names.data.get());
+            ret.seeds = Array<std::uint32_t>(size);
+            ret.slots = Array<std::uint32_t>(size);
+            std::vector<std::size_t> order(new_names.size()), bucket_starts(size + 1);
+            if (!PerfectHash::Build(ret.names, ret.seeds, ret.slots, order, bucket_starts))
+                return false;
+            *this = std::move(ret);
+            return true;
         }
 
-        constexpr bool operator<(const NameIndexPair &other) const
+        // Returns the index of `name`, or -1 if it's not in the list.
+        [[nodiscard]] std::size_t Find(std::string_view name) const
         {
-            return cexpr_strcmp(name, other.name) < 0;
+            if (names.size() == 0)
+                return -1;
+            return PerfectHash::Find(name, names, seeds, slots);
         }
     };
 
+    namespace impl
+    {
+        template <auto F> inline constexpr StaticStringTable<F().size()> string_table = F();
+    }
+
     // An universal function to look up strings in immutable lists.
     // `F` is a pointer to a constexpr function that returns an array of names: `std::array<const char *, N> (*)(auto index)`.
     // `name` is a name that we're looking for. If it's not found, -1 is returned.
+    // The lookup table is built at compile-time. Having duplicate names in the list is a compile-time error, and so is failing to build the table.
     // Avoid using lambdas as `F`. If you do that in a header, you most likely get an ODR violation.
-    template <auto F> std::size_t GetStringIndex(const char *name)
+    template <auto F> [[nodiscard]] std::size_t GetStringIndex(std::string_view name)
     {
-        static const/*expr*/ auto array = []() /*constexpr*/ // We can make this constexpr as soon as we get a `constexpr` `std::sort` in C++20.
-        {
-            auto name_array = F();
-            std::array<NameIndexPair, name_array.size()> array{};
-            for (std::size_t i = 0; i < array.size(); i++)
-            {
-                array[i].name = name_array[i];
-                array[i].index = i;
-            }
-
-            std::sort(array.begin(), array.end());
-            DebugAssert("Duplicate string in a static list.", std::adjacent_find(array.begin(), array.end()) == array.end());
-            return array;
-        }();
-        auto it = std::lower_bound(array.begin(), array.end(), name);
-        if (it == array.end() || *it != name)
-            return -1;
-        return it->index;
+        static_assert(impl::string_table<F>.valid, "Duplicate string in a static list, or unable to build a perfect hash table for it (see `PerfectHash::max_seed`).");
+        return impl::string_table<F>.Find(name);
     }
 }
@@ -0,0 +1,654 @@
+#pragma once
+
+#include <charconv>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+
+#include "macros/check.h"
+#include "meta/misc.h"
+#include "meta/type_info.h"
+#include "program/errors.h"
+#include "reflection/full.h"
+#include "reflection/utils.h"
+#include "stream/input.h"
+#include "utils/robust_math.h"
+
+// SAX-style reading of serialized objects.
+// Instead of constructing the whole object, the handler is notified about every value in the object tree, and decides
+// what to do with it: read it into an object, enter it (for structs and containers), skip it, or stop reading altogether.
+// This is useful when only a few fields of a large object are needed.
+//
+// The text format is self-describing, so any text can be visited. The binary format isn't, so the type of the root object must be specified.
+
+namespace Refl::Visit
+{
+    enum class Kind
+    {
+        leaf, // Everything that isn't listed below: scalars, strings, enums, null polymorphic objects, and so on.
+        struct_, // `{...}`, a struct with named members.
+        tuple, // `(...)`, a struct with unnamed members.
+        list, // `[...]`, a container.
+    };
+
+    // The location of a value in the object tree, e.g. `steps[2].name`.
+    class Path
+    {
+      public:
+        struct Entry
+        {
+            std::string name; // A member name or a base class name. Empty for container elements and unnamed members.
+            std::size_t index = 0; // Only for container elements and unnamed members.
+
+            [[nodiscard]] bool IsIndex() const
+            {
+                return name.empty();
+            }
+        };
+
+      private:
+        // We don't erase the popped entries, to reuse their string buffers.
+        std::vector<Entry> entries;
+        std::size_t size = 0;
+
+      public:
+        [[nodiscard]] std::size_t Size() const
+        {
+            return size;
+        }
+
+        [[nodiscard]] const Entry &operator[](std::size_t i) const
+        {
+            return entries[i];
+        }
+
+        void Push(std::string_view name)
+        {
+            if (size == entries.size())
+                entries.emplace_back();
+            entries[size].name = name;
+            entries[size].index = 0;
+            size++;
+        }
+
+        void Push(std::size_t index)
+        {
+            if (size == entries.size())
+                entries.emplace_back();
+            entries[size].name.clear();
+            entries[size].index = index;
+            size++;
+        }
+
+        void Pop()
+        {
+            size--;
+        }
+
+        // Returns a string like `steps[2].name`. The root object has an empty path.
+        [[nodiscard]] std::string ToString() const
+        {
+            std::string ret;
+            for (std::size_t i = 0; i < size; i++)
+            {
+                const Entry &entry = entries[i];
+                if (entry.IsIndex())
+                {
+                    ret += '[';
+                    ret += std::to_string(entry.index);
+                    ret += ']';
+                }
+                else
+                {
+                    if (i > 0)
+                        ret += '.';
+                    ret += entry.name;
+                }
+            }
+            return ret;
+        }
+
+        // Checks if the path matches a string produced by `ToString()`. Additionally, `[]` in the pattern matches any index.
+        [[nodiscard]] bool Matches(std::string_view pattern) const
+        {
+            std::size_t i = 0;
+            while (!pattern.empty())
+            {
+                if (i >= size)
+                    return false;
+                const Entry &entry = entries[i];
+
+                if (pattern.front() == '[')
+                {
+                    std::size_t end = pattern.find(']');
+                    if (end == std::string_view::npos || !entry.IsIndex())
+                        return false;
+
+                    std::string_view index_string = pattern.substr(1, end - 1);
+                    if (!index_string.empty())
+                    {
+                        std::size_t index = 0;
+                        auto [ptr, error] = std::from_chars(index_string.data(), index_string.data() + index_string.size(), index);
+                        if (error != std::errc{} || ptr != index_string.data() + index_string.size() || index != entry.index)
+                            return false;
+                    }
+
+                    pattern.remove_prefix(end + 1);
+                }
+                else
+                {
+                    if (i > 0)
+                    {
+                        if (pattern.front() != '.')
+                            return false;
+                        pattern.remove_prefix(1);
+                    }
+
+                    std::size_t end = pattern.find_first_of(".[");
+                    if (end == std::string_view::npos)
+                        end = pattern.size();
+                    if (entry.IsIndex() || pattern.substr(0, end) != entry.name)
+                        return false;
+
+                    pattern.remove_prefix(end);
+                }
+
+                i++;
+            }
+
+            return i == size;
+        }
+    };
+
+    namespace impl
+    {
+        class TextWalker;
+        class BinaryWalker;
+    }
+
+    // A value that's being visited. The handler receives it before the value is read.
+    // If the handler doesn't call any of the functions below, structs and containers are entered, and other values are skipped.
+    class Value
+    {
+        friend class impl::TextWalker;
+        friend class impl::BinaryWalker;
+
+        enum class Action {automatic, enter, skip, read};
+
+        Stream::Input &input;
+        const Path &path;
+        Kind kind = Kind::leaf;
+        std::string_view tag;
+        std::size_t size = -1;
+        std::size_t begin_pos = 0;
+
+        // Only one of those is not null, depending on the format.
+        const FromStringOptions *string_options = nullptr;
+        const FromBinaryOptions *binary_options = nullptr;
+        const std::type_info *binary_type = nullptr; // For the binary format, the type of this value.
+        const char *binary_type_name = nullptr;
+
+        Action action = Action::automatic;
+        bool stop = false;
+
+        Value(Stream::Input &input, const Path &path) : input(input), path(path), begin_pos(input.Position()) {}
+
+      public:
+        Value(const Value &) = delete;
+        Value &operator=(const Value &) = delete;
+
+        [[nodiscard]] const Path &GetPath() const
+        {
+            return path;
+        }
+
+        [[nodiscard]] Kind GetKind() const
+        {
+            return kind;
+        }
+
+        // For polymorphic objects and variants in the text format, the class name or the alternative name. Empty otherwise.
+        [[nodiscard]] std::string_view Tag() const
+        {
+            return tag;
+        }
+
+        // For containers in the binary format, the element count. -1 otherwise.
+        [[nodiscard]] std::size_t Size() const
+        {
+            return size;
+        }
+
+        // Reads the value into `object`.
+        // In the text format, `T` can be any type that accepts this representation.
+        // In the binary format, `T` must be exactly the type this value was serialized from.
+        template <typename T, CHECK_EXPR(Interface<T>())>
+        void Read(T &object)
+        {
+            if (action == Action::read)
+                Program::Error(input.GetExceptionPrefix() + "The value is already read.");
+
+            input.Seek(begin_pos, Stream::absolute);
+            if (string_options)
+            {
+                Refl::Interface(object).FromString(object, input, *string_options, initial_state); // A qualified call prevents unwanted ADL.
+            }
+            else
+            {
+                if (*binary_type != typeid(T))
+                    Program::Error(input.GetExceptionPrefix(), "Attempt to read a binary `", binary_type_name, "` as `", Meta::TypeName<T>(), "`.");
+                Refl::Interface(object).FromBinary(object, input, *binary_options, initial_state);
+            }
+            action = Action::read;
+        }
+        template <typename T, CHECK_EXPR(void(Interface<T>()), T{})>
+        [[nodiscard]] T Read()
+        {
+            T ret{};
+            Read(ret);
+            return ret;
+        }
+
+        // Visits the members or the elements of this value. Does nothing for leaves.
+        void Enter()
+        {
+            if (action != Action::read)
+                action = Action::enter;
+        }
+
+        // Skips this value. Skipping text is fast, since it's not parsed. Skipping binary is fast for structs and containers of scalars and strings,
+        // and for everything else requires reading the value into a temporary object.
+        void Skip()
+        {
+            if (action != Action::read)
+                action = Action::skip;
+        }
+
+        // Stops visiting after this value. The value itself is neither entered nor skipped, unless it's already read.
+        void Stop()
+        {
+            stop = true;
+        }
+    };
+
+    class Handler : Meta::with_virtual_destructor<Handler>
+    {
+      public:
+        // Called for each value before it's read, including the root object.
+        virtual void OnValue(Value &value) = 0;
+
+        // Called after all members or elements of an entered value were visited.
+        virtual void OnLeave(const Path &path, Kind kind)
+        {
+            (void)path;
+            (void)kind;
+        }
+    };
+
+    namespace impl
+    {
+        template <typename F>
+        class FuncHandler : public Handler
+        {
+            F &func;
+
+          public:
+            FuncHandler(F &func) : func(func) {}
+
+            void OnValue(Value &value) override
+            {
+                func(value);
+            }
+        };
+
+        class TextWalker
+        {
+            Stream::Input &input;
+            Handler &handler;
+            const FromStringOptions &options;
+            Path path;
+
+          public:
+            TextWalker(Stream::Input &input, Handler &handler, const FromStringOptions &options) : input(input), handler(handler), options(options) {}
+
+            // Returns false if the handler requested to stop.
+            bool VisitValue()
+            {
+                Value value(input, path);
+                value.string_options = &options;
+
+                // An optional with a value has a `:` prefix. We ignore it, but it's still a part of the value if it's read.
+                if (input.PeekChar() == ':')
+                {
+                    input.SkipOne();
+                    Utils::SkipWhitespaceAndComments(input);
+                }
+
+                // An identifier followed by a value is a name of a polymorphic class or a variant alternative.
+                // A lone identifier is an enum or a boolean.
+                std::string tag_storage;
+                if (Stream::Char::IsAlpha{}(input.PeekChar()) || input.PeekChar() == '_')
+                {
+                    std::size_t tag_pos = input.Position();
+                    std::string_view tag = input.ExtractView(Stream::Char::SeqIdentifier{}, tag_storage);
+                    Utils::SkipWhitespaceAndComments(input);
+
+                    char ch = input.MoreData() ? input.PeekChar() : '\0';
+                    if (ch == '\0' || ch == ',' || ch == '=' || ch == ')' || ch == ']' || ch == '}')
+                        input.Seek(tag_pos, Stream::absolute);
+                    else
+                        value.tag = tag;
+                }
+
+                std::size_t content_pos = input.Position();
+                switch (input.PeekChar())
+                {
+                  case '{':
+                    value.kind = Kind::struct_;
+                    break;
+                  case '(':
+                    value.kind = Kind::tuple;
+                    break;
+                  case '[':
+                    value.kind = Kind::list;
+                    break;
+                }
+
+                handler.OnValue(value);
+
+                if (value.action == Value::Action::read)
+                    return !value.stop;
+                if (value.stop)
+                    return false;
+
+                if (value.kind == Kind::leaf || value.action == Value::Action::skip)
+                {
+                    input.Seek(value.begin_pos, Stream::absolute);
+                    Utils::SkipValue(input);
+                    return true;
+                }
+
+                input.Seek(content_pos, Stream::absolute);
+                if (!VisitContents(value.kind))
+                    return false;
+
+                handler.OnLeave(path, value.kind);
+                return true;
+            }
+
+          private:
+            bool VisitContents(Kind kind)
+            {
+                char closing_bracket = "})]"[int(kind) - int(Kind::struct_)];
+                input.SkipOne();
+
+                for (std::size_t index = 0;; index++)
+                {
+                    Utils::SkipWhitespaceAndComments(input);
+                    if (input.Discard<Stream::if_present>(closing_bracket))
+                        break;
+
+                    if (kind == Kind::struct_)
+                    {
+                        // Same as in `Interface_Struct`: a base class is not followed by `=`.
+                        std::string name_storage;
+                        std::string_view name = input.ExtractView(Stream::Char::SeqIdentifier{}, name_storage);
+                        Utils::SkipWhitespaceAndComments(input);
+                        char ch = input.PeekChar();
+                        if (ch != '{' && ch != '(')
+                        {
+                            input.Discard('=');
+                            Utils::SkipWhitespaceAndComments(input);
+                        }
+                        path.Push(name);
+                    }
+                    else
+                    {
+                        path.Push(index);
+                    }
+
+                    bool keep_going = VisitValue();
+                    path.Pop();
+                    if (!keep_going)
+                        return false;
+
+                    Utils::SkipWhitespaceAndComments(input);
+                    if (!input.Discard<Stream::if_present>(','))
+                    {
+                        input.Discard(closing_bracket);
+                        break;
+                    }
+                }
+
+                return true;
+            }
+        };
+
+        template <typename T> using interface_t = decltype(Interface<T>());
+
+        template <typename T> inline constexpr bool is_struct = std::is_same_v<interface_t<T>, Interface_Struct<T>>;
+        template <typename T> inline constexpr bool is_container = std::is_base_of_v<Interface_BasicContainer<T>, interface_t<T>>;
+
+        inline std::size_t ReadBinaryLength(Stream::Input &input)
+        {
+            std::size_t len;
+            if (Robust::conversion_fails(input.ReadWithByteOrder<Refl::impl::container_length_binary_t>(Refl::impl::container_length_byte_order), len))
+                Program::Error(input.GetExceptionPrefix() + "The container is too long.");
+            return len;
+        }
+
+        // Calls `func(index, tag)` for each base class of `T` that's present in the binary format, in order.
+        // `tag` is `Meta::tag<BaseClass>`.
+        template <typename T, typename F> void ForEachBinaryBase(bool need_virtual_bases, F &&func)
+        {
+            std::size_t index = 0;
+            auto Process = [&](auto tag)
+            {
+                if constexpr (!Refl::impl::Class::skip_base<typename decltype(tag)::type>)
+                    func(index++, tag);
+            };
+
+            if (need_virtual_bases)
+            {
+                using virt_bases = Class::virtual_bases<T>;
+                Meta::cexpr_for<Meta::list_size<virt_bases>>([&](auto index)
+                {
+                    Process(Meta::tag<Meta::list_type_at<virt_bases, index.value>>{});
+                });
+            }
+
+            using bases = Class::bases<T>;
+            Meta::cexpr_for<Meta::list_size<bases>>([&](auto index)
+            {
+                Process(Meta::tag<Meta::list_type_at<bases, index.value>>{});
+            });
+        }
+
+        // Calls `func(index)` for each member of `T` that's present in the binary format, in order. `index` is a `std::integral_constant`.
+        template <typename T, typename F> void ForEachBinaryMember(F &&func)
+        {
+            Meta::cexpr_for<Class::member_count<T>>([&](auto index)
+            {
+                if constexpr (!Refl::impl::Class::skip_member<Class::member_type<T, index.value>>)
+                    func(index);
+            });
+        }
+
+        // Skips a binary value of type `T`. Unlike reading it, doesn't allocate memory for structs, strings, and containers of scalars.
+        template <typename T> void SkipBinary(Stream::Input &input, const FromBinaryOptions &options, bool need_virtual_bases = true)
+        {
+            if constexpr (std::is_same_v<interface_t<T>, Interface_Scalar<T>>)
+            {
+                input.Skip(sizeof(T));
+            }
+            else if constexpr (std::is_same_v<interface_t<T>, Interface_StdString>)
+            {
+                input.Skip(ReadBinaryLength(input));
+            }
+            else if constexpr (is_struct<T>)
+            {
+                ForEachBinaryBase<T>(need_virtual_bases, [&](std::size_t, auto tag)
+                {
+                    SkipBinary<typename decltype(tag)::type>(input, options, false);
+                });
+                ForEachBinaryMember<T>([&](auto index)
+                {
+                    SkipBinary<std::remove_cv_t<Class::member_type<T, index.value>>>(input, options);
+                });
+            }
+            else if constexpr (is_container<T>)
+            {
+                using elem_t = typename interface_t<T>::mutable_elem_t;
+                std::size_t len = ReadBinaryLength(input);
+                if constexpr (std::is_same_v<interface_t<elem_t>, Interface_Scalar<elem_t>>)
+                {
+                    input.Skip(len * sizeof(elem_t));
+                }
+                else
+                {
+                    while (len-- > 0)
+                        SkipBinary<elem_t>(input, options);
+                }
+            }
+            else
+            {
+                T object{};
+                Interface<T>().FromBinary(object, input, options, initial_state);
+            }
+        }
+
+        class BinaryWalker
+        {
+            Stream::Input &input;
+            Handler &handler;
+            const FromBinaryOptions &options;
+            Path path;
+
+          public:
+            BinaryWalker(Stream::Input &input, Handler &handler, const FromBinaryOptions &options) : input(input), handler(handler), options(options) {}
+
+            // Returns false if the handler requested to stop.
+            template <typename T> bool VisitValue(bool need_virtual_bases = true)
+            {
+                Value value(input, path);
+                value.binary_options = &options;
+                value.binary_type = &typeid(T);
+                value.binary_type_name = Meta::TypeName<T>();
+
+                if constexpr (is_struct<T>)
+                {
+                    value.kind = Class::member_names_known<T> ? Kind::struct_ : Kind::tuple;
+                }
+                else if constexpr (is_container<T>)
+                {
+                    value.kind = Kind::list;
+                    value.size = ReadBinaryLength(input);
+                    input.Seek(value.begin_pos, Stream::absolute);
+                }
+
+                handler.OnValue(value);
+
+                if (value.action == Value::Action::read)
+                    return !value.stop;
+                if (value.stop)
+                    return false;
+
+                if (value.kind == Kind::leaf || value.action == Value::Action::skip)
+                {
+                    SkipBinary<T>(input, options, need_virtual_bases);
+                    return true;
+                }
+
+                if constexpr (is_struct<T>)
+                {
+                    bool keep_going = true;
+                    ForEachBinaryBase<T>(need_virtual_bases, [&](std::size_t index, auto tag)
+                    {
+                        using base_type = typename decltype(tag)::type;
+                        if (!keep_going)
+                            return;
+                        if constexpr (Class::name_known<base_type>)
+                            path.Push(Class::name<base_type>);
+                        else
+                            path.Push(index);
+                        keep_going = VisitValue<base_type>(false);
+                        path.Pop();
+                    });
+
+                    ForEachBinaryMember<T>([&](auto index)
+                    {
+                        if (!keep_going)
+                            return;
+                        if constexpr (Class::member_names_known<T>)
+                            path.Push(Class::MemberName<T>(index.value));
+                        else
+                            path.Push(std::size_t(index.value));
+                        keep_going = VisitValue<std::remove_cv_t<Class::member_type<T, index.value>>>();
+                        path.Pop();
+                    });
+
+                    if (!keep_going)
+                        return false;
+                }
+                else if constexpr (is_container<T>)
+                {
+                    input.Skip(sizeof(Refl::impl::container_length_binary_t));
+                    for (std::size_t i = 0; i < value.size; i++)
+                    {
+                        path.Push(i);
+                        bool keep_going = VisitValue<typename interface_t<T>::mutable_elem_t>();
+                        path.Pop();
+                        if (!keep_going)
+                            return false;
+                    }
+                }
+
+                handler.OnLeave(path, value.kind);
+                return true;
+            }
+        };
+    }
+
+    // Visits a value in the text format. Returns false if the handler requested to stop, true if the whole input was visited.
+    // Like `Refl::FromString()`, skips leading and trailing whitespace and comments, and expects no junk at the end of input (unless stopped earlier).
+    inline bool FromString(Handler &handler, InputStreamWrapper input, const FromStringOptions &options = {})
+    {
+        input.stream.WantLocationStyle(Stream::text_position);
+        Utils::SkipWhitespaceAndComments(input.stream);
+        if (!impl::TextWalker(input.stream, handler, options).VisitValue())
+            return false;
+        Utils::SkipWhitespaceAndComments(input.stream);
+        input.stream.ExpectEnd();
+        return true;
+    }
+    // `func` is `void func(Refl::Visit::Value &value)`.
+    template <typename F, CHECK(std::is_invocable_v<F &, Value &>)>
+    bool FromString(F &&func, InputStreamWrapper input, const FromStringOptions &options = {})
+    {
+        impl::FuncHandler<F> handler(func);
+        return FromString(handler, std::move(input), options);
+    }
+
+    // Visits a value of type `T` in the binary format. Returns false if the handler requested to stop, true if the whole input was visited.
+    // Like `Refl::FromBinary()`, expects no junk at the end of input (unless stopped earlier).
+    template <typename T, CHECK_EXPR(Interface<T>())>
+    bool FromBinary(Handler &handler, InputStreamWrapper input, const FromBinaryOptions &options = {})
+    {
+        input.stream.WantLocationStyle(Stream::byte_offset);
+        if (!impl::BinaryWalker(input.stream, handler, options).VisitValue<T>())
+            return false;
+        input.stream.ExpectEnd();
+        return true;
+    }
+    // `func` is `void func(Refl::Visit::Value &value)`.
+    template <typename T, typename F, CHECK(std::is_invocable_v<F &, Value &>)>
+    bool FromBinary(F &&func, InputStreamWrapper input, const FromBinaryOptions &options = {})
+    {
+        impl::FuncHandler<F> handler(func);
+        return FromBinary<T>(handler, std::move(input), options);
+    }
+}
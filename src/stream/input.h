@@ -9,6 +9,7 @@
 #include <memory>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <type_traits>
 #include <utility>
 
@@ -587,6 +588,15 @@ namespace Stream
             return data.size - data.position;
         }
 
+        // If the stream was created from a `ReadOnlyData`, returns the bytes from the cursor to the end, without copying them.
+        // Otherwise, or if there's no more data, returns an empty view. The view remains valid as long as the stream is alive.
+        [[nodiscard]] std::string_view RemainingMemory() const
+        {
+            if (!data.readonly_data_storage)
+                return {};
+            return std::string_view(reinterpret_cast<const char *>(data.buffer_a.storage) + data.position, data.size - data.position);
+        }
+
         // Checks if the stream has more data available at the current cursor position.
         [[nodiscard]] bool MoreData() const
         {
@@ -818,6 +828,34 @@ namespace Stream
             return Extract<mode, C>(Char::EqualTo(byte));
         }
 
+        // Reads matching characters from the input, like `Extract()`, but returns a view instead of a container.
+        // If the stream was created from a `ReadOnlyData`, the view points into it and nothing is copied.
+        // Otherwise the characters are copied to `storage`, and the view points to it.
+        // `category` is a template parameter rather than `const Char::Category &` to let the compiler inline it.
+        template <ExtractMode mode = at_least_one, typename C, CHECK(std::is_base_of_v<Char::Category, C>)>
+        [[nodiscard]] std::string_view ExtractView(const C &category, std::string &storage)
+        {
+            static_assert(mode == at_least_one || mode == any, "Mode has to be `at_least_one` or `any`.");
+
+            std::string_view memory = RemainingMemory();
+            if (memory.empty())
+            {
+                storage.clear();
+                Extract<mode>(category, &storage);
+                return storage;
+            }
+
+            std::size_t count = 0;
+            while (count < memory.size() && category(memory[count]))
+                count++;
+
+            if (mode == at_least_one && count == 0)
+                Program::Error(GetExceptionPrefix() + "Expected " + category.name() + ".");
+
+            data.position += count;
+            return memory.substr(0, count);
+        }
+
         // Discards matching characters from the input.
         // `mode` affects how many characters are read, and whether or not reading 0 characters causes an exception.
         // Returns the amount of characters processed.
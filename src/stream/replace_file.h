@@ -0,0 +1,59 @@
+#pragma once
+
+#include <filesystem>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+
+#include "program/errors.h"
+#include "stream/output.h"
+
+namespace Stream
+{
+    // Writes a file through a temporary file, which then replaces the target file, so the target is never left half-written.
+    // `func` should be `void func(Output &output)`, or `bool func(Output &output)` that returns false to cancel and keep the old file.
+    // The temporary file is named `path` + `temp_suffix`. If several threads can write the same file at once, they need different suffixes.
+    // Returns false if `func` canceled. Throws on failure. In both cases the temporary file is removed.
+    template <typename F>
+    bool ReplaceFile(const std::filesystem::path &path, F &&func, std::string_view temp_suffix = ".tmp")
+    {
+        std::filesystem::path temp_path = path;
+        temp_path += temp_suffix;
+
+        bool finished = true;
+        try
+        {
+            Output output(temp_path.string());
+            if constexpr (std::is_void_v<decltype(func(output))>)
+                func(output);
+            else
+                finished = func(output);
+            if (finished)
+                output.Flush();
+        }
+        catch (...)
+        {
+            std::error_code ignored;
+            std::filesystem::remove(temp_path, ignored);
+            throw;
+        }
+
+        if (!finished)
+        {
+            std::error_code ignored;
+            std::filesystem::remove(temp_path, ignored);
+            return false;
+        }
+
+        std::error_code error;
+        std::filesystem::rename(temp_path, path, error);
+        if (error)
+        {
+            std::error_code ignored;
+            std::filesystem::remove(temp_path, ignored);
+            Program::Error("Unable to replace `", path.string(), "`: ", error.message());
+        }
+
+        return true;
+    }
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "macros/finally.h"
+
+// A fixed set of worker threads that are reused between tasks, so that the callers don't have to start new threads every time.
+// All member functions are thread-safe. Several threads can use the same pool at the same time, then their tasks wait in a queue.
+class ThreadPool
+{
+    std::mutex mutex;
+    std::condition_variable cond_var; // Notified when a task is added, and when the pool is being destroyed.
+    std::deque<std::function<void()>> tasks;
+    bool stop_requested = false;
+
+    std::vector<std::thread> threads; // This has to be the last member, so that the threads are started after everything else is initialized.
+
+    void ThreadFunc()
+    {
+        std::unique_lock lock(mutex);
+        while (1)
+        {
+            cond_var.wait(lock, [&]{return stop_requested || tasks.size() > 0;});
+            if (tasks.empty())
+                return; // Stop only when the queue is empty, since someone might be waiting for those tasks.
+
+            std::function<void()> task = std::move(tasks.front());
+            tasks.pop_front();
+
+            lock.unlock();
+            task();
+            lock.lock();
+        }
+    }
+
+    void Stop()
+    {
+        {
+            std::lock_guard lock(mutex);
+            stop_requested = true;
+        }
+        cond_var.notify_all();
+
+        for (std::thread &thread : threads)
+            thread.join();
+    }
+
+  public:
+    // Throws if the threads can't be started.
+    explicit ThreadPool(int thread_count)
+    {
+        FINALLY_ON_THROW( Stop(); )
+        for (int i = 0; i < thread_count; i++)
+            threads.emplace_back([this]{ThreadFunc();});
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    ~ThreadPool() // Finishes the queued tasks before returning.
+    {
+        Stop();
+    }
+
+    [[nodiscard]] int ThreadCount() const
+    {
+        return int(threads.size());
+    }
+
+    // Runs `func` on `copies` pool threads and on the current thread at the same time, and returns when all of them finish.
+    // If the pool threads are busy, some copies start late, possibly after the current thread is done, so `func` must handle that (e.g. by doing nothing).
+    // If any of the copies throws, the first exception is rethrown here after they all finish.
+    void RunAndWait(int copies, const std::function<void()> &func)
+    {
+        std::mutex group_mutex;
+        std::condition_variable group_cond_var;
+        int remaining = 0;
+        std::exception_ptr exception;
+
+        auto Run = [&]
+        {
+            try
+            {
+                func();
+            }
+            catch (...)
+            {
+                std::lock_guard lock(group_mutex);
+                if (!exception)
+                    exception = std::current_exception();
+            }
+        };
+
+        {
+            std::lock_guard lock(mutex);
+            for (int i = 0; i < copies; i++)
+            {
+                try
+                {
+                    tasks.push_back([&]
+                    {
+                        Run();
+                        std::lock_guard lock(group_mutex);
+                        if (--remaining == 0)
+                            group_cond_var.notify_all(); // Under the lock, since the waiting thread destroys the condition variable right after waking up.
+                    });
+                }
+                catch (std::exception &)
+                {
+                    break; // Work with the copies we've got.
+                }
+                remaining++;
+            }
+        }
+        cond_var.notify_all();
+
+        Run();
+
+        {
+            std::unique_lock lock(group_mutex);
+            group_cond_var.wait(lock, [&]{return remaining == 0;});
+        }
+
+        if (exception)
+            std::rethrow_exception(exception);
+    }
+};